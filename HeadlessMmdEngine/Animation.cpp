@@ -5,44 +5,354 @@
 
 namespace headless_mmd {
 
+void MorphTimeline::Build(const std::vector<Track<float>>& tracks) {
+	frames_.clear();
+	values_.clear();
+	offsets_.clear();
+
+	for (const auto& track : tracks) {
+		const auto begin = static_cast<int32_t>(frames_.size());
+		offsets_.push_back(begin);
+
+		for (const auto& key : track.keys) {
+			// a duplicated frame keeps the later value, so no two keys share a frame
+			if (static_cast<int32_t>(frames_.size()) > begin && frames_.back() == static_cast<float>(key.frame)) {
+				values_.back() = key.value;
+				continue;
+			}
+
+			frames_.push_back(static_cast<float>(key.frame));
+			values_.push_back(key.value);
+		}
+
+		if (static_cast<int32_t>(frames_.size()) == begin) {
+			frames_.push_back(0.f);
+			values_.push_back(0.f);
+		}
+
+		frames_.push_back(std::numeric_limits<float>::infinity());
+		values_.push_back(values_.back());
+	}
+
+	offsets_.push_back(static_cast<int32_t>(frames_.size()));
+}
+
+MorphTimeline::Cursor MorphTimeline::MakeCursor() const {
+	return Cursor(offsets_.begin(), offsets_.begin() + GetNumTracks());
+}
+
+int32_t MorphTimeline::Seek(int track, float frame, int32_t index) const {
+	const auto begin = offsets_[track];
+	const auto end = offsets_[track + 1];
+
+	// playback rarely moves more than one key per tick
+	if (index + 2 < end && frames_[index + 1] <= frame && frame < frames_[index + 2]) {
+		return index + 1;
+	}
+
+	auto it = std::upper_bound(frames_.begin() + begin, frames_.begin() + end, frame);
+	return std::clamp(static_cast<int32_t>(it - frames_.begin()) - 1, begin, end - 2);
+}
+
+void MorphTimeline::Evaluate(float frame, Cursor& cursor, std::span<float> weights) const {
+	const auto num_tracks = std::min<std::size_t>(weights.size(), GetNumTracks());
+	for (std::size_t t = 0; t < num_tracks; ++t) {
+		const auto index = cursor[t];
+		if (frame < frames_[index + 1] && (frames_[index] <= frame || index == offsets_[t])) {
+			continue;
+		}
+		cursor[t] = Seek(static_cast<int>(t), frame, index);
+	}
+
+	// before the first key s clamps to 0, and against the sentinel it is 0 already
+	std::size_t t = 0;
+
+#if !defined(PORTABLE_MMD_NO_SIMD_F32)
+	using portable_mmd::simd::F32;
+	const auto at = F32::Set(frame);
+	const auto zero = F32::Set(0.f);
+	const auto one = F32::Set(1.f);
+	for (; t + F32::Width <= num_tracks; t += F32::Width) {
+		const auto f0 = F32::Gather(frames_.data(), &cursor[t]);
+		const auto f1 = F32::Gather(frames_.data() + 1, &cursor[t]);
+		const auto v0 = F32::Gather(values_.data(), &cursor[t]);
+		const auto v1 = F32::Gather(values_.data() + 1, &cursor[t]);
+		const auto s = Min(Max((at - f0) / (f1 - f0), zero), one);
+		(v0 + (v1 - v0) * s).Store(&weights[t]);
+	}
+#endif
+
+	for (; t < num_tracks; ++t) {
+		const auto index = cursor[t];
+		const auto f0 = frames_[index];
+		const auto v0 = values_[index];
+		const auto s = std::clamp((frame - f0) / (frames_[index + 1] - f0), 0.f, 1.f);
+		weights[t] = v0 + (values_[index + 1] - v0) * s;
+	}
+}
+
+Animation::BoneKey Animation::GetBoneKey(int bone_index, float frame) const {
+	const auto& track = bone_animation_.at(bone_index);
+	const float base = std::floor(frame);
+	const int index = static_cast<int>(base);
+	const float s = frame - base;
+
+	if (s == 0.f || index + 1 >= static_cast<int>(track.Size())) {
+		return track.GetByIndex(index);
+	}
+
+	return matrix_blend(track.GetByIndex(index), track.GetByIndex(index + 1), s);
+}
+
+void Animation::SampleMotion(int bone_index, float frame, TrackCursor& cursor, Vector& translation, Quaternion& rotation) const {
+	const auto& track = motion_animation_.at(bone_index);
+	if (track.IsEmpty()) {
+		translation = vector_zero();
+		rotation = quat_zero();
+		return;
+	}
+
+	auto [key0, key1, s] = track.SearchNearValue(frame, cursor);
+	if (s == 0.f) {
+		translation = key0.translation;
+		rotation = key0.rotation;
+		return;
+	}
+
+	// the curves of a segment are stored on the key that ends it
+	const Vector t{ (*key1.ix)(s), (*key1.iy)(s), (*key1.iz)(s), 0.f };
+	translation = lerp(key0.translation, key1.translation, t);
+	rotation = quat_slerp(key0.rotation, key1.rotation, (*key1.ir)(s));
+}
+
+bool Animation::IsIkEnabled(int bone_index, float frame, TrackCursor& cursor) const {
+	if (bone_index >= static_cast<int>(ik_animation_.size()) || ik_animation_[bone_index].IsEmpty()) {
+		return true;
+	}
+
+	auto [enabled, next, s] = ik_animation_[bone_index].SearchNearValue(frame, cursor);
+	return enabled;
+}
+
+Animation::Cursor Animation::MakeCursor() const {
+	Cursor cursor{};
+	cursor.morphs = morph_timeline_.MakeCursor();
+	cursor.motions.resize(motion_animation_.size());
+	cursor.iks.resize(ik_animation_.size());
+
+	const auto num_curves = 4 * motion_animation_.size();
+	cursor.segments.resize(motion_animation_.size());
+	cursor.curves.reserve(num_curves);
+	cursor.curve_x.reserve(num_curves);
+	cursor.curve_y.reserve(num_curves);
+	return cursor;
+}
+
+void Animation::EvaluateBones(float frame, Cursor& cursor, Skeleton& skeleton) const {
+	if (!bone_stream_) {
+		for (int i = 0, num_bones = GetNumBoneTracks(); i < num_bones; ++i) {
+			skeleton.SetPose(i, GetBoneKey(i, frame));
+		}
+		return;
+	}
+
+	const float base = std::floor(frame);
+	const int index = static_cast<int>(base);
+	const float s = frame - base;
+	const bool blend = s != 0.f && index + 1 < num_frames_;
+
+	// the stream is asked again only when the frame leaves the chunks the cursor holds
+	if (!cursor.chunk || !cursor.chunk->Contains(index)) {
+		cursor.chunk = bone_stream_->Acquire(index);
+		if (!cursor.chunk) {
+			return;
+		}
+	}
+	if (blend && (!cursor.next_chunk || !cursor.next_chunk->Contains(index + 1))) {
+		cursor.next_chunk = cursor.chunk->Contains(index + 1) ? cursor.chunk : bone_stream_->Acquire(index + 1);
+	}
+
+	for (int i = 0, num_bones = static_cast<int>(bone_slots_.size()); i < num_bones; ++i) {
+		const int slot = bone_slots_[i];
+		if (slot < 0) {
+			skeleton.SetPose(i, skeleton.GetRefPose(i));
+			continue;
+		}
+
+		const auto key = cursor.chunk->Get(slot, index);
+		skeleton.SetPose(i, blend ? matrix_blend(key, cursor.next_chunk->Get(slot, index + 1), s) : key);
+	}
+}
+
+// the keys of every bone are found first, then the curves of all the bones between keys are
+// solved in one batch, and the poses are blended from the results
+void Animation::EvaluateMotion(float frame, Cursor& cursor, Skeleton& skeleton) const {
+	const int num_bones = GetNumMotionTracks();
+	auto& segments = cursor.segments;
+	auto& curves = cursor.curves;
+	auto& curve_x = cursor.curve_x;
+	auto& curve_y = cursor.curve_y;
+	segments.resize(num_bones);
+	curves.clear();
+	curve_x.clear();
+
+	for (int i = 0; i < num_bones; ++i) {
+		const auto& track = motion_animation_[i];
+		if (track.IsEmpty()) {
+			segments[i] = { nullptr, nullptr, -1 };
+			continue;
+		}
+
+		auto [key0, key1, s] = track.SearchNearValue(frame, cursor.motions[i]);
+		segments[i] = { &key0, &key1, -1 };
+		if (s == 0.f) {
+			continue;
+		}
+
+		// the curves of a segment are stored on the key that ends it
+		segments[i].lane = static_cast<int>(curves.size());
+		curves.insert(curves.end(), { key1.ix, key1.iy, key1.iz, key1.ir });
+		curve_x.insert(curve_x.end(), 4, s);
+	}
+
+	curve_y.resize(curves.size());
+	portable_mmd::BezierCurve::Evaluate(curves, curve_x, curve_y);
+
+	for (int i = 0; i < num_bones; ++i) {
+		const auto& segment = segments[i];
+		auto translation = vector_zero();
+		auto rotation = quat_zero();
+		if (segment.lane >= 0) {
+			const auto* y = &curve_y[segment.lane];
+			translation = lerp(segment.key0->translation, segment.key1->translation, Vector{ y[0], y[1], y[2], 0.f });
+			rotation = quat_slerp(segment.key0->rotation, segment.key1->rotation, y[3]);
+		}
+		else if (segment.key0) {
+			translation = segment.key0->translation;
+			rotation = segment.key0->rotation;
+		}
+
+		skeleton.SetLocalPose(i, translation, rotation);
+		skeleton.EnableIk(i, IsIkEnabled(i, frame, cursor.iks[i]));
+	}
+}
+
+void Animation::EvaluateMorphs(float frame, Cursor& cursor, std::span<float> values) const {
+	morph_timeline_.Evaluate(frame, cursor.morphs, values);
+}
+
 std::shared_ptr<Animation> AnimationImporter::Import(const struct MmdAnimationTrack& in_animation, const Skeleton& skeleton, const std::vector<std::wstring>& morph_names) {
 	auto animation = std::make_shared<Animation>();
 	
-	ImportBoneAnimation(in_animation.bone_animation, skeleton, animation->bone_animation_);
 	ImportMorphAnimation(in_animation.morph_animation, morph_names, animation->morph_animation_);
+	animation->morph_timeline_.Build(animation->morph_animation_);
+
+	if (in_animation.bone_stream) {
+		animation->bone_stream_ = in_animation.bone_stream;
+		ImportBoneSlots(in_animation.bone_slots, skeleton, animation->bone_slots_);
+		animation->num_frames_ = animation->bone_stream_->GetNumFrames();
+		return animation;
+	}
+
+	ImportBoneAnimation(in_animation.bone_animation, skeleton, animation->bone_animation_);
 
 	int num_frames = 0;
 	for (auto& track : animation->bone_animation_) {
-		num_frames = std::max<int>(num_frames, static_cast<int>(track.keys.size()));
+		num_frames = std::max<int>(num_frames, static_cast<int>(track.Size()));
+	}
+	animation->num_frames_ = num_frames;
+
+	return animation;
+}
+
+std::shared_ptr<Animation> AnimationImporter::Import(const FlatVmd& vmd, const Skeleton& skeleton, const std::vector<std::wstring>& morph_names) {
+	auto animation = std::make_shared<Animation>();
+
+	ImportMotion(vmd, skeleton, animation->motion_animation_, animation->ik_animation_);
+
+	std::map<std::wstring, Track<float>> morph_animation{};
+	for (auto& name : morph_names) {
+		auto& keys = morph_animation[name].keys;
+		for (const auto& key : vmd.Find(vmd.morphs, Utf16ToSjis(name))) {
+			keys.emplace_back(static_cast<int>(key.frame), key.value);
+		}
+	}
+	ImportMorphAnimation(morph_animation, morph_names, animation->morph_animation_);
+	animation->morph_timeline_.Build(animation->morph_animation_);
+
+	int num_frames = 0;
+	for (const auto& key : vmd.motions.keys) {
+		num_frames = std::max<int>(num_frames, static_cast<int>(key.frame) + 1);
+	}
+	for (const auto& key : vmd.morphs.keys) {
+		num_frames = std::max<int>(num_frames, static_cast<int>(key.frame) + 1);
 	}
 	animation->num_frames_ = num_frames;
 
 	return animation;
 }
 
-void AnimationImporter::ImportBoneAnimation(const std::map<std::wstring, std::vector<Matrix>>& in_animation, const Skeleton& skeleton, std::vector<Animation::BoneTrack>& animation) {
+void AnimationImporter::ImportMotion(const FlatVmd& vmd, const Skeleton& skeleton, std::vector<Animation::MotionTrack>& motion, std::vector<Animation::IkTrack>& iks) {
+	auto bone_names = skeleton.GetBoneNames();
+	const auto num_bones = static_cast<int>(bone_names.size());
+	motion.resize(num_bones);
+	iks.resize(num_bones);
+
+	auto& curves = portable_mmd::BezierCache::Shared();
+
+	for (int bi = 0; bi < num_bones; ++bi) {
+		const auto name = Utf16ToSjis(bone_names[bi]);
+
+		// bones without keys stay empty and rest at the bind pose
+		const auto in_keys = vmd.Find(vmd.motions, name);
+		auto& keys = motion[bi].keys;
+		keys.reserve(in_keys.size());
+
+		for (const auto& key : in_keys) {
+			keys.emplace_back(static_cast<int>(key.frame), Animation::MotionKey{
+				key.position,
+				key.orientation,
+				&curves.Get(key.ix),
+				&curves.Get(key.iy),
+				&curves.Get(key.iz),
+				&curves.Get(key.ir),
+			});
+		}
+
+		for (const auto& key : vmd.Find(vmd.iks, name)) {
+			iks[bi].keys.emplace_back(static_cast<int>(key.frame), key.enable);
+		}
+	}
+}
+
+void AnimationImporter::ImportBoneAnimation(const std::map<std::wstring, DenseTrack<Matrix>>& in_animation, const Skeleton& skeleton, std::vector<Animation::BoneTrack>& animation) {
 	auto bone_names = skeleton.GetBoneNames();
 	const auto num_bones = static_cast<int>(bone_names.size());
 	animation.resize(num_bones);
 
 	for (int bi = 0; bi < num_bones; ++bi) {
 		auto& name = bone_names.at(bi);
-		auto& keys = animation.at(bi).keys;
 
 		auto it = in_animation.find(name);
-		if (it == in_animation.end() || it->second.empty()) {
-			keys.emplace_back(0, skeleton.GetRefPose(bi)); // dummy key
+		if (it == in_animation.end() || it->second.IsEmpty()) {
+			animation.at(bi) = Animation::BoneTrack(std::vector<Matrix>{ skeleton.GetRefPose(bi) }); // dummy key
 			continue;
 		}
 
-		auto& in_track = it->second;
-		const auto num_keys = static_cast<int>(in_track.size());
-		keys.resize(num_keys);
+		// shares the samples of the scene, no copy
+		animation.at(bi) = it->second;
+	}
+}
 
-		for (int ki = 0; ki < num_keys; ++ki) {
-			keys[ki].frame = ki;
-			keys[ki].value = in_track[ki];
-		}
+void AnimationImporter::ImportBoneSlots(const std::map<std::wstring, int>& in_slots, const Skeleton& skeleton, std::vector<int>& slots) {
+	auto bone_names = skeleton.GetBoneNames();
+	const auto num_bones = static_cast<int>(bone_names.size());
+	slots.resize(num_bones);
+
+	// bones missing from the capture rest at the bind pose
+	for (int bi = 0; bi < num_bones; ++bi) {
+		auto it = in_slots.find(bone_names.at(bi));
+		slots.at(bi) = it != in_slots.end() ? it->second : -1;
 	}
 }
 
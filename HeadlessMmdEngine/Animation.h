@@ -1,23 +1,99 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <span>
 #include "Common.h"
 #include "Skeleton.h"
 
 namespace headless_mmd {
 
+class MmdSceneStream;
+struct MmdSceneChunk;
+
+// every morph track packed into flat key arrays, so that one call evaluates all of them.
+// each track ends with a sentinel key at infinity that repeats its last value.
+class MorphTimeline {
+public:
+	// per track, the index of the key at or before the frame
+	using Cursor = std::vector<int32_t>;
+
+	void Build(const std::vector<Track<float>>& tracks);
+
+	Cursor MakeCursor() const;
+
+	// fills weights[0, num_tracks) without allocating, advancing the cursor
+	void Evaluate(float frame, Cursor& cursor, std::span<float> weights) const;
+
+	int GetNumTracks() const {
+		return offsets_.empty() ? 0 : static_cast<int>(offsets_.size()) - 1;
+	}
+
+private:
+	std::vector<float>		frames_;
+	std::vector<float>		values_;
+	std::vector<int32_t>	offsets_;	// first key of each track, and the end of the last one
+
+	int32_t Seek(int track, float frame, int32_t index) const;
+};
+
 class Animation {
 public:
 	using BoneKey = Matrix;
-	using BoneTrack = Track<BoneKey>;
+	using BoneTrack = DenseTrack<BoneKey>;
 
 	using MorphKey = float;
 	using MorphTrack = Track<MorphKey>;
 
+	// a vmd key relative to the rest pose, with its curves resolved through the shared cache
+	struct MotionKey {
+		Vector		translation;
+		Quaternion	rotation;
+		const portable_mmd::BezierCurve* ix;
+		const portable_mmd::BezierCurve* iy;
+		const portable_mmd::BezierCurve* iz;
+		const portable_mmd::BezierCurve* ir;
+	};
+	using MotionTrack = Track<MotionKey>;
+	using IkTrack = Track<bool>;
+
+	// the keys of a bone around a frame, and where its x, y, z and rotation curves are in the
+	// batch evaluated for the frame, or -1 when it is on a key
+	struct MotionSegment {
+		const MotionKey* key0;
+		const MotionKey* key1;
+		int lane;
+	};
+
+	// one playback position across every track of the animation
+	struct Cursor {
+		MorphTimeline::Cursor morphs;
+		std::vector<TrackCursor> motions;
+		std::vector<TrackCursor> iks;
+
+		// room for EvaluateMotion, sized by MakeCursor so that a frame does not allocate
+		std::vector<MotionSegment> segments;
+		std::vector<const portable_mmd::BezierCurve*> curves;
+		std::vector<float> curve_x;
+		std::vector<float> curve_y;
+
+		// the streamed chunks of the frame and of the next one, kept while the window moves on
+		std::shared_ptr<const MmdSceneChunk> chunk;
+		std::shared_ptr<const MmdSceneChunk> next_chunk;
+	};
+
 private:
 	int num_frames_ = 0;
 	std::vector<BoneTrack>	bone_animation_;
 	std::vector<MorphTrack>	morph_animation_;
+	MorphTimeline			morph_timeline_;
+
+	// a streamed capture, with the slot of each skeleton bone in its chunks or -1
+	std::shared_ptr<MmdSceneStream>	bone_stream_;
+	std::vector<int>				bone_slots_;
+
+	// vmd motion, indexed like the skeleton. the bones are posed at runtime instead of baked.
+	std::vector<MotionTrack>	motion_animation_;
+	std::vector<IkTrack>		ik_animation_;
 
 	friend class AnimationImporter;
 
@@ -26,9 +102,8 @@ public:
 		return static_cast<int>(bone_animation_.size());
 	}
 
-	BoneKey GetBoneKey(int bone_index, int frame_no) {
-		return bone_animation_.at(bone_index).GetByIndex(frame_no);
-	}
+	// between two captured frames the transforms are decomposed and blended
+	BoneKey GetBoneKey(int bone_index, float frame) const;
 
 	int GetNumMorphTracks() const {
 		return static_cast<int>(morph_animation_.size());
@@ -38,6 +113,25 @@ public:
 		return morph_animation_.at(morph_index).CalcAt(frame_no);
 	}
 	
+	bool HasMotion() const {
+		return !motion_animation_.empty();
+	}
+
+	int GetNumMotionTracks() const {
+		return static_cast<int>(motion_animation_.size());
+	}
+
+	// one bone, the curves solved one at a time. EvaluateMotion solves those of every bone together.
+	void SampleMotion(int bone_index, float frame, TrackCursor& cursor, Vector& translation, Quaternion& rotation) const;
+	bool IsIkEnabled(int bone_index, float frame, TrackCursor& cursor) const;
+
+	Cursor MakeCursor() const;
+
+	// every track at one frame, advancing the cursor
+	void EvaluateBones(float frame, Cursor& cursor, Skeleton& skeleton) const;
+	void EvaluateMotion(float frame, Cursor& cursor, Skeleton& skeleton) const;
+	void EvaluateMorphs(float frame, Cursor& cursor, std::span<float> values) const;
+
 	int GetNumFrames() const {
 		return num_frames_;
 	}
@@ -54,9 +148,12 @@ public:
 class AnimationImporter {
 public:
 	std::shared_ptr<Animation> Import(const struct MmdAnimationTrack& in_animation, const Skeleton& skeleton, const std::vector<std::wstring>& morph_names);
+	std::shared_ptr<Animation> Import(const FlatVmd& vmd, const Skeleton& skeleton, const std::vector<std::wstring>& morph_names);
 
 private:
-	void ImportBoneAnimation(const std::map<std::wstring, std::vector<Matrix>>& in_animation, const Skeleton& skeleton, std::vector<Animation::BoneTrack>& animation);
+	void ImportMotion(const FlatVmd& vmd, const Skeleton& skeleton, std::vector<Animation::MotionTrack>& motion, std::vector<Animation::IkTrack>& iks);
+	void ImportBoneAnimation(const std::map<std::wstring, DenseTrack<Matrix>>& in_animation, const Skeleton& skeleton, std::vector<Animation::BoneTrack>& animation);
+	void ImportBoneSlots(const std::map<std::wstring, int>& in_slots, const Skeleton& skeleton, std::vector<int>& slots);
 	void ImportMorphAnimation(const std::map<std::wstring, Track<float>>& in_animation, const std::vector<std::wstring>& morph_names, std::vector<Animation::MorphTrack>& animation);
 };
 
@@ -14,8 +14,22 @@ headless_mmd::AssetId MakeId(const std::shared_ptr<T>& asset) {
 namespace headless_mmd {
 
 AssetId AssetHolder::ImportPmxModel(DxContext* context, const std::wstring& path) {
-	Pmx pmx{};
-	if (!portable_mmd::LoadPmx(path, pmx)) {
+	LazyPmx pmx{};
+	pmx.KeepVertexMorphData(false);
+	if (!pmx.Open(path)) {
+		return NullId;
+	}
+
+	return ImportPmxModel(context, pmx, path);
+}
+
+AssetId AssetHolder::ImportPmxModel(DxContext* context, LazyPmx& pmx, const std::wstring& path) {
+	// the skinned mesh importer decodes the vertices itself, straight into its own layout
+	std::vector<portable_mmd::PmxSection> sections{};
+	std::copy_if(std::begin(portable_mmd::PmxSections), std::end(portable_mmd::PmxSections), std::back_inserter(sections),
+		[](portable_mmd::PmxSection section) { return section != portable_mmd::PmxSection::Vertices; });
+
+	if (!pmx.Load(sections)) {
 		return NullId;
 	}
 
@@ -52,4 +66,36 @@ void AssetHolder::ImportMmdScene(DxContext* context, const std::wstring& path, c
 	}
 }
 
+void AssetHolder::ImportVmdMotion(const std::wstring& path, const std::shared_ptr<Model>& model, AssetId& animation_id, AssetId& camera_id) {
+	animation_id = NullId;
+	camera_id = NullId;
+
+	FlatVmd vmd{};
+	if (!portable_mmd::LoadVmd(path, vmd)) {
+		return;
+	}
+
+	// a facial motion has morph keys only
+	if ((!vmd.motions.keys.empty() || !vmd.morphs.keys.empty()) && model) {
+		auto animation = AnimationImporter().Import(vmd, *model->GetSkeleton(), model->GetMesh()->GetMorphNames());
+		if (animation) {
+			animation_id = AddAsset(animation);
+		}
+	}
+
+	if (!vmd.cameras.empty()) {
+		MmdCameraTrack track{};
+		track.keys.reserve(vmd.cameras.size());
+		for (const auto& key : vmd.cameras) {
+			track.keys.emplace_back(static_cast<int>(key.frame), key);
+		}
+		std::ranges::stable_sort(track.keys, {}, &Key<Vmd::CameraKey>::frame);
+
+		auto camera_anim = CameraAnimationImporter().Import(track);
+		if (camera_anim) {
+			camera_id = AddAsset(camera_anim);
+		}
+	}
+}
+
 }
\ No newline at end of file
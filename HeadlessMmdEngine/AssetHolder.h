@@ -16,7 +16,9 @@ inline constexpr AssetId NullId = reinterpret_cast<AssetId>(nullptr);
 class AssetHolder {
 public:
 	AssetId	ImportPmxModel(DxContext* context, const std::wstring& path);
+	AssetId	ImportPmxModel(DxContext* context, LazyPmx& pmx, const std::wstring& path);
 	void ImportMmdScene(DxContext* context, const std::wstring& path, const std::shared_ptr<Model>& model, AssetId& animation_id, AssetId& camera_id);
+	void ImportVmdMotion(const std::wstring& path, const std::shared_ptr<Model>& model, AssetId& animation_id, AssetId& camera_id);
 
 private:
 	std::map<AssetId, std::shared_ptr<Model>>			model_assets_{};
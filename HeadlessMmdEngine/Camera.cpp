@@ -3,9 +3,9 @@
 
 namespace headless_mmd {
 
-void Camera::Update(int frame) {
+void Camera::Update(float frame) {
 	if (animation_) {
-		animation_->GetCameraInfo(frame, position_, forward_, up_, fov_);
+		animation_->GetCameraInfo(frame, animation_cursor_, position_, forward_, up_, fov_);
 	}
 
 	CalcViewMatrix();
@@ -44,6 +44,7 @@ void Camera::SetNearFar(float clip_near, float clip_far) {
 
 void Camera::SetAnimation(const std::shared_ptr<CameraAnimation>& animation) {
 	animation_ = animation;
+	animation_cursor_ = {};
 }
 
 void Camera::CalcViewMatrix() {
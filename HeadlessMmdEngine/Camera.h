@@ -6,7 +6,7 @@ namespace headless_mmd {
 
 class Camera {
 public:
-	void Update(int frame);
+	void Update(float frame);
 	void SetPosition(float x, float y, float z);
 	void SetForward(float x, float y, float z);
 	void SetUp(float x, float y, float z);
@@ -30,6 +30,7 @@ private:
 	Matrix	projection_ = matrix_identity();
 
 	std::shared_ptr<CameraAnimation> animation_{};
+	TrackCursor animation_cursor_{};
 
 public:
 	Vector GetPosition() const {
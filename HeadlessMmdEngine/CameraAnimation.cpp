@@ -15,19 +15,21 @@ void DecodeCameraKey(const Vector& in_position, const Vector& in_rotation, const
 	fov = static_cast<float>(in_view_angle);
 }
 
-void CameraAnimation::GetCameraInfo(const int frame, Vector& position, Vector& forward, Vector& up, float& fov) const {
-	auto[prev, next, s] = track_.SearchNearValue(frame);
+void CameraAnimation::GetCameraInfo(const float frame, TrackCursor& cursor, Vector& position, Vector& forward, Vector& up, float& fov) const {
+	auto[prev_curves, next_curves, s] = track_.SearchNearValue(frame, cursor);
+	auto& prev = prev_curves.key;
+	auto& next = next_curves.key;
 
 	if (s == 0.f) {
 		DecodeCameraKey(prev.position, prev.rotation, prev.distance, prev.view_angle, position, forward, up, fov);
 	}
 	else {
-		const float vx = portable_mmd::BezierInterp(s, next.ix);
-		const float vy = portable_mmd::BezierInterp(s, next.iy);
-		const float vz = portable_mmd::BezierInterp(s, next.iz);
-		const float vr = portable_mmd::BezierInterp(s, next.ir);
-		const float vd = portable_mmd::BezierInterp(s, next.id);
-		const float vv = portable_mmd::BezierInterp(s, next.iv);
+		const float vx = (*next_curves.ix)(s);
+		const float vy = (*next_curves.iy)(s);
+		const float vz = (*next_curves.iz)(s);
+		const float vr = (*next_curves.ir)(s);
+		const float vd = (*next_curves.id)(s);
+		const float vv = (*next_curves.iv)(s);
 
 		DecodeCameraKey(
 			lerp(prev.position, next.position, Vector{ vx, vy, vz, 0.f }),
@@ -39,8 +41,26 @@ void CameraAnimation::GetCameraInfo(const int frame, Vector& position, Vector& f
 }
 
 std::shared_ptr<CameraAnimation> CameraAnimationImporter::Import(const MmdScene& scene) {
+	return Import(scene.GetCameraTrack());
+}
+
+std::shared_ptr<CameraAnimation> CameraAnimationImporter::Import(const Track<Vmd::CameraKey>& track) {
 	auto animation = std::make_shared<CameraAnimation>();
-	animation->track_ = scene.GetCameraTrack();
+	auto& in_keys = track.keys;
+	animation->track_.keys.reserve(in_keys.size());
+
+	auto& curves = portable_mmd::BezierCache::Shared();
+	for (auto& [frame, key] : in_keys) {
+		animation->track_.keys.emplace_back(frame, CameraAnimation::CurveKey{
+			key,
+			&curves.Get(key.ix),
+			&curves.Get(key.iy),
+			&curves.Get(key.iz),
+			&curves.Get(key.ir),
+			&curves.Get(key.id),
+			&curves.Get(key.iv),
+		});
+	}
 
 	return animation;
 }
@@ -6,10 +6,21 @@ namespace headless_mmd {
 
 class CameraAnimation {
 public:
-	void GetCameraInfo(const int frame, Vector& position, Vector& forward, Vector& up, float& fov) const;
+	void GetCameraInfo(const float frame, TrackCursor& cursor, Vector& position, Vector& forward, Vector& up, float& fov) const;
 
 private:
-	Track<Vmd::CameraKey> track_{};
+	// a key with its curves resolved through the shared cache at import
+	struct CurveKey {
+		Vmd::CameraKey key;
+		const portable_mmd::BezierCurve* ix;
+		const portable_mmd::BezierCurve* iy;
+		const portable_mmd::BezierCurve* iz;
+		const portable_mmd::BezierCurve* ir;
+		const portable_mmd::BezierCurve* id;
+		const portable_mmd::BezierCurve* iv;
+	};
+
+	Track<CurveKey> track_{};
 
 	friend class CameraAnimationImporter;
 };
@@ -17,6 +28,7 @@ private:
 class CameraAnimationImporter {
 public:
 	std::shared_ptr<CameraAnimation> Import(const class MmdScene& scene);
+	std::shared_ptr<CameraAnimation> Import(const Track<Vmd::CameraKey>& track);
 };
 
 }
\ No newline at end of file
@@ -14,7 +14,9 @@ using Float4x4 = DirectX::XMFLOAT4X4;
 using Matrix = DirectX::XMMATRIX;
 
 using Pmx = portable_mmd::Pmx<Vector, Vector, Vector>;
+using LazyPmx = portable_mmd::LazyPmx<Vector, Vector, Vector>;
 using Vmd = portable_mmd::Vmd<Vector, Vector>;
+using FlatVmd = portable_mmd::FlatVmd<Vector, Vector>;
 
 constexpr inline int Slot_Scene = 0;
 constexpr inline int Slot_Model = 1;
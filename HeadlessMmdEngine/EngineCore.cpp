@@ -40,7 +40,7 @@ void EngineCore::Stop() {
 	context_ = nullptr;
 }
 
-void EngineCore::Update(int frame, const std::vector<float>& morph_values) {
+void EngineCore::Update(float frame, const std::vector<float>& morph_values) {
 	scene_->Update(context_.get(), frame, morph_values);
 }
 
@@ -49,7 +49,14 @@ void EngineCore::Draw() {
 }
 
 std::shared_ptr<Model> EngineCore::LoadModel(const std::wstring& path) {
-	auto id = assets_->ImportPmxModel(context_.get(), path);
+	return AddModel(assets_->ImportPmxModel(context_.get(), path));
+}
+
+std::shared_ptr<Model> EngineCore::LoadModel(const std::wstring& path, LazyPmx& pmx) {
+	return AddModel(assets_->ImportPmxModel(context_.get(), pmx, path));
+}
+
+std::shared_ptr<Model> EngineCore::AddModel(AssetId id) {
 	if (id == NullId) {
 		return nullptr;
 	}
@@ -64,6 +71,19 @@ std::shared_ptr<Model> EngineCore::LoadModel(const std::wstring& path) {
 	return model;
 }
 
+ScrubCacheStats EngineCore::GetScrubCacheStats() const {
+	const auto stats = scene_->GetScrubCacheStats();
+
+	ScrubCacheStats info{};
+	info.budget = scene_->GetScrubCacheBudget();
+	info.bytes = stats.bytes;
+	info.entries = stats.entries;
+	info.hits = stats.hits;
+	info.misses = stats.misses;
+	info.evictions = stats.evictions;
+	return info;
+}
+
 std::shared_ptr<Animation> EngineCore::LoadScene(const std::wstring& path) {
 	std::shared_ptr<Model> model{};
 	if (auto model_ids = assets_->GetModelIds(); !model_ids.empty()) {
@@ -72,7 +92,15 @@ std::shared_ptr<Animation> EngineCore::LoadScene(const std::wstring& path) {
 
 	AssetId animation_id{};
 	AssetId camera_id{};
-	assets_->ImportMmdScene(context_.get(), path, model, animation_id, camera_id);
+	// a vmd is posed at runtime, anything else is taken for a baked scene capture
+	auto extension = std::filesystem::path(path).extension().wstring();
+	std::ranges::transform(extension, extension.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+	if (extension == L".vmd") {
+		assets_->ImportVmdMotion(path, model, animation_id, camera_id);
+	}
+	else {
+		assets_->ImportMmdScene(context_.get(), path, model, animation_id, camera_id);
+	}
 
 	std::shared_ptr<Animation> animation = animation_id != NullId ? assets_->GetAnimation(animation_id) : nullptr;
 	if (animation) {
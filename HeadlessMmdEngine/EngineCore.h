@@ -14,13 +14,26 @@ public:
 
 	bool Start(HWND hwnd);
 	void Stop();
-	void Update(int frame, const std::vector<float>& morph_values);
+	void Update(float frame, const std::vector<float>& morph_values);
 	void Draw();
 
 	std::shared_ptr<Model> LoadModel(const std::wstring& path);
+	std::shared_ptr<Model> LoadModel(const std::wstring& path, LazyPmx& pmx);
 	std::shared_ptr<Animation> LoadScene(const std::wstring& path);
 
+	const PoseCacheStats& GetPoseCacheStats() const {
+		return scene_->GetPoseCacheStats();
+	}
+
+	void SetScrubCacheBudget(std::size_t bytes) {
+		scene_->SetScrubCacheBudget(bytes);
+	}
+
+	ScrubCacheStats GetScrubCacheStats() const;
+
 private:
+	std::shared_ptr<Model> AddModel(AssetId id);
+
 	std::unique_ptr<DxContext> context_ = std::make_unique<DxContext>();
 	std::unique_ptr<Scene> scene_ = std::make_unique<Scene>();
 	std::unique_ptr<Renderer> renderer_ = std::make_unique<Renderer>();
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "EngineThread.h"
 #include <ranges>
+#include "DebugTimer.h"
 
 namespace headless_mmd {
 
@@ -54,20 +55,22 @@ void EngineThread::Stop() {
 	}
 }
 
-void EngineThread::Update(int frame) {
+void EngineThread::Update(float frame) {
 	std::unique_lock<std::mutex> lock(mtx_);
 
 	frame_ = frame;
 }
 
-void EngineThread::Update(int frame, int morph_index, float morph_value) {
+void EngineThread::Update(float frame, int morph_index, float morph_value) {
 	std::unique_lock<std::mutex> lock(mtx_);
 
 	frame_ = frame;
-	morph_values_.at(morph_index) = morph_value;
+	if (morph_index >= 0 && morph_index < static_cast<int>(morph_values_.size())) {
+		morph_values_[morph_index] = morph_value;
+	}
 }
 
-void EngineThread::Update(int frame, const std::vector<float>& morph_values) {
+void EngineThread::Update(float frame, const std::vector<float>& morph_values) {
 	std::unique_lock<std::mutex> lock(mtx_);
 
 	frame_ = frame;
@@ -77,6 +80,30 @@ void EngineThread::Update(int frame, const std::vector<float>& morph_values) {
 	}
 }
 
+void EngineThread::SetMorphSource(MorphSource source) {
+	std::unique_lock<std::mutex> lock(mtx_);
+
+	morph_source_ = source;
+}
+
+PoseCacheStats EngineThread::GetPoseCacheStats() {
+	std::unique_lock<std::mutex> lock(mtx_);
+
+	return pose_cache_stats_;
+}
+
+void EngineThread::SetScrubCacheBudget(std::size_t bytes) {
+	std::unique_lock<std::mutex> lock(mtx_);
+
+	scrub_cache_budget_ = bytes;
+}
+
+ScrubCacheStats EngineThread::GetScrubCacheStats() {
+	std::unique_lock<std::mutex> lock(mtx_);
+
+	return scrub_cache_stats_;
+}
+
 bool EngineThread::LoadModel(const std::wstring& path, ModelInfo& info) {
 	return model_request_.Query(path, info);
 }
@@ -86,23 +113,52 @@ bool EngineThread::LoadScene(const std::wstring& path, AnimationInfo& info) {
 }
 
 bool EngineThread::LoadModelInThread(const std::wstring& path, ModelInfo& info){
-	auto model = core_->LoadModel(path);
-	if (!model) {
+	Timer timer;
+
+	// only the morph section is needed to answer. the rest of the model is loaded by LoadPendingModel right after the reply.
+	// the vertex morph offsets are decoded later by the mesh importer, straight into its own layout
+	auto pmx = std::make_unique<LazyPmx>();
+	pmx->KeepVertexMorphData(false);
+	if (!pmx->Open(path) || !pmx->Load(portable_mmd::PmxSection::Morphs)) {
 		return false;
 	}
+	timer.Stop(L"index pmx and load morphs");
 
-	auto& morph_names = model->GetMesh()->GetMorphNames();
-	info.morph_names = morph_names;
+	const auto& morphs = pmx->Get().vertex_morphs;
+	std::transform(morphs.begin(), morphs.end(), std::back_inserter(info.morph_names), [](const Pmx::VertexMorph& morph) { return morph.name; });
+	std::transform(morphs.begin(), morphs.end(), std::back_inserter(info.morph_categories), [](const Pmx::VertexMorph& morph) { return static_cast<int>(morph.panel); });
 
-	auto& morph_panels = model->GetMesh()->GetMorphPanels();
-	std::transform(morph_panels.begin(), morph_panels.end(), std::back_inserter(info.morph_categories), [](portable_mmd::PmxMorphPanel panel) { return static_cast<int>(panel); });
+	pending_model_path_ = path;
+	pending_pmx_ = std::move(pmx);
+	model_state_ = ModelState::Importing;
 
 	std::unique_lock<std::mutex> lock(mtx_);
-	morph_values_.resize(morph_names.size());
-	
+	morph_values_.resize(info.morph_names.size());
+
 	return true;
 }
 
+void EngineThread::LoadPendingModel() {
+	if (!pending_pmx_) {
+		return;
+	}
+
+	Timer timer;
+	auto pmx = std::move(pending_pmx_);
+
+	if (!core_->LoadModel(pending_model_path_, *pmx)) {
+		DLOG(L"Failed to import {}", pending_model_path_);
+
+		// the reply already sized the values for this model, they must not reach the others
+		std::unique_lock<std::mutex> lock(mtx_);
+		morph_values_.clear();
+		model_state_ = ModelState::Failed;
+		return;
+	}
+	timer.Stop(L"load and import model");
+	model_state_ = ModelState::Ready;
+}
+
 bool EngineThread::LoadAnimationInThread(const std::wstring& path, AnimationInfo& info) {
 	auto animation = core_->LoadScene(path);
 	if (!animation) {
@@ -118,13 +174,22 @@ bool EngineThread::LoadAnimationInThread(const std::wstring& path, AnimationInfo
 void EngineThread::Proc(std::promise<bool> init_promise) {
 	init_promise.set_value(SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED)));
 
+	// models given no values play the morphs of their animation
+	const std::vector<float> no_values{};
+
 	auto t0 = std::chrono::system_clock::now();
 	while (run_) {
 		model_request_.Process();
+		LoadPendingModel();
 		animation_request_.Process();
 
 		std::unique_lock<std::mutex> lock(mtx_);
-		core_->Update(frame_, morph_values_);
+		if (scrub_cache_budget_ != scrub_cache_stats_.budget) {
+			core_->SetScrubCacheBudget(scrub_cache_budget_);
+		}
+		core_->Update(frame_, morph_source_ == MorphSource::Animation ? no_values : morph_values_);
+		pose_cache_stats_ = core_->GetPoseCacheStats();
+		scrub_cache_stats_ = core_->GetScrubCacheStats();
 		lock.unlock();
 
 		core_->Draw();
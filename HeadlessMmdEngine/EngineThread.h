@@ -35,19 +35,36 @@ public:
 	bool Start(HWND hwnd);
 	void Stop();
 
-	void Update(int frame);
-	void Update(int frame, int morph_index, float morph_value);
-	void Update(int frame, const std::vector<float>& morph_values);
+	void Update(float frame);
+	void Update(float frame, int morph_index, float morph_value);
+	void Update(float frame, const std::vector<float>& morph_values);
 
 	bool LoadModel(const std::wstring& path, ModelInfo& info);
 	bool LoadScene(const std::wstring& path, AnimationInfo& info);
 
+	ModelState GetModelState() const {
+		return model_state_;
+	}
+
+	void SetMorphSource(MorphSource source);
+
+	// as of the last update
+	PoseCacheStats GetPoseCacheStats();
+
+	// applied by the next update
+	void SetScrubCacheBudget(std::size_t bytes);
+	ScrubCacheStats GetScrubCacheStats();
+
 private:
 	std::unique_ptr<EngineCore> core_ = std::make_unique<EngineCore>();
 	
 	std::mutex mtx_;
-	int frame_ = 0;
+	float frame_ = 0.f;
 	std::vector<float> morph_values_;
+	MorphSource morph_source_ = MorphSource::Values;
+	PoseCacheStats pose_cache_stats_{};
+	std::size_t scrub_cache_budget_ = 0;
+	ScrubCacheStats scrub_cache_stats_{};
 
 	std::thread th_;
 	std::atomic_bool run_;
@@ -55,7 +72,12 @@ private:
 	ThreadRequest<ModelInfo, std::wstring> model_request_;
 	ThreadRequest<AnimationInfo, std::wstring> animation_request_;
 
+	std::wstring pending_model_path_{};
+	std::unique_ptr<LazyPmx> pending_pmx_{};
+	std::atomic<ModelState> model_state_ = ModelState::None;
+
 	bool LoadModelInThread(const std::wstring& path, ModelInfo& info);
+	void LoadPendingModel();
 	bool LoadAnimationInThread(const std::wstring& path, AnimationInfo& info);
 	void Proc(std::promise<bool> init_promise);
 };
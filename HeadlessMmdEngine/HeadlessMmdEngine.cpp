@@ -2,6 +2,9 @@
 #include "HeadlessMmdEngine.h"
 #include <future>
 #include "EngineThread.h"
+#include "KeyReduction.h"
+#include "MmdScene.h"
+#include "MotionConverter.h"
 
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
@@ -43,19 +46,19 @@ void HeadlessMmdEngine::Stop() {
 	engine_thread_ = nullptr;
 }
 
-void HeadlessMmdEngine::Update(int frame) {
+void HeadlessMmdEngine::Update(float frame) {
 	if (engine_started) {
 		engine_thread_->Update(frame);
 	}
 }
 
-void HeadlessMmdEngine::Update(int frame, int morph_index, float morph_value) {
+void HeadlessMmdEngine::Update(float frame, int morph_index, float morph_value) {
 	if (engine_started) {
 		engine_thread_->Update(frame, morph_index, morph_value);
 	}
 }
 
-void HeadlessMmdEngine::Update(int frame, const std::vector<float>& morph_values) {
+void HeadlessMmdEngine::Update(float frame, const std::vector<float>& morph_values) {
 	if (engine_started) {
 		engine_thread_->Update(frame, morph_values);
 	}
@@ -79,6 +82,45 @@ bool HeadlessMmdEngine::LoadScene(const std::wstring& path, AnimationInfo& info)
 	}
 }
 
+ModelState HeadlessMmdEngine::GetModelState() {
+	if (engine_started) {
+		return engine_thread_->GetModelState();
+	}
+	else {
+		return ModelState::None;
+	}
+}
+
+void HeadlessMmdEngine::SetMorphSource(MorphSource source) {
+	if (engine_started) {
+		engine_thread_->SetMorphSource(source);
+	}
+}
+
+PoseCacheStats HeadlessMmdEngine::GetPoseCacheStats() {
+	if (engine_started) {
+		return engine_thread_->GetPoseCacheStats();
+	}
+	else {
+		return {};
+	}
+}
+
+void HeadlessMmdEngine::SetScrubCacheBudget(std::size_t bytes) {
+	if (engine_started) {
+		engine_thread_->SetScrubCacheBudget(bytes);
+	}
+}
+
+ScrubCacheStats HeadlessMmdEngine::GetScrubCacheStats() {
+	if (engine_started) {
+		return engine_thread_->GetScrubCacheStats();
+	}
+	else {
+		return {};
+	}
+}
+
 bool HeadlessMmdEngine::SaveMorphAnimation(const std::wstring& path, const std::vector<std::string>& morph_names, const std::vector<Track<float>>& animation, const std::string& model_name) {
 	Vmd vmd{};
 	vmd.header.name = model_name;
@@ -106,6 +148,10 @@ bool HeadlessMmdEngine::SaveMorphAnimation(const std::wstring& path, const std::
 }
 
 bool HeadlessMmdEngine::SaveMorphAnimation(const std::wstring& path, const std::vector<std::string>& morph_names, const std::vector<std::vector<int32_t>>& frame_tracks, const std::vector<std::vector<float>>& value_tracks, const std::string& model_name) {
+	return SaveMorphAnimation(path, morph_names, frame_tracks, value_tracks, model_name, -1.f);
+}
+
+bool HeadlessMmdEngine::SaveMorphAnimation(const std::wstring& path, const std::vector<std::string>& morph_names, const std::vector<std::vector<int32_t>>& frame_tracks, const std::vector<std::vector<float>>& value_tracks, const std::string& model_name, float tolerance, KeyReductionInfo* info) {
 	Vmd vmd{};
 	vmd.header.name = model_name;
 
@@ -117,23 +163,56 @@ bool HeadlessMmdEngine::SaveMorphAnimation(const std::wstring& path, const std::
 		return false;
 	}
 
+	// the indices of the keys to save, fitted per track in parallel
+	std::vector<std::vector<std::size_t>> kept_keys(num_morphs);
+	std::vector<std::function<bool()>> tasks{};
+	for (int i = 0; i < num_morphs; ++i) {
+		if (frame_tracks[i].size() != value_tracks[i].size()) {
+			continue;
+		}
+
+		tasks.push_back([&, i] {
+			auto& kept = kept_keys[i];
+			if (tolerance < 0.f) {
+				kept.resize(frame_tracks[i].size());
+				std::iota(kept.begin(), kept.end(), std::size_t{ 0 });
+			}
+			else {
+				kept = ReduceLinearKeys(frame_tracks[i], value_tracks[i], tolerance);
+			}
+			return true;
+		});
+	}
+	if (!portable_mmd::io::RunTasks(tasks, 0)) {
+		return false;
+	}
+
+	KeyReductionInfo reduction{};
 	for (int i = 0; i < num_morphs; ++i) {
 		auto& name = morph_names[i];
 		auto& frames = frame_tracks[i];
 		auto& values = value_tracks[i];
 
-		const auto num_keys = static_cast<int>(frames.size());
-		if (values.size() != num_keys) {
+		if (values.size() != frames.size()) {
 			continue;
 		}
 
+		auto& kept = kept_keys[i];
 		auto& out = vmd.morphs[name];
-		out.resize(num_keys);
+		out.resize(kept.size());
 
-		for (int j = 0; j < num_keys; ++j) {
-			out[j].frame = frames[j];
-			out[j].value = values[j];
+		for (std::size_t j = 0; j < kept.size(); ++j) {
+			out[j].frame = frames[kept[j]];
+			out[j].value = values[kept[j]];
 		}
+
+		reduction.num_keys += frames.size();
+		reduction.num_saved_keys += kept.size();
+	}
+
+	DLOG(L"{} of {} morph keys saved, {:.2f}x smaller", reduction.num_saved_keys, reduction.num_keys, reduction.GetCompressionRatio());
+	if (info) {
+		*info = reduction;
 	}
 
 	const auto saved = portable_mmd::SaveVmd(path, vmd);
@@ -145,4 +224,56 @@ bool HeadlessMmdEngine::SaveMorphAnimation(const std::wstring& path, const std::
 	return saved;
 }
 
+bool HeadlessMmdEngine::ConvertSceneToVmd(const std::wstring& scene_path, const std::wstring& model_path, const std::wstring& vmd_path, float translation_tolerance, float rotation_tolerance, KeyReductionInfo* info, int track_index) {
+	auto scene = MmdSceneImporter().Import(scene_path);
+	if (!scene || !scene->HasAnimationTrack()) {
+		return false;
+	}
+
+	// only the hierarchy is needed
+	LazyPmx pmx{};
+	if (!pmx.Open(model_path) || !pmx.Load(portable_mmd::PmxSection::Bones)) {
+		return false;
+	}
+
+	// the captor names each track by the path its model was loaded from. another model's motion
+	// would convert without complaint, so a name that matches no track, or several, is an error.
+	const auto num_tracks = static_cast<int>(scene->GetNumAnimations());
+	if (track_index < 0) {
+		const auto model_file = std::filesystem::path(model_path).filename();
+		int num_matches = 0;
+		for (int i = 0; i < num_tracks; ++i) {
+			if (std::filesystem::path(scene->GetAnimationTrack(i).name).filename() == model_file) {
+				track_index = i;
+				++num_matches;
+			}
+		}
+
+		if (num_matches != 1) {
+			std::wstring msg = std::format(L"{} tracks of the scene are named {}, give the index of one\r\n", num_matches, model_file.wstring());
+			for (int i = 0; i < num_tracks; ++i) {
+				msg += std::format(L"{}: {}\r\n", i, scene->GetAnimationTrack(i).name);
+			}
+			MessageBox(NULL, msg.c_str(), L"Error", MB_OK);
+			return false;
+		}
+	}
+	else if (track_index >= num_tracks) {
+		return false;
+	}
+
+	Vmd vmd{};
+	if (!MotionConverter(translation_tolerance, rotation_tolerance).Convert(scene->GetAnimationTrack(track_index), pmx.Get(), vmd, info)) {
+		return false;
+	}
+
+	const auto saved = portable_mmd::SaveVmd(vmd_path, vmd);
+	if (!saved) {
+		auto msg = std::wstring(L"Failed to save\r\n") + vmd_path;
+		MessageBox(NULL, msg.c_str(), L"Error", MB_OK);
+	}
+
+	return saved;
+}
+
 } // namespace headless_mmd
@@ -5,6 +5,12 @@
 #include <vector>
 #include <ranges>
 #include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
 #include <windef.h>
@@ -24,10 +30,86 @@ struct Key {
 	T	value;
 };
 
+// position of one playback in a track. sequential frames advance it in amortized O(1),
+// seeks and scrubs gallop out from the last segment instead of searching the whole track.
+struct TrackCursor {
+	std::size_t index = 0;
+};
+
 template<typename T>
 struct Track {
 	std::vector<Key<T>> keys;
 
+	// frame may fall between two frames of the timeline
+	std::tuple<const T&, const T&, float> SearchNearValue(const float frame, TrackCursor& cursor) const {
+		if (frame <= static_cast<float>(keys.front().frame)) {
+			cursor.index = 0;
+			return { keys.front().value, keys.front().value, 0.f };
+		}
+		else if (frame >= static_cast<float>(keys.back().frame)) {
+			cursor.index = keys.size() - 1;
+			return { keys.back().value, keys.back().value, 0.f };
+		}
+
+		// key frames are whole, so the last key at or before the floor is also the last one before frame
+		cursor.index = Seek(static_cast<int>(std::floor(frame)), cursor.index);
+
+		auto& key0 = keys[cursor.index];
+		if (static_cast<float>(key0.frame) == frame) {
+			return { key0.value, key0.value, 0.f };
+		}
+
+		auto& key1 = keys[cursor.index + 1];
+		float s = (frame - static_cast<float>(key0.frame)) / static_cast<float>(key1.frame - key0.frame);
+		return { key0.value, key1.value, s };
+	}
+
+	// index of the last key at or before frame, which lies strictly inside the track
+	std::size_t Seek(const int frame, std::size_t hint) const {
+		const auto num_keys = keys.size();
+		hint = std::min(hint, num_keys - 1);
+
+		// gallop until keys[lo].frame <= frame < keys[hi].frame
+		std::size_t lo = hint;
+		std::size_t hi = hint;
+		if (keys[hint].frame <= frame) {
+			for (std::size_t step = 1; ; step *= 2) {
+				hi = std::min(lo + step, num_keys - 1);
+				if (keys[hi].frame > frame) {
+					break;
+				}
+				lo = hi;
+			}
+		}
+		else {
+			for (std::size_t step = 1; ; step *= 2) {
+				lo = hi > step ? hi - step : 0;
+				if (keys[lo].frame <= frame) {
+					break;
+				}
+				hi = lo;
+			}
+		}
+
+		// forward playback ends here, still in the segment or in the next one
+		if (hi - lo == 1) {
+			return lo;
+		}
+
+		auto it = std::upper_bound(keys.begin() + lo + 1, keys.begin() + hi, frame, [](int f, const Key<T>& key) { return f < key.frame; });
+		return static_cast<std::size_t>(it - keys.begin()) - 1;
+	}
+
+	T CalcAt(const float frame, TrackCursor& cursor) const {
+		auto [value0, value1, s] = SearchNearValue(frame, cursor);
+		if (s == 0.f) {
+			return value0;
+		}
+		else {
+			return Interpolate(value0, value1, s);
+		}
+	}
+
 	std::tuple<const T&, const T&, float> SearchNearValue(const int frame) const {
 		if (frame <= keys.front().frame) {
 			return { keys.front().value, keys.front().value, 0.f };
@@ -79,32 +161,143 @@ struct Track {
 	}
 };
 
+// one sample per frame, indexed by frame with no key frame stored. it either owns its samples
+// or views memory kept alive by an owner, such as a mapped capture file. the view needs no
+// alignment, samples are copied out on access.
+template<typename T> requires std::is_trivially_copyable_v<T>
+class DenseTrack {
+public:
+	DenseTrack() = default;
+
+	explicit DenseTrack(std::vector<T> samples) {
+		auto storage = std::make_shared<const std::vector<T>>(std::move(samples));
+		data_ = reinterpret_cast<const std::byte*>(storage->data());
+		size_ = storage->size();
+		owner_ = std::move(storage);
+	}
+
+	DenseTrack(const void* data, std::size_t size, std::shared_ptr<const void> owner) :
+		owner_(std::move(owner)),
+		data_(static_cast<const std::byte*>(data)),
+		size_(size) {
+	}
+
+	T operator[](std::size_t index) const noexcept {
+		T value;
+		std::memcpy(&value, data_ + index * sizeof(T), sizeof(T));
+		return value;
+	}
+
+	T GetByIndex(const int index) const {
+		return (*this)[static_cast<std::size_t>(std::clamp<int>(index, 0, static_cast<int>(size_) - 1))];
+	}
+
+	std::size_t Size() const noexcept {
+		return size_;
+	}
+
+	bool IsEmpty() const noexcept {
+		return size_ == 0;
+	}
+
+private:
+	std::shared_ptr<const void> owner_{};
+	const std::byte* data_ = nullptr;
+	std::size_t size_ = 0;
+};
+
 struct ModelInfo {
 	std::vector<std::wstring> morph_names;
 	std::vector<int>		  morph_categories;
 };
 
+// LoadModel replies once the morphs are read, the rest of the model is imported afterwards
+enum class ModelState {
+	None,
+	Importing,
+	Ready,
+	Failed,	// the morph values of the failed model are dropped, updates leave them out
+};
+
+// where the morph weights of the models come from
+enum class MorphSource {
+	Values,		// the values given to Update
+	Animation,	// the morph tracks of the loaded scene, the values given to Update are kept but not applied
+};
+
 struct AnimationInfo {
 	int num_frames;
 	std::vector<Track<float>> morph_animation;
 };
 
+// keys given to a save and keys written by it
+struct KeyReductionInfo {
+	std::size_t num_keys = 0;
+	std::size_t num_saved_keys = 0;
+
+	double GetCompressionRatio() const {
+		return num_saved_keys != 0 ? static_cast<double>(num_keys) / static_cast<double>(num_saved_keys) : 1.;
+	}
+};
+
+// models playing the same animation on the same rig evaluate their pose once per frame.
+// a miss is an evaluation, a hit a model that copied the pose instead.
+struct PoseCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+
+	double GetHitRate() const {
+		const auto total = hits + misses;
+		return total != 0 ? static_cast<double>(hits) / static_cast<double>(total) : 0.;
+	}
+};
+
+// frames kept for scrubbing back to, summed over the models: a pose and the morphed vertices of each frame
+struct ScrubCacheStats {
+	std::size_t budget = 0;		// per model
+	std::size_t bytes = 0;
+	std::size_t entries = 0;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+};
+
 
 class HeadlessMmdEngine {
 public:
 	bool Start(HWND hwnd);
 	void Stop();
 
-	void Update(int frame);
-	void Update(int frame, int morph_index, float morph_value);
-	void Update(int frame, const std::vector<float>& morph_values);
+	// frame is on the 30 fps timeline and may fall between its frames, for displays that refresh faster.
+	// whole frames convert to it, so an int or a double frame calls the same overload.
+	void Update(float frame);
+	void Update(float frame, int morph_index, float morph_value);
+	void Update(float frame, const std::vector<float>& morph_values);
 
 	bool LoadModel(const std::wstring& path, ModelInfo& info);
 	bool LoadScene(const std::wstring& path, AnimationInfo& info);
 
+	// state of the last model LoadModel replied for
+	ModelState GetModelState();
+
+	void SetMorphSource(MorphSource source);
+
+	PoseCacheStats GetPoseCacheStats();
+
+	// bytes per model kept of the frames a seek reached, so that scrubbing back to one is a copy. 0, the default, turns it off.
+	void SetScrubCacheBudget(std::size_t bytes);
+	ScrubCacheStats GetScrubCacheStats();
+
 	static bool SaveMorphAnimation(const std::wstring& path, const std::vector<std::string>& morph_names, const std::vector<Track<float>>& animation, const std::string& model_name);
 	static bool SaveMorphAnimation(const std::wstring& path, const std::vector<std::string>& morph_names, const std::vector<std::vector<int32_t>>& frame_tracks, const std::vector<std::vector<float>>& value_tracks, const std::string& model_name);
 
+	// drops the keys that the others interpolate to within tolerance, every key when it is negative
+	static bool SaveMorphAnimation(const std::wstring& path, const std::vector<std::string>& morph_names, const std::vector<std::vector<int32_t>>& frame_tracks, const std::vector<std::vector<float>>& value_tracks, const std::string& model_name, float tolerance, KeyReductionInfo* info = nullptr);
+
+	// the motion of a model in a capture as vmd keys, each bone within the tolerances of every captured frame.
+	// a negative track_index finds the track named after the model file, and fails unless exactly one is.
+	static bool ConvertSceneToVmd(const std::wstring& scene_path, const std::wstring& model_path, const std::wstring& vmd_path, float translation_tolerance, float rotation_tolerance, KeyReductionInfo* info = nullptr, int track_index = -1);
+
 private:
 	HeadlessMmdEngine();
 	~HeadlessMmdEngine();
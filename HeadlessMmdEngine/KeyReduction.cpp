@@ -0,0 +1,171 @@
+#include "pch.h"
+#include "KeyReduction.h"
+
+namespace headless_mmd {
+
+namespace {
+
+// FitInterpolation starts from every pair of these x handles and then closes in on the best one
+constexpr int8_t CoarseHandles[] = { 0, 21, 42, 64, 85, 106, 127 };
+constexpr int RefineSteps[] = { 8, 4, 2, 1 };
+
+// the handles are fitted to this many samples at most, spread over the segment
+constexpr std::size_t MaxFittedSamples = 32;
+
+}
+
+std::vector<std::size_t> ReduceLinearKeys(std::span<const int32_t> frames, std::span<const float> values, float tolerance) {
+	const auto num_keys = std::min(frames.size(), values.size());
+
+	std::vector<std::size_t> kept(num_keys);
+	std::iota(kept.begin(), kept.end(), std::size_t{ 0 });
+
+	if (num_keys <= 2 || std::adjacent_find(frames.begin(), frames.begin() + num_keys, std::greater_equal<>{}) != frames.begin() + num_keys) {
+		return kept;
+	}
+
+	std::vector<bool> keep(num_keys, false);
+	keep.front() = true;
+	keep.back() = true;
+
+	// the error of a piecewise linear fit peaks at a key, so only the keys are measured
+	std::vector<std::pair<std::size_t, std::size_t>> spans{ { 0, num_keys - 1 } };
+	while (!spans.empty()) {
+		const auto [first, last] = spans.back();
+		spans.pop_back();
+
+		const auto f0 = static_cast<float>(frames[first]);
+		const auto v0 = values[first];
+		const auto slope = (values[last] - v0) / (static_cast<float>(frames[last]) - f0);
+
+		std::size_t worst = first;
+		float worst_error = tolerance;
+		for (auto i = first + 1; i < last; ++i) {
+			const auto error = std::abs(values[i] - (v0 + slope * (static_cast<float>(frames[i]) - f0)));
+			if (error > worst_error) {
+				worst = i;
+				worst_error = error;
+			}
+		}
+
+		if (worst != first) {
+			keep[worst] = true;
+			spans.emplace_back(first, worst);
+			spans.emplace_back(worst, last);
+		}
+	}
+
+	kept.clear();
+	for (std::size_t i = 0; i < num_keys; ++i) {
+		if (keep[i]) {
+			kept.push_back(i);
+		}
+	}
+	return kept;
+}
+
+portable_mmd::Interpolation FitInterpolation(std::span<const float> times, std::span<const float> progress) {
+	const auto num_samples = std::min(times.size(), progress.size());
+	if (num_samples < 2) {
+		// matching handles on the diagonal, a straight line
+		return portable_mmd::DefaultInterpolation;
+	}
+
+	std::vector<double> xs{};
+	std::vector<double> ps{};
+	const auto stride = (num_samples + MaxFittedSamples - 1) / MaxFittedSamples;
+	for (std::size_t i = 0; i < num_samples; i += stride) {
+		xs.push_back(std::clamp(static_cast<double>(times[i]), 0., 1.));
+		ps.push_back(progress[i]);
+	}
+
+	portable_mmd::Interpolation best = portable_mmd::DefaultInterpolation;
+	double best_error = std::numeric_limits<double>::infinity();
+
+	// fits the y handles for a placement of the x handles, keeping it when it strays least so far
+	std::vector<double> params(xs.size());
+	auto Try = [&](int hx1, int hx2) {
+		const double x1 = hx1 / 127.;
+		const double x2 = hx2 / 127.;
+		auto X = [=](double t) { return ((3. * x1 - 3. * x2 + 1.) * t + (-6. * x1 + 3. * x2)) * t * t + 3. * x1 * t; };
+		auto Slope = [=](double t) { return (3. * (3. * x1 - 3. * x2 + 1.) * t + 2. * (-6. * x1 + 3. * x2)) * t + 3. * x1; };
+
+		// the curve parameter of each sample, newton kept inside a bisection bracket
+		for (std::size_t i = 0; i < xs.size(); ++i) {
+			double lo = 0., hi = 1., t = xs[i];
+			for (int k = 0; k < 32; ++k) {
+				const double fx = X(t) - xs[i];
+				if (std::abs(fx) < 1e-7) {
+					break;
+				}
+				(fx < 0. ? lo : hi) = t;
+				const double next = t - fx / Slope(t);
+				t = (next > lo && next < hi) ? next : 0.5 * (lo + hi);
+			}
+			params[i] = t;
+		}
+
+		// p(t) = a(t) y1 + b(t) y2 + t^3, solved from the normal equations
+		double aa = 0., ab = 0., bb = 0., ar = 0., br = 0.;
+		for (std::size_t i = 0; i < xs.size(); ++i) {
+			const double t = params[i];
+			const double a = 3. * (1. - t) * (1. - t) * t;
+			const double b = 3. * (1. - t) * t * t;
+			const double r = ps[i] - t * t * t;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			ar += a * r;
+			br += b * r;
+		}
+
+		const double det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-12) {
+			return;
+		}
+
+		const auto y1 = std::round(std::clamp((ar * bb - br * ab) / det, 0., 1.) * 127.);
+		const auto y2 = std::round(std::clamp((br * aa - ar * ab) / det, 0., 1.) * 127.);
+
+		// measured with the handles as a key stores them
+		double error = 0.;
+		for (std::size_t i = 0; i < xs.size(); ++i) {
+			const double t = params[i];
+			const double y = 3. * (1. - t) * (1. - t) * t * (y1 / 127.) + 3. * (1. - t) * t * t * (y2 / 127.) + t * t * t;
+			error = std::max(error, std::abs(y - ps[i]));
+		}
+
+		if (error < best_error) {
+			best_error = error;
+			best = { static_cast<int8_t>(hx1), static_cast<int8_t>(hx2), static_cast<int8_t>(y1), static_cast<int8_t>(y2) };
+		}
+	};
+
+	for (const auto hx1 : CoarseHandles) {
+		for (const auto hx2 : CoarseHandles) {
+			Try(hx1, hx2);
+		}
+	}
+
+	// each step walks downhill until none of the neighbours strays less
+	for (const auto step : RefineSteps) {
+		for (bool moved = true; moved;) {
+			const int cx1 = best.x1;
+			const int cx2 = best.x2;
+			for (int dx1 = -step; dx1 <= step; dx1 += step) {
+				for (int dx2 = -step; dx2 <= step; dx2 += step) {
+					const int hx1 = cx1 + dx1;
+					const int hx2 = cx2 + dx2;
+					if ((dx1 != 0 || dx2 != 0) && hx1 >= 0 && hx1 <= 127 && hx2 >= 0 && hx2 <= 127) {
+						Try(hx1, hx2);
+					}
+				}
+			}
+			moved = best.x1 != cx1 || best.x2 != cx2;
+		}
+	}
+
+	return best;
+}
+
+}
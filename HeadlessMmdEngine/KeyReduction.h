@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include "portable_mmd.h"
+
+namespace headless_mmd {
+
+// the keys of a linearly interpolated track to keep, so that interpolating between them stays within
+// tolerance of every original key. a Ramer-Douglas-Peucker fit on the value, which drops constant and
+// collinear runs. the first and last keys are always kept, and tracks whose frames do not increase
+// are kept whole.
+std::vector<std::size_t> ReduceLinearKeys(std::span<const int32_t> frames, std::span<const float> values, float tolerance);
+
+// the vmd curve closest to the progress of a segment sampled at times, both in [0, 1]. the y handles
+// are a least squares fit for a placement of the x handles, kept to what a key can store, and the
+// placement is searched from a coarse grid down to single steps. linear when nothing pins them down.
+portable_mmd::Interpolation FitInterpolation(std::span<const float> times, std::span<const float> progress);
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <list>
+#include <map>
+#include <cstddef>
+#include <cstdint>
+
+namespace headless_mmd {
+
+struct LruCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	std::size_t bytes = 0;
+	std::size_t entries = 0;
+
+	LruCacheStats& operator+=(const LruCacheStats& other) {
+		hits += other.hits;
+		misses += other.misses;
+		evictions += other.evictions;
+		bytes += other.bytes;
+		entries += other.entries;
+		return *this;
+	}
+};
+
+// the most recently used values within a byte budget. the storage of an evicted value is
+// handed to the next Insert, so a full cache allocates nothing but the index node.
+// without a budget the cache is off: it finds nothing and counts no misses.
+template<typename Key, typename Value>
+class LruCache {
+public:
+	using Stats = LruCacheStats;
+
+	explicit LruCache(std::size_t budget = 0) :
+		budget_(budget) {
+	}
+
+	// the value of the key, which becomes the most recently used, or nullptr
+	const Value* Find(const Key& key) {
+		if (budget_ == 0) {
+			return nullptr;
+		}
+
+		auto it = index_.find(key);
+		if (it == index_.end()) {
+			++stats_.misses;
+			return nullptr;
+		}
+
+		++stats_.hits;
+		entries_.splice(entries_.begin(), entries_, it->second);
+		return &it->second->value;
+	}
+
+	// a slot for the value of the key, holding whatever an older value left in it.
+	// nullptr when bytes exceed the whole budget.
+	Value* Insert(const Key& key, std::size_t bytes) {
+		std::list<Entry> spare{};
+		if (auto it = index_.find(key); it != index_.end()) {
+			Remove(it->second, spare);
+		}
+
+		if (bytes > budget_) {
+			return nullptr;
+		}
+
+		while (stats_.bytes + bytes > budget_) {
+			Evict(spare);
+		}
+
+		if (spare.empty()) {
+			entries_.emplace_front();
+		}
+		else {
+			entries_.splice(entries_.begin(), spare, spare.begin());
+		}
+
+		auto& entry = entries_.front();
+		entry.key = key;
+		entry.bytes = bytes;
+		index_.emplace(key, entries_.begin());
+
+		stats_.bytes += bytes;
+		++stats_.entries;
+		return &entry.value;
+	}
+
+	void SetBudget(std::size_t budget) {
+		budget_ = budget;
+
+		std::list<Entry> spare{};
+		while (stats_.bytes > budget_) {
+			Evict(spare);
+		}
+	}
+
+	void Clear() {
+		index_.clear();
+		entries_.clear();
+		stats_.bytes = 0;
+		stats_.entries = 0;
+	}
+
+	std::size_t GetBudget() const {
+		return budget_;
+	}
+
+	const Stats& GetStats() const {
+		return stats_;
+	}
+
+private:
+	struct Entry {
+		Key key{};
+		Value value{};
+		std::size_t bytes = 0;
+	};
+
+	std::size_t budget_ = 0;
+	std::list<Entry> entries_{};	// the most recently used first
+	std::map<Key, typename std::list<Entry>::iterator> index_{};
+	Stats stats_{};
+
+	void Remove(typename std::list<Entry>::iterator it, std::list<Entry>& spare) {
+		stats_.bytes -= it->bytes;
+		--stats_.entries;
+		index_.erase(it->key);
+		spare.splice(spare.begin(), entries_, it);
+	}
+
+	void Evict(std::list<Entry>& spare) {
+		Remove(std::prev(entries_.end()), spare);
+		++stats_.evictions;
+	}
+};
+
+}
@@ -32,10 +32,26 @@ inline Vector vector_add(const Vector& v1, const Vector& v2) {
 	return DirectX::XMVectorAdd(v1, v2);
 }
 
+inline Vector vector_sub(const Vector& v1, const Vector& v2) {
+	return DirectX::XMVectorSubtract(v1, v2);
+}
+
 inline Vector vector_mul(const Vector& v, const float s) {
 	return DirectX::XMVectorScale(v, s);
 }
 
+inline float vector3_dot(const Vector& v1, const Vector& v2) {
+	return DirectX::XMVectorGetX(DirectX::XMVector3Dot(v1, v2));
+}
+
+inline Vector vector3_cross(const Vector& v1, const Vector& v2) {
+	return DirectX::XMVector3Cross(v1, v2);
+}
+
+inline Vector vector3_transform(const Vector& v, const Matrix& m) {
+	return DirectX::XMVector3TransformCoord(v, m);
+}
+
 inline Vector vector3_normalize(float x, float y, float z) {
 	return DirectX::XMVector3Normalize({x, y, z});
 }
@@ -71,6 +87,54 @@ inline Quaternion quat_zero() {
 	return DirectX::XMQuaternionIdentity();
 }
 
+// rotation q1 followed by q2
+inline Quaternion quat_mul(const Quaternion& q1, const Quaternion& q2) {
+	return DirectX::XMQuaternionMultiply(q1, q2);
+}
+
+inline Quaternion quat_inverse(const Quaternion& q) {
+	return DirectX::XMQuaternionInverse(q);
+}
+
+inline Quaternion quat_slerp(const Quaternion& q0, const Quaternion& q1, float t) {
+	return DirectX::XMQuaternionSlerp(q0, q1, t);
+}
+
+inline Quaternion quat_rotation_axis(const Vector& axis, float angle) {
+	return DirectX::XMQuaternionRotationNormal(axis, angle);
+}
+
+// x: pitch, y: yaw, z: roll, the order of XMQuaternionRotationRollPitchYaw
+inline Quaternion quat_from_euler(const Vector& euler) {
+	return DirectX::XMQuaternionRotationRollPitchYawFromVector(euler);
+}
+
+// the rotation part of a rigid transform
+inline Quaternion quat_from_matrix(const Matrix& m) {
+	return DirectX::XMQuaternionNormalize(DirectX::XMQuaternionRotationMatrix(m));
+}
+
+inline float quat_dot(const Quaternion& q0, const Quaternion& q1) {
+	return DirectX::XMVectorGetX(DirectX::XMQuaternionDot(q0, q1));
+}
+
+// angle of the rotation from q0 to q1, from the chord so that it stays exact for small angles
+inline float quat_angle(const Quaternion& q0, const Quaternion& q1) {
+	const auto q = quat_dot(q0, q1) < 0.f ? DirectX::XMVectorNegate(q1) : q1;
+	const float chord = DirectX::XMVectorGetX(DirectX::XMVector4Length(DirectX::XMVectorSubtract(q0, q)));
+	return 4.f * std::asin(std::min(0.5f * chord, 1.f));
+}
+
+inline Vector quat_to_euler(const Quaternion& q) {
+	DirectX::XMFLOAT4X4 m{};
+	DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixRotationQuaternion(q));
+
+	const float pitch = std::asin(std::clamp(-m._32, -1.f, 1.f));
+	const float yaw = std::atan2(m._31, m._33);
+	const float roll = std::atan2(m._12, m._22);
+	return { pitch, yaw, roll, 0.f };
+}
+
 //
 // matrix
 //
@@ -94,6 +158,27 @@ inline Matrix matrix_translation(const Vector& v) {
 	return DirectX::XMMatrixTranslation(DirectX::XMVectorGetX(v), DirectX::XMVectorGetY(v), DirectX::XMVectorGetZ(v));
 }
 
+inline Matrix matrix_rotation_translation(const Quaternion& q, const Vector& v) {
+	auto m = DirectX::XMMatrixRotationQuaternion(q);
+	m.r[3] = DirectX::XMVectorSetW(v, 1.f);
+	return m;
+}
+
+// blends two affine transforms: scale and translation linearly, rotation by slerp
+inline Matrix matrix_blend(const Matrix& m0, const Matrix& m1, float t) {
+	Vector s0{}, r0{}, t0{};
+	Vector s1{}, r1{}, t1{};
+	if (!DirectX::XMMatrixDecompose(&s0, &r0, &t0, m0) || !DirectX::XMMatrixDecompose(&s1, &r1, &t1, m1)) {
+		return t < 0.5f ? m0 : m1;
+	}
+
+	return DirectX::XMMatrixAffineTransformation(DirectX::XMVectorLerp(s0, s1, t), DirectX::XMVectorZero(), DirectX::XMQuaternionSlerp(r0, r1, t), DirectX::XMVectorLerp(t0, t1, t));
+}
+
+inline Vector matrix_position(const Matrix& m) {
+	return m.r[3];
+}
+
 inline void store(Float4x4& dest, const Matrix& src) {
 	DirectX::XMStoreFloat4x4(&dest, src);
 }
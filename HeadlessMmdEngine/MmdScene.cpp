@@ -1,65 +1,203 @@
 #include "pch.h"
 #include "MmdScene.h"
+#include "mscap.h"
+
+namespace {
+
+using headless_mmd::Matrix;
+
+// where the blocks of one model lie in the file, found by skipping over them
+struct ModelBlocks {
+	std::string_view name{};
+	std::vector<std::string_view> bone_names{};
+	std::vector<int32_t> bone_frames{};
+	std::vector<std::span<const char>> bone_data{};	// v1 matrices or a v2 track, nothing in v3
+	int first_slot = 0;
+	std::vector<std::string_view> morph_names{};
+	std::vector<std::span<const char>> morph_keys{};
+};
+
+// the keys of a morph are copied in bulk
+static_assert(sizeof(headless_mmd::Key<float>) == sizeof(uint32_t) + sizeof(float));
+
+bool ScanText(portable_mmd::io::Reader& reader, std::string_view& text) {
+	const auto len = reader.Uint32();
+	const auto data = reader.Current();
+	if (!reader || !reader.Skip(len)) {
+		return false;
+	}
+
+	text = { data, len };
+	return true;
+}
+
+bool ScanBlock(portable_mmd::io::Reader& reader, std::size_t size, std::span<const char>& block) {
+	const auto data = reader.Current();
+	if (!reader.Skip(size)) {
+		return false;
+	}
+
+	block = { data, size };
+	return true;
+}
+
+bool ScanModel(portable_mmd::io::Reader& reader, uint32_t version, ModelBlocks& blocks) {
+	if (!ScanText(reader, blocks.name)) {
+		return false;
+	}
+
+	const auto num_bones = reader.Int32();
+	if (!reader || num_bones < 0) {
+		return false;
+	}
+
+	blocks.bone_names.resize(num_bones);
+	blocks.bone_frames.resize(num_bones);
+	blocks.bone_data.resize(num_bones);
+
+	for (int bi = 0; bi < num_bones; ++bi) {
+		if (!ScanText(reader, blocks.bone_names[bi])) {
+			return false;
+		}
+
+		// the frames of v3 are in the chunks after the camera
+		if (version >= mscap::Version3) {
+			continue;
+		}
+
+		const auto num_frames = reader.Int32();
+		if (!reader || num_frames < 0) {
+			return false;
+		}
+		blocks.bone_frames[bi] = num_frames;
+
+		const auto size = version == mscap::Version1 ? sizeof(Matrix) * static_cast<std::size_t>(num_frames) : reader.Uint32();
+		if (!reader || !ScanBlock(reader, size, blocks.bone_data[bi])) {
+			return false;
+		}
+
+		// v2 frames are decoded into memory, so the count is checked against the track before it is allocated
+		const auto& data = blocks.bone_data[bi];
+		if (version == mscap::Version2 && !mscap::CanHoldFrames(data.data(), data.size(), static_cast<std::size_t>(num_frames))) {
+			return false;
+		}
+	}
+
+	const auto num_morphs = reader.Int32();
+	if (!reader || num_morphs < 0) {
+		return false;
+	}
+
+	blocks.morph_names.resize(num_morphs);
+	blocks.morph_keys.resize(num_morphs);
+
+	for (int mi = 0; mi < num_morphs; ++mi) {
+		if (!ScanText(reader, blocks.morph_names[mi])) {
+			return false;
+		}
+
+		const auto num_keys = reader.Int32();
+		if (!reader || num_keys < 0 || !ScanBlock(reader, sizeof(headless_mmd::Key<float>) * static_cast<std::size_t>(num_keys), blocks.morph_keys[mi])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
 
 namespace headless_mmd {
 
+// the file is walked once to find the blocks of each model, which are then decoded concurrently.
+// each task fills its own map of one track.
 std::shared_ptr<MmdScene> MmdSceneImporter::Import(const std::wstring& path) {
 	auto scene = std::make_shared<MmdScene>();
 	auto& animation_tracks = scene->animation_tracks_;
 	auto& camera_track = scene->camera_track_;
 
-	auto bin = portable_mmd::io::LoadBinary(path);
-	if (bin.empty()) {
+	// the baked bone tracks view the mapping, which lives as long as any of them
+	auto file = std::make_shared<portable_mmd::io::MappedFile>(path);
+	if (!*file) {
 		return nullptr;
 	}
-	portable_mmd::io::Reader reader(bin.data(), bin.size());
+	portable_mmd::io::Reader reader(file->Data(), file->Size());
 
-	auto regulation = reader.Uint32();
-	if (regulation != 0b0111) {
+	const auto header = reader.Uint32();
+	const auto version = mscap::GetVersion(header);
+	if (mscap::GetFlags(header) != 0b0111 || version > mscap::LatestVersion) {
 		return nullptr;
 	}
 
 	auto num_animations = reader.Int32();
+	if (!reader || num_animations < 0) {
+		return nullptr;
+	}
 	DLOG(L"{} animations", num_animations);
 
+	std::vector<ModelBlocks> models(num_animations);
+	int num_slots = 0;
+
+	for (auto& blocks : models) {
+		if (!ScanModel(reader, version, blocks)) {
+			return nullptr;
+		}
+
+		blocks.first_slot = num_slots;
+		num_slots += static_cast<int>(blocks.bone_names.size());
+	}
+
 	animation_tracks.resize(num_animations);
 
+	std::vector<std::function<bool()>> tasks{};
 	for (int ai = 0; ai < num_animations; ++ai) {
-		auto model_name = SjisToUtf16(reader.TextA());
+		const auto& blocks = models[ai];
 		auto& animation_track = animation_tracks[ai];
-		auto& bone_animation = animation_track.bone_animation;
-		auto& morph_animation = animation_track.morph_animation;
 
-		auto num_bones = reader.Int32();
-		DLOG(L"{} bones", num_bones);
+		tasks.push_back([&blocks, &animation_track, &file, version] {
+			animation_track.name = SjisToUtf16(std::string(blocks.name));
 
-		for (int bi = 0; bi < num_bones; ++bi) {
-			auto name = SjisToUtf16(reader.TextA());
-			auto& track = bone_animation[name];
+			const cp932::NameTable<wchar_t> names(blocks.bone_names);
+			for (std::size_t bi = 0; bi < names.Size(); ++bi) {
+				auto name = std::wstring(names[bi]);
 
-			auto num_frames = reader.Int32();
-			track.resize(num_frames);
+				if (version >= mscap::Version3) {
+					animation_track.bone_slots[name] = blocks.first_slot + static_cast<int>(bi);
+					continue;
+				}
 
-			for (int fi = 0; fi < num_frames; ++fi) {
-				track[fi] = reader.As<Matrix>();
-			}
-		}
+				const auto num_frames = static_cast<std::size_t>(blocks.bone_frames[bi]);
+				const auto& data = blocks.bone_data[bi];
 
-		auto num_morphs = reader.Int32();
-		DLOG(L"{} morph", num_morphs);
+				if (version == mscap::Version1) {
+					animation_track.bone_animation[name] = DenseTrack<Matrix>(data.data(), num_frames, file);
+					continue;
+				}
 
-		for (int mi = 0; mi < num_morphs; ++mi) {
-			auto name = SjisToUtf16(reader.TextA());
-			auto& keys = morph_animation[name].keys;
+				auto frames = std::make_shared<std::vector<mscap::Matrix>>(num_frames);
+				if (!mscap::DecodeBoneTrack(data.data(), data.size(), frames->size(), frames->data())) {
+					return false;
+				}
+				animation_track.bone_animation[name] = DenseTrack<Matrix>(frames->data(), frames->size(), frames);
+			}
+			return true;
+		});
 
-			auto num_keys = reader.Int32();
-			keys.resize(num_keys);
+		tasks.push_back([&blocks, &animation_track] {
+			const cp932::NameTable<wchar_t> names(blocks.morph_names);
+			for (std::size_t mi = 0; mi < names.Size(); ++mi) {
+				const auto& data = blocks.morph_keys[mi];
+				auto& keys = animation_track.morph_animation[std::wstring(names[mi])].keys;
 
-			for (int ki = 0; ki < num_keys; ++ki) {
-				keys[ki].frame= reader.Uint32();
-				keys[ki].value = reader.Float();
+				keys.resize(data.size() / sizeof(Key<float>));
+				std::memcpy(keys.data(), data.data(), data.size());
 			}
-		}
+			return true;
+		});
+	}
+
+	if (!portable_mmd::io::RunTasks(tasks, 0)) {
+		return nullptr;
 	}
 
 	{
@@ -80,7 +218,73 @@ std::shared_ptr<MmdScene> MmdSceneImporter::Import(const std::wstring& path) {
 		std::ranges::sort(keys, {}, &Key<Vmd::CameraKey>::frame);
 	}
 
+	// the frames of v3 are left in the file until they play
+	if (version >= mscap::Version3) {
+		if (!reader) {
+			return nullptr;
+		}
+
+		auto stream = ImportStream(file, num_slots);
+		if (!stream) {
+			return nullptr;
+		}
+
+		for (auto& animation_track : animation_tracks) {
+			animation_track.bone_stream = stream;
+		}
+	}
+
 	return scene;
 }
 
+std::shared_ptr<MmdSceneStream> MmdSceneImporter::ImportStream(const std::shared_ptr<portable_mmd::io::MappedFile>& file, int num_slots) {
+	const auto file_size = file->Size();
+	if (file_size < mscap::FooterSize) {
+		return nullptr;
+	}
+
+	portable_mmd::io::Reader footer(file->Data() + file_size - mscap::FooterSize, mscap::FooterSize);
+	const auto index_offset = footer.As<uint64_t>();
+	if (index_offset > file_size - mscap::FooterSize) {
+		return nullptr;
+	}
+
+	portable_mmd::io::Reader reader(file->Data() + index_offset, file_size - mscap::FooterSize - static_cast<std::size_t>(index_offset));
+	const auto num_frames = reader.Int32();
+	const auto chunk_frames = reader.Int32();
+	const auto num_chunks = reader.Int32();
+	if (!reader || num_frames < 0 || chunk_frames <= 0 || num_chunks != mscap::GetNumChunks(num_frames, chunk_frames)) {
+		return nullptr;
+	}
+
+	// a chunk is decoded on the prefetch thread, where a failed allocation cannot be handled
+	if (num_frames > mscap::MaxFrames || chunk_frames > mscap::MaxFrames) {
+		return nullptr;
+	}
+	const auto chunk_samples = static_cast<std::size_t>(num_slots) * static_cast<std::size_t>(std::min(chunk_frames, num_frames));
+	if (chunk_samples > mscap::MaxChunkSamples) {
+		return nullptr;
+	}
+
+	// the entries have to be in the index before the vector for them is allocated
+	if (static_cast<std::size_t>(num_chunks) > reader.Remain() / sizeof(mscap::ChunkEntry)) {
+		return nullptr;
+	}
+
+	std::vector<mscap::ChunkEntry> chunks(static_cast<std::size_t>(num_chunks));
+	reader.Array(chunks.data(), chunks.size());
+	if (!reader) {
+		return nullptr;
+	}
+
+	for (const auto& chunk : chunks) {
+		if (chunk.offset > index_offset || chunk.size > index_offset - chunk.offset) {
+			return nullptr;
+		}
+	}
+	DLOG(L"{} frames in {} chunks", num_frames, num_chunks);
+
+	return std::make_shared<MmdSceneStream>(file, std::move(chunks), num_frames, chunk_frames, num_slots);
+}
+
 }
\ No newline at end of file
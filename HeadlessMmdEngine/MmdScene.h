@@ -2,13 +2,18 @@
 #include <vector>
 #include <map>
 #include "Common.h"
+#include "MmdSceneStream.h"
 
 namespace headless_mmd {
 
 struct MmdAnimationTrack {
 	std::wstring name{};
-	std::map<std::wstring, std::vector<Matrix>> bone_animation{};
+	std::map<std::wstring, DenseTrack<Matrix>>	bone_animation{};	// views of the mapped file in v1, decoded in v2
 	std::map<std::wstring, Track<float>>		morph_animation{};
+
+	// v3 streams the bones in chunks instead, leaving bone_animation empty
+	std::shared_ptr<MmdSceneStream>			bone_stream{};
+	std::map<std::wstring, int>				bone_slots{};	// index of each bone within a chunk
 };
 
 using MmdCameraTrack = Track<Vmd::CameraKey>;
@@ -45,6 +50,9 @@ public:
 class MmdSceneImporter {
 public:
 	std::shared_ptr<MmdScene> Import(const std::wstring& path);
+
+private:
+	std::shared_ptr<MmdSceneStream> ImportStream(const std::shared_ptr<portable_mmd::io::MappedFile>& file, int num_slots);
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "MmdSceneStream.h"
+
+namespace headless_mmd {
+
+MmdSceneStream::MmdSceneStream(std::shared_ptr<portable_mmd::io::MappedFile> file, std::vector<mscap::ChunkEntry> chunks, int num_frames, int chunk_frames, int num_slots) :
+	file_(std::move(file)),
+	chunks_(std::move(chunks)),
+	num_frames_(num_frames),
+	chunk_frames_(chunk_frames),
+	num_slots_(num_slots) {
+	worker_ = std::thread([this] { Prefetch(); });
+}
+
+MmdSceneStream::~MmdSceneStream() {
+	{
+		std::lock_guard lock(mtx_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+
+	worker_.join();
+}
+
+std::shared_ptr<const MmdSceneChunk> MmdSceneStream::Acquire(int frame) {
+	if (chunks_.empty()) {
+		return nullptr;
+	}
+
+	const int index = std::clamp(frame, 0, num_frames_ - 1) / chunk_frames_;
+
+	// chunks that left the window are released outside the lock
+	std::vector<std::shared_ptr<const MmdSceneChunk>> evicted{};
+	{
+		std::lock_guard lock(mtx_);
+		if (index != playhead_) {
+			playhead_ = index;
+
+			for (auto it = resident_.begin(); it != resident_.end();) {
+				if (IsInWindow(it->first)) {
+					++it;
+					continue;
+				}
+				evicted.emplace_back(std::move(it->second));
+				it = resident_.erase(it);
+			}
+			wake_.notify_one();
+		}
+
+		if (auto it = resident_.find(index); it != resident_.end()) {
+			return it->second;
+		}
+	}
+
+	auto chunk = Decode(index);
+
+	// the worker may have decoded it meanwhile
+	std::lock_guard lock(mtx_);
+	auto [it, inserted] = resident_.try_emplace(index, std::move(chunk));
+	return it->second;
+}
+
+std::shared_ptr<const MmdSceneChunk> MmdSceneStream::Decode(int index) const {
+	auto chunk = std::make_shared<MmdSceneChunk>();
+	chunk->first_frame = index * chunk_frames_;
+	chunk->num_frames = std::min(chunk_frames_, num_frames_ - chunk->first_frame);
+
+	const auto num_frames = static_cast<std::size_t>(chunk->num_frames);
+	chunk->samples.resize(static_cast<std::size_t>(num_slots_) * num_frames, mscap::IdentityMatrix);
+
+	// a broken track leaves the rest of the chunk at identity
+	const auto& entry = chunks_[index];
+	portable_mmd::io::Reader reader(file_->Data() + entry.offset, entry.size);
+	for (int slot = 0; slot < num_slots_; ++slot) {
+		const auto size = reader.Uint32();
+		const auto data = reader.Current();
+		if (!reader || !reader.Skip(size) || !mscap::DecodeBoneTrack(data, size, num_frames, &chunk->samples[slot * num_frames])) {
+			DLOG(L"chunk {} is broken at slot {}", index, slot);
+			break;
+		}
+	}
+
+	return chunk;
+}
+
+bool MmdSceneStream::IsInWindow(int index) const {
+	return index >= playhead_ - NumChunksBehind && index <= playhead_ + NumChunksAhead;
+}
+
+int MmdSceneStream::FindMissing() const {
+	const int last = std::min(playhead_ + NumChunksAhead, static_cast<int>(chunks_.size()) - 1);
+	for (int index = playhead_; index <= last; ++index) {
+		if (!resident_.contains(index)) {
+			return index;
+		}
+	}
+	return -1;
+}
+
+void MmdSceneStream::Prefetch() {
+	std::unique_lock lock(mtx_);
+	while (true) {
+		wake_.wait(lock, [this] { return stop_ || FindMissing() >= 0; });
+		if (stop_) {
+			return;
+		}
+
+		const int index = FindMissing();
+		lock.unlock();
+		auto chunk = Decode(index);
+		lock.lock();
+
+		// the playhead may have jumped while decoding
+		if (IsInWindow(index)) {
+			resident_.try_emplace(index, std::move(chunk));
+		}
+	}
+}
+
+}
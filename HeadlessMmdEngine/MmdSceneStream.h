@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "Common.h"
+#include "mscap.h"
+
+namespace headless_mmd {
+
+// every bone of every model of a capture over the frames of one chunk, bone major
+struct MmdSceneChunk {
+	int first_frame = 0;
+	int num_frames = 0;
+	std::vector<mscap::Matrix> samples{};
+
+	bool Contains(int frame) const noexcept {
+		return frame >= first_frame && frame < first_frame + num_frames;
+	}
+
+	Matrix Get(int slot, int frame) const noexcept {
+		const auto fi = std::clamp(frame - first_frame, 0, num_frames - 1);
+		Matrix value;
+		std::memcpy(&value, samples[static_cast<std::size_t>(slot * num_frames + fi)].data(), sizeof(Matrix));
+		return value;
+	}
+};
+
+// the bone tracks of an mscap v3 capture, decoded chunk by chunk from the mapped file. the chunks
+// around the playhead stay resident and a worker decodes the ones ahead of it, so memory does not
+// grow with the length of the capture.
+class MmdSceneStream {
+public:
+	static constexpr int NumChunksBehind = 1;
+	static constexpr int NumChunksAhead = 2;
+
+	MmdSceneStream(std::shared_ptr<portable_mmd::io::MappedFile> file, std::vector<mscap::ChunkEntry> chunks, int num_frames, int chunk_frames, int num_slots);
+	~MmdSceneStream();
+
+	MmdSceneStream(const MmdSceneStream&) = delete;
+	MmdSceneStream& operator=(const MmdSceneStream&) = delete;
+
+	// the chunk holding the frame, moving the playhead there. decoded on the caller when the
+	// worker has not got to it, as after a seek. nullptr when the capture has no frames.
+	std::shared_ptr<const MmdSceneChunk> Acquire(int frame);
+
+	int GetNumFrames() const {
+		return num_frames_;
+	}
+
+	int GetNumSlots() const {
+		return num_slots_;
+	}
+
+private:
+	std::shared_ptr<portable_mmd::io::MappedFile> file_;
+	std::vector<mscap::ChunkEntry> chunks_;
+	int num_frames_ = 0;
+	int chunk_frames_ = 0;
+	int num_slots_ = 0;
+
+	std::mutex mtx_{};
+	std::condition_variable wake_{};
+	std::map<int, std::shared_ptr<const MmdSceneChunk>> resident_{};
+	int playhead_ = 0;
+	bool stop_ = false;
+	std::thread worker_{};
+
+	std::shared_ptr<const MmdSceneChunk> Decode(int index) const;
+	bool IsInWindow(int index) const;
+	int FindMissing() const;
+	void Prefetch();
+};
+
+}
@@ -2,41 +2,155 @@
 #include "Model.h"
 
 namespace headless_mmd {
+namespace {
 
-void Model::Update(DxContext* context, int frame_no, const std::vector<float>& morph_values) {
+// forward playback moves at most this far per update: half a frame at 60 Hz, or a few frames when updates are dropped
+constexpr float MaxPlaybackStep = 2.f;
+
+bool IsSeek(float frame, float last_frame) {
+	return !(frame > last_frame && frame - last_frame <= MaxPlaybackStep);
+}
+
+}
+
+void Model::Update(DxContext* context, float frame, const std::vector<float>& morph_values) {
 	(void)context;
 
+	UpdateMorphs(frame, morph_values);
+	UpdatePose(frame);
+}
+
+void Model::UpdateMorphs(float frame, const std::vector<float>& morph_values) {
+	const bool seek = IsSeek(frame, last_morph_update_frame_);
+	last_morph_update_frame_ = frame;
+
 	auto num_morphs = skinned_mesh_->GetNumMorphs();
 	if (num_morphs == static_cast<int>(morph_values.size())) {
 		for (int i = 0; i < num_morphs; ++i) {
 			skinned_mesh_->SetMorph(i, morph_values[i]);
 		}
-		skinned_mesh_->Update();
+		skinned_mesh_->Update(seek);
+
+		// the weights no longer hold the animation's, even at the frame it last evaluated
+		last_morph_frame_ = -1.f;
+		return;
+	}
+
+	// without values from the caller the morphs follow the animation
+	if (!animation_ || !morph_values.empty() || num_morphs == 0 || animation_->GetNumMorphTracks() != num_morphs) {
+		return;
+	}
+
+	frame = std::clamp(frame, 0.f, static_cast<float>(animation_->GetNumFrames()));
+	if (frame == last_morph_frame_) {
+		return;
 	}
 
+	animation_->EvaluateMorphs(frame, cursor_, skinned_mesh_->GetMorphValues());
+	skinned_mesh_->Update(seek);
+
+	last_morph_frame_ = frame;
+}
+
+void Model::UpdatePose(float frame) {
 	if (!animation_) {
 		return;
 	}
 
-	frame_no = std::clamp<int>(frame_no, 0, animation_->GetNumFrames());
-	if (frame_no == last_frame_no_) {
+	frame = std::clamp(frame, 0.f, static_cast<float>(animation_->GetNumFrames()));
+	if (frame == last_pose_frame_) {
+		return;
+	}
+
+	const bool seek = IsSeek(frame, last_pose_frame_);
+	const auto num_bones = skeleton_->GetNumBones();
+	if (const auto* output = scrub_cache_.Find(frame)) {
+		for (int i = 0; i < num_bones; ++i) {
+			skeleton_->SetPose(i, output->poses[i]);
+		}
+		skeleton_->SetPalette(output->palette);
+
+		last_pose_frame_ = frame;
+		return;
+	}
+
+	if (animation_->HasMotion()) {
+		animation_->EvaluateMotion(frame, cursor_, *skeleton_);
+		skeleton_->SolvePose();
+	}
+	else {
+		animation_->EvaluateBones(frame, cursor_, *skeleton_);
+	}
+	skeleton_->Update();
+
+	if (auto* output = seek ? scrub_cache_.Insert(frame, GetPoseOutputSize()) : nullptr) {
+		output->poses.resize(num_bones);
+		for (int i = 0; i < num_bones; ++i) {
+			output->poses[i] = skeleton_->GetPose(i);
+		}
+		output->palette = skeleton_->GetPalette();
+	}
+
+	last_pose_frame_ = frame;
+}
+
+void Model::UpdatePose(float frame, PoseCache::Pose& shared, bool reuse) {
+	const auto num_bones = skeleton_->GetNumBones();
+	if (!reuse || !shared.has_bones || static_cast<int>(shared.bones.size()) != num_bones) {
+		UpdatePose(frame);
+
+		// the skeleton holds this frame's pose even when the update was skipped
+		if (!reuse && animation_) {
+			shared.bones.resize(num_bones);
+			for (int i = 0; i < num_bones; ++i) {
+				shared.bones[i] = skeleton_->GetPose(i);
+			}
+			shared.has_bones = true;
+		}
+		return;
+	}
+
+	frame = std::clamp(frame, 0.f, static_cast<float>(animation_->GetNumFrames()));
+	if (frame == last_pose_frame_) {
 		return;
 	}
 
-	for (int i = 0, num_bones = animation_->GetNumBoneTracks(); i < num_bones; ++i) {
-		skeleton_->SetPose(i, animation_->GetBoneKey(i, frame_no));
+	for (int i = 0; i < num_bones; ++i) {
+		skeleton_->SetPose(i, shared.bones[i]);
 	}
 	skeleton_->Update();
 
-	last_frame_no_ = frame_no;
+	last_pose_frame_ = frame;
 }
 
 void Model::SetAnimation(const std::shared_ptr<Animation>& animation) {
 	animation_ = animation;
-	last_frame_no_ = -1;
+	cursor_ = animation ? animation->MakeCursor() : Animation::Cursor{};
+	last_morph_frame_ = -1.f;
+	last_pose_frame_ = -1.f;
+	scrub_cache_.Clear();
+}
+
+void Model::SetScrubCacheBudget(std::size_t bytes) {
+	const auto pose_size = static_cast<double>(GetPoseOutputSize());
+	const auto mesh_size = static_cast<double>(skinned_mesh_->GetCacheEntrySize());
+	const auto pose_bytes = pose_size + mesh_size > 0. ? static_cast<std::size_t>(static_cast<double>(bytes) * pose_size / (pose_size + mesh_size)) : 0;
+
+	scrub_cache_.SetBudget(pose_bytes);
+	skinned_mesh_->SetCacheBudget(bytes - pose_bytes);
+}
+
+LruCacheStats Model::GetScrubCacheStats() const {
+	auto stats = scrub_cache_.GetStats();
+	stats += skinned_mesh_->GetCacheStats();
+	return stats;
+}
+
+std::size_t Model::GetPoseOutputSize() const {
+	return (sizeof(Matrix) + sizeof(Float4x4)) * skeleton_->GetNumBones();
 }
 
-std::shared_ptr<Model> ModelImporter::Import(DxContext* context, const Pmx& pmx, const std::wstring& path) {
+std::shared_ptr<Model> ModelImporter::Import(DxContext* context, LazyPmx& pmx, const std::wstring& path) {
 	auto model = std::make_shared<Model>();
 
 	auto skinned_mesh = SkinnedMeshImporter().Import(context, pmx, path, model.get());
@@ -45,7 +159,7 @@ std::shared_ptr<Model> ModelImporter::Import(DxContext* context, const Pmx& pmx,
 	}
 	model->skinned_mesh_ = skinned_mesh;
 
-	auto skeleton = SkeletonImporter().Import(context, pmx, model.get());
+	auto skeleton = SkeletonImporter().Import(context, pmx.Get(), model.get());
 	if (!skeleton) {
 		return nullptr;
 	}
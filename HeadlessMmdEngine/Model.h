@@ -5,20 +5,48 @@
 #include "SkinnedMesh.h"
 #include "Skeleton.h"
 #include "Animation.h"
+#include "PoseCache.h"
+#include "LruCache.h"
 #include "Material.h"
 
 namespace headless_mmd {
 
 class Model {
 public:
-	void Update(DxContext* context, int frame_no, const std::vector<float>& morph_values);
+	void Update(DxContext* context, float frame, const std::vector<float>& morph_values);
 	void SetAnimation(const std::shared_ptr<Animation>& animation);
 
+	// the two halves of Update. they touch disjoint state, so they may run concurrently.
+	void UpdateMorphs(float frame, const std::vector<float>& morph_values);
+	void UpdatePose(float frame);
+
+	// the same with a pose shared by models playing the same animation on the same rig. the first of them
+	// evaluates it and fills shared, the others (reuse) copy it, which must wait until the first one is done.
+	// morphs are not shared: the timeline evaluates all of them in one call already.
+	void UpdatePose(float frame, PoseCache::Pose& shared, bool reuse);
+
+	// bytes kept of frames reached by a seek, so that scrubbing back to one is a copy. frames reached by
+	// playing forward are not kept, playback would only evict the frames a scrub visited. the budget is
+	// shared out between the poses and the morph offsets, a frame needing one of each. 0, the cache off, until set.
+	void SetScrubCacheBudget(std::size_t bytes);
+	LruCacheStats GetScrubCacheStats() const;
+
 private:
 	std::shared_ptr<SkinnedMesh>	skinned_mesh_{};
 	std::shared_ptr < Skeleton>		skeleton_{};
 	std::shared_ptr<Animation>		animation_{};
-	int last_frame_no_ = -1;
+	Animation::Cursor				cursor_{};
+	float last_morph_frame_ = -1.f;		// the frame the animation's morphs were evaluated at
+	float last_pose_frame_ = -1.f;
+	float last_morph_update_frame_ = -1.f;	// from either source of morphs
+
+	struct PoseOutput {
+		std::vector<Matrix>		poses{};
+		std::vector<Float4x4>	palette{};
+	};
+	LruCache<float, PoseOutput> scrub_cache_{};
+
+	std::size_t GetPoseOutputSize() const;
 
 	friend class ModelImporter;
 
@@ -27,6 +55,10 @@ public:
 		return skinned_mesh_;
 	}
 
+	const std::shared_ptr<Animation>& GetAnimation() const {
+		return animation_;
+	}
+
 	const std::shared_ptr<Skeleton>& GetSkeleton() const {
 		return skeleton_;
 	}
@@ -42,7 +74,7 @@ public:
 
 class ModelImporter {
 public:
-	std::shared_ptr<Model> Import(DxContext* context, const Pmx& pmx, const std::wstring& path);
+	std::shared_ptr<Model> Import(DxContext* context, LazyPmx& pmx, const std::wstring& path);
 };
 
 }
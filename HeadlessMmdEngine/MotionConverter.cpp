@@ -0,0 +1,437 @@
+#include "pch.h"
+#include "MotionConverter.h"
+#include "MathHelper.h"
+#include "MmdScene.h"
+#include "MmdSceneStream.h"
+#include "KeyReduction.h"
+
+namespace headless_mmd {
+
+namespace {
+
+constexpr int FramesPerTask = 64;
+constexpr int ScannedFrames = 16;
+
+// the local pose of one bone on every frame, as its keys hold it
+struct LocalTrack {
+	std::array<std::vector<float>, 3> translation{};
+	std::vector<Quaternion> rotation{};
+};
+
+// the curves of x, y, z and rotation
+using Curves = std::array<portable_mmd::Interpolation, 4>;
+
+constexpr Curves LinearCurves{
+	portable_mmd::DefaultInterpolation,
+	portable_mmd::DefaultInterpolation,
+	portable_mmd::DefaultInterpolation,
+	portable_mmd::DefaultInterpolation,
+};
+
+class BoneFitter {
+public:
+	BoneFitter(const LocalTrack& track, float translation_tolerance, float rotation_tolerance) :
+		track_(track),
+		num_frames_(static_cast<int>(track.rotation.size())),
+		translation_tolerance_(translation_tolerance),
+		rotation_tolerance_(rotation_tolerance) {
+	}
+
+	bool IsAtRest() const {
+		for (int frame = 0; frame < num_frames_; ++frame) {
+			for (const auto& values : track_.translation) {
+				if (std::abs(values[frame]) > translation_tolerance_) {
+					return false;
+				}
+			}
+			if (quat_angle(quat_zero(), track_.rotation[frame]) > rotation_tolerance_) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// each key ends the longest segment from the one before it that fits. galloping out finds a segment
+	// that does not in a few fits, and bisecting back closes in on the longest one that does.
+	std::vector<Vmd::MotionKey> Fit() const {
+		std::vector<Vmd::MotionKey> keys{ MakeKey(0, LinearCurves) };
+
+		for (int first = 0; first < num_frames_ - 1;) {
+			// neighbouring frames always fit, there is nothing between them
+			int good = first + 1;
+			int bad = num_frames_;
+			Curves curves = LinearCurves;
+
+			for (int step = 2; good < num_frames_ - 1; step *= 2) {
+				const int last = std::min(first + step, num_frames_ - 1);
+				Curves fitted{};
+				if (!FitSegment(first, last, fitted)) {
+					bad = last;
+					break;
+				}
+				good = last;
+				curves = fitted;
+			}
+
+			while (bad - good > ScannedFrames) {
+				const int mid = good + (bad - good) / 2;
+				Curves fitted{};
+				if (FitSegment(first, mid, fitted)) {
+					good = mid;
+					curves = fitted;
+				}
+				else {
+					bad = mid;
+				}
+			}
+
+			// whether a segment fits is not monotonic in its length, a part of a keyed curve can need handles
+			// the search misses where the whole one does not, so the last few frames are scanned from the top
+			for (int last = bad - 1; last > good; --last) {
+				Curves fitted{};
+				if (FitSegment(first, last, fitted)) {
+					good = last;
+					curves = fitted;
+					break;
+				}
+			}
+
+			keys.push_back(MakeKey(good, curves));
+			first = good;
+		}
+
+		return keys;
+	}
+
+private:
+	const LocalTrack& track_;
+	int num_frames_;
+	float translation_tolerance_;
+	float rotation_tolerance_;
+
+	Vmd::MotionKey MakeKey(int frame, const Curves& curves) const {
+		auto key = Vmd::DefaultMotionKey;
+		key.frame = static_cast<uint32_t>(frame);
+		key.position = DirectX::XMVectorSet(track_.translation[0][frame], track_.translation[1][frame], track_.translation[2][frame], 0.f);
+		key.orientation = track_.rotation[frame];
+		key.ix = curves[0];
+		key.iy = curves[1];
+		key.iz = curves[2];
+		key.ir = curves[3];
+		return key;
+	}
+
+	bool FitSegment(int first, int last, Curves& curves) const {
+		const auto num_samples = static_cast<std::size_t>(last - first - 1);
+		std::vector<float> times(num_samples);
+		std::vector<float> progress(num_samples);
+		for (std::size_t i = 0; i < num_samples; ++i) {
+			times[i] = static_cast<float>(i + 1) / static_cast<float>(last - first);
+		}
+
+		for (int axis = 0; axis < 3; ++axis) {
+			if (!FitTranslation(first, last, axis, times, progress, curves[axis])) {
+				return false;
+			}
+		}
+		return FitRotation(first, last, times, progress, curves[3]);
+	}
+
+	bool FitTranslation(int first, int last, int axis, std::span<const float> times, std::span<float> progress, portable_mmd::Interpolation& curve) const {
+		const auto& values = track_.translation[axis];
+		const float v0 = values[first];
+		const float delta = values[last] - v0;
+
+		// most candidates are thrown away, so they are solved here rather than kept in the shared cache
+		auto Fits = [&](const portable_mmd::Interpolation& interp) {
+			const portable_mmd::BezierCurve bezier(interp);
+			for (int i = first + 1; i < last; ++i) {
+				if (std::abs(v0 + delta * bezier(times[i - first - 1]) - values[i]) > translation_tolerance_) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// a line is cheaper to check than a curve is to fit, and a channel that barely moves has no progress to fit
+		curve = portable_mmd::DefaultInterpolation;
+		if (Fits(curve) || std::abs(delta) <= translation_tolerance_) {
+			return Fits(curve);
+		}
+
+		for (int i = first + 1; i < last; ++i) {
+			progress[i - first - 1] = (values[i] - v0) / delta;
+		}
+		curve = FitInterpolation(times, progress);
+		return Fits(curve);
+	}
+
+	bool FitRotation(int first, int last, std::span<const float> times, std::span<float> progress, portable_mmd::Interpolation& curve) const {
+		const auto& rotations = track_.rotation;
+		const auto q0 = rotations[first];
+		const auto q1 = rotations[last];
+		const float angle = quat_angle(q0, q1);
+
+		// measured against the slerp that plays the keys back
+		auto Fits = [&](const portable_mmd::Interpolation& interp) {
+			const portable_mmd::BezierCurve bezier(interp);
+			for (int i = first + 1; i < last; ++i) {
+				if (quat_angle(quat_slerp(q0, q1, bezier(times[i - first - 1])), rotations[i]) > rotation_tolerance_) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		curve = portable_mmd::DefaultInterpolation;
+		if (Fits(curve) || angle <= rotation_tolerance_) {
+			return Fits(curve);
+		}
+
+		// the progress of a rotation is how far it has turned from the first key
+		for (int i = first + 1; i < last; ++i) {
+			progress[i - first - 1] = quat_angle(q0, rotations[i]) / angle;
+		}
+		curve = FitInterpolation(times, progress);
+		return Fits(curve);
+	}
+};
+
+}
+
+bool MotionConverter::Convert(const MmdAnimationTrack& track, const Pmx& pmx, Vmd& vmd, KeyReductionInfo* info) const {
+	const auto num_bones = static_cast<int>(pmx.bones.size());
+	const auto& stream = track.bone_stream;
+
+	// where each bone was captured, a dense track or a slot of the streamed chunks
+	std::vector<const DenseTrack<Matrix>*> dense(num_bones, nullptr);
+	std::vector<int> slots(num_bones, -1);
+	int num_frames = stream ? stream->GetNumFrames() : 0;
+	int num_captured = 0;
+
+	for (int i = 0; i < num_bones; ++i) {
+		const auto& name = pmx.bones[i].name;
+		if (auto it = track.bone_animation.find(name); it != track.bone_animation.end() && !it->second.IsEmpty()) {
+			dense[i] = &it->second;
+			num_frames = std::max(num_frames, static_cast<int>(it->second.Size()));
+			++num_captured;
+		}
+		else if (auto slot = track.bone_slots.find(name); stream && slot != track.bone_slots.end() && slot->second >= 0 && slot->second < stream->GetNumSlots()) {
+			slots[i] = slot->second;
+			++num_captured;
+		}
+	}
+
+	if (num_captured == 0 || num_frames <= 0) {
+		return false;
+	}
+
+	// the hierarchy as the skeleton builds it
+	std::vector<int> parents(num_bones, -1);
+	std::vector<Vector> local_positions(num_bones);
+	for (int i = 0; i < num_bones; ++i) {
+		const auto& bone = pmx.bones[i];
+		if (bone.parent_bone_index >= 0 && bone.parent_bone_index < num_bones && bone.parent_bone_index != i) {
+			parents[i] = bone.parent_bone_index;
+			local_positions[i] = vector_sub(bone.position, pmx.bones[bone.parent_bone_index].position);
+		}
+		else {
+			local_positions[i] = bone.position;
+		}
+	}
+
+	auto AppendSource = [&](int index) {
+		const auto& bone = pmx.bones[index];
+		const bool driven = (bone.driven_rotation || bone.driven_translation) && bone.drive_bone_index >= 0 && bone.drive_bone_index < num_bones && bone.drive_bone_index != index;
+		return driven ? bone.drive_bone_index : -1;
+	};
+
+	std::vector<int> order(num_bones);
+	std::iota(order.begin(), order.end(), 0);
+	std::ranges::stable_sort(order, [&](int a, int b) {
+		const auto& bone_a = pmx.bones[a];
+		const auto& bone_b = pmx.bones[b];
+		return std::tie(bone_a.post_physics_transform, bone_a.level) < std::tie(bone_b.post_physics_transform, bone_b.level);
+	});
+
+	std::vector<LocalTrack> locals(num_bones);
+	for (int i = 0; i < num_bones; ++i) {
+		if (dense[i] || slots[i] >= 0) {
+			for (auto& values : locals[i].translation) {
+				values.resize(static_cast<std::size_t>(num_frames));
+			}
+			locals[i].rotation.resize(static_cast<std::size_t>(num_frames));
+		}
+	}
+
+	// bones missing from the capture are taken to stay at rest
+	auto ExtractFrames = [&](const MmdSceneChunk* chunk, int first, int last) {
+		std::vector<Matrix> worlds(num_bones);
+		std::vector<Quaternion> rotations(num_bones);
+		std::vector<Vector> translations(num_bones);
+		std::vector<Quaternion> append_rotations(num_bones);
+		std::vector<Vector> append_translations(num_bones);
+
+		for (int frame = first; frame < last; ++frame) {
+			for (int i = 0; i < num_bones; ++i) {
+				if (dense[i]) {
+					worlds[i] = dense[i]->GetByIndex(frame);
+				}
+				else if (slots[i] >= 0 && chunk) {
+					worlds[i] = chunk->Get(slots[i], frame);
+				}
+				else {
+					worlds[i] = matrix_translation(pmx.bones[i].position);
+				}
+			}
+
+			// the whole local pose first, so that a source deforming after the bone it drives still has a value
+			for (int i = 0; i < num_bones; ++i) {
+				const auto local = parents[i] >= 0 ? worlds[i] * matrix_inverse(worlds[parents[i]]) : worlds[i];
+				rotations[i] = quat_from_matrix(local);
+				translations[i] = vector_sub(matrix_position(local), local_positions[i]);
+				append_rotations[i] = quat_zero();
+				append_translations[i] = vector_zero();
+			}
+
+			// then the appended part out again, passed on down a chain as the skeleton does
+			for (int i : order) {
+				const int source = AppendSource(i);
+				if (source < 0) {
+					continue;
+				}
+
+				const auto& bone = pmx.bones[i];
+				const auto& source_bone = pmx.bones[source];
+				const bool source_appends = AppendSource(source) >= 0;
+
+				if (bone.driven_rotation) {
+					const auto rotation = source_appends && source_bone.driven_rotation ? quat_mul(rotations[source], append_rotations[source]) : rotations[source];
+					append_rotations[i] = quat_slerp(quat_zero(), rotation, bone.drive_rate);
+					rotations[i] = quat_mul(rotations[i], quat_inverse(append_rotations[i]));
+				}
+
+				if (bone.driven_translation) {
+					const auto translation = source_appends && source_bone.driven_translation ? vector_add(translations[source], append_translations[source]) : translations[source];
+					append_translations[i] = vector_mul(translation, bone.drive_rate);
+					translations[i] = vector_sub(translations[i], append_translations[i]);
+				}
+			}
+
+			for (int i = 0; i < num_bones; ++i) {
+				auto& local = locals[i];
+				if (local.rotation.empty()) {
+					continue;
+				}
+
+				const auto [x, y, z] = vector_components(translations[i]);
+				local.translation[0][frame] = x;
+				local.translation[1][frame] = y;
+				local.translation[2][frame] = z;
+				local.rotation[frame] = rotations[i];
+			}
+		}
+	};
+
+	std::vector<std::function<bool()>> tasks{};
+	auto RunFrames = [&](const MmdSceneChunk* chunk, int first, int last) {
+		tasks.clear();
+		for (int begin = first; begin < last; begin += FramesPerTask) {
+			const int end = std::min(begin + FramesPerTask, last);
+			tasks.push_back([&, chunk, begin, end] {
+				ExtractFrames(chunk, begin, end);
+				return true;
+			});
+		}
+		portable_mmd::io::RunTasks(tasks, 0);
+	};
+
+	if (stream) {
+		// a chunk at a time, the stream decodes the next ones meanwhile
+		for (int frame = 0; frame < num_frames;) {
+			const auto chunk = stream->Acquire(frame);
+			const int last = chunk ? std::min(chunk->first_frame + chunk->num_frames, num_frames) : num_frames;
+			if (last <= frame) {
+				break;
+			}
+			RunFrames(chunk.get(), frame, last);
+			frame = last;
+		}
+	}
+	else {
+		RunFrames(nullptr, 0, num_frames);
+	}
+
+	// each bone fitted on its own
+	std::vector<std::vector<Vmd::MotionKey>> keys(num_bones);
+	tasks.clear();
+	for (int i = 0; i < num_bones; ++i) {
+		if (locals[i].rotation.empty()) {
+			continue;
+		}
+
+		tasks.push_back([&, i] {
+			auto& local = locals[i];
+
+			// keep neighbouring frames on the same side of the double cover, so that a curve between them turns the short way
+			for (int frame = 1; frame < num_frames; ++frame) {
+				if (quat_dot(local.rotation[frame - 1], local.rotation[frame]) < 0.f) {
+					local.rotation[frame] = DirectX::XMVectorNegate(local.rotation[frame]);
+				}
+			}
+
+			const BoneFitter fitter(local, translation_tolerance_, rotation_tolerance_);
+			if (!fitter.IsAtRest()) {
+				keys[i] = fitter.Fit();
+			}
+
+			local = {};
+			return true;
+		});
+	}
+	portable_mmd::io::RunTasks(tasks, 0);
+
+	vmd.header.name = Utf16ToSjis(pmx.header.name);
+
+	KeyReductionInfo reduction{};
+	for (int i = 0; i < num_bones; ++i) {
+		if (dense[i] || slots[i] >= 0) {
+			reduction.num_keys += static_cast<std::size_t>(num_frames);
+		}
+		if (keys[i].empty()) {
+			continue;
+		}
+
+		reduction.num_saved_keys += keys[i].size();
+		vmd.motions[Utf16ToSjis(pmx.bones[i].name)] = std::move(keys[i]);
+	}
+
+	// the capture holds the solved pose already, an ik left on would solve it a second time
+	bool has_ik = false;
+	for (const auto& bone : pmx.bones) {
+		if (bone.is_ik) {
+			vmd.iks[Utf16ToSjis(bone.name)].push_back({ 0, false });
+			has_ik = true;
+		}
+	}
+	if (has_ik) {
+		vmd.visibilities.push_back({ 0, true });
+	}
+
+	for (const auto& [name, morph] : track.morph_animation) {
+		auto& out = vmd.morphs[Utf16ToSjis(name)];
+		out.reserve(morph.keys.size());
+		for (const auto& key : morph.keys) {
+			out.push_back({ static_cast<uint32_t>(key.frame), key.value });
+		}
+	}
+
+	DLOG(L"{} of {} bone keys saved, {:.2f}x smaller", reduction.num_saved_keys, reduction.num_keys, reduction.GetCompressionRatio());
+	if (info) {
+		*info = reduction;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include "Common.h"
+
+namespace headless_mmd {
+
+struct MmdAnimationTrack;
+
+// turns the world matrices of a captured model back into the keys of a vmd. each frame is taken
+// apart against the bone hierarchy of the pmx the capture was made with, and each bone is split
+// into the longest segments whose curves keep every channel within tolerance of every frame.
+class MotionConverter {
+public:
+	explicit MotionConverter(float translation_tolerance = 0.01f, float rotation_tolerance = 0.005f) :
+		translation_tolerance_(translation_tolerance),
+		rotation_tolerance_(rotation_tolerance) {
+	}
+
+	// ik and appended transforms are baked into the capture, so the ik bones are switched off and
+	// the appended part of each bone is taken back out of its keys. bones that stay at rest get no keys.
+	bool Convert(const MmdAnimationTrack& track, const Pmx& pmx, Vmd& vmd, KeyReductionInfo* info = nullptr) const;
+
+private:
+	float translation_tolerance_;	// in model units
+	float rotation_tolerance_;		// in radians
+};
+
+}
@@ -0,0 +1,38 @@
+#include "pch.h"
+#include "PoseCache.h"
+
+namespace headless_mmd {
+
+void PoseCache::NextFrame() {
+	entries_.clear();
+}
+
+PoseCache::Pose& PoseCache::Acquire(const Animation* animation, uint64_t rig_id, float frame, bool& hit) {
+	const auto num_used = entries_.size();
+	for (std::size_t i = 0; i < num_used; ++i) {
+		const auto& entry = entries_[i];
+		if (entry.animation == animation && entry.rig_id == rig_id && entry.frame == frame) {
+			hit = true;
+			++stats_.hits;
+
+			auto& pose = poses_[i];
+			++pose.num_users;
+			return pose;
+		}
+	}
+
+	hit = false;
+	++stats_.misses;
+
+	if (num_used == poses_.size()) {
+		poses_.emplace_back();
+	}
+	entries_.push_back({ animation, rig_id, frame });
+
+	auto& pose = poses_[num_used];
+	pose.has_bones = false;
+	pose.num_users = 1;
+	return pose;
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include "Common.h"
+
+namespace headless_mmd {
+
+class Animation;
+
+// poses evaluated during one frame, shared by the models that play the same animation on the same rig at the same time
+class PoseCache {
+public:
+	struct Pose {
+		std::vector<Matrix> bones{};	// model space, before the bind offsets of each skeleton
+		bool has_bones = false;
+		int num_users = 0;
+	};
+
+	using Stats = PoseCacheStats;
+
+	// forgets the poses of the previous frame, keeping their storage
+	void NextFrame();
+
+	// the pose of the animation at the frame on the rig (Skeleton::GetRigId). hit tells whether
+	// another model acquired it earlier in this frame.
+	Pose& Acquire(const Animation* animation, uint64_t rig_id, float frame, bool& hit);
+
+private:
+	struct Entry {
+		const Animation*	animation;
+		uint64_t			rig_id;
+		float				frame;
+	};
+
+	// entries_[i] is the key of poses_[i]. a scene has a handful of models, so a linear search
+	// of a vector that keeps its capacity beats a tree that allocates a node per model and frame.
+	std::vector<Entry> entries_{};
+	std::deque<Pose> poses_{};	// references stay valid while it grows
+	Stats stats_{};
+
+public:
+	const Stats& GetStats() const {
+		return stats_;
+	}
+
+	void ResetStats() {
+		stats_ = {};
+	}
+};
+
+}
@@ -33,11 +33,47 @@ bool Scene::Init(DxContext* context) {
 	return true;
 }
 
-void Scene::Update(DxContext* context, int frame, const std::vector<float>& morph_values) {
+void Scene::Update(DxContext* context, float frame, const std::vector<float>& morph_values) {
 	camera_.Update(frame);
 
+	// models playing the same animation on the same rig at the same time share one evaluation of the pose
+	pose_cache_.NextFrame();
+	model_poses_.clear();
 	for (auto& model : models_) {
-		model->Update(context, frame, morph_values);
+		bool reuse = false;
+		auto* pose = model->GetAnimation() ? &pose_cache_.Acquire(model->GetAnimation().get(), model->GetSkeleton()->GetRigId(), frame, reuse) : nullptr;
+		model_poses_.emplace_back(pose, reuse);
+	}
+
+	// the models are independent, and so are the mesh and the skeleton of each one. the models
+	// reusing a pose run after the ones evaluating it, and all of them are done before the frame is drawn.
+	update_tasks_.clear();
+	reuse_tasks_.clear();
+	for (std::size_t i = 0; i < models_.size(); ++i) {
+		auto* model = models_[i].get();
+		auto [pose, reuse] = model_poses_[i];
+
+		update_tasks_.emplace_back([model, frame, &morph_values] { model->UpdateMorphs(frame, morph_values); return true; });
+		if (!pose || pose->num_users == 1) {
+			update_tasks_.emplace_back([model, frame] { model->UpdatePose(frame); return true; });
+		}
+		else {
+			auto& tasks = reuse ? reuse_tasks_ : update_tasks_;
+			tasks.emplace_back([model, frame, pose, reuse] { model->UpdatePose(frame, *pose, reuse); return true; });
+		}
+	}
+	task_pool_.Run(update_tasks_);
+	task_pool_.Run(reuse_tasks_);
+
+	if constexpr (IsDebug) {
+		if (++num_updates_ % 600 == 0) {
+			DLOG(L"pose cache {} hits {} misses ({:.1f}%)", pose_cache_.GetStats().hits, pose_cache_.GetStats().misses, pose_cache_.GetStats().GetHitRate() * 100.);
+
+			for (auto& model : models_) {
+				[[maybe_unused]] const auto stats = model->GetScrubCacheStats();
+				DLOG(L"scrub cache {} hits {} misses {} evictions {} entries {} bytes", stats.hits, stats.misses, stats.evictions, stats.entries, stats.bytes);
+			}
+		}
 	}
 
 	auto [width, height] = context->GetRenderTargetSize();
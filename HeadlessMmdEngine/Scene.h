@@ -8,7 +8,7 @@ namespace headless_mmd {
 class Scene {
 public:
 	bool Init(DxContext* context);
-	void Update(DxContext* context, int frame, const std::vector<float>& morph_values);
+	void Update(DxContext* context, float frame, const std::vector<float>& morph_values);
 
 private:
 	struct SceneConstants {
@@ -30,11 +30,42 @@ private:
 	Camera camera_{};
 	std::vector<std::shared_ptr<Model>> models_{};
 
+	portable_mmd::io::TaskPool task_pool_{};
+	std::vector<std::function<bool()>> update_tasks_{};
+	std::vector<std::function<bool()>> reuse_tasks_{};
+
+	PoseCache pose_cache_{};
+	std::vector<std::pair<PoseCache::Pose*, bool>> model_poses_{};
+	std::size_t scrub_cache_budget_ = 0;
+	int num_updates_ = 0;
+
 public:
 	void AddModel(const std::shared_ptr<Model>& model) {
+		model->SetScrubCacheBudget(scrub_cache_budget_);
 		models_.push_back(model);
 	}
 
+	// per model, for the models added before and after
+	void SetScrubCacheBudget(std::size_t bytes) {
+		scrub_cache_budget_ = bytes;
+		for (auto& model : models_) {
+			model->SetScrubCacheBudget(bytes);
+		}
+	}
+
+	std::size_t GetScrubCacheBudget() const {
+		return scrub_cache_budget_;
+	}
+
+	// summed over the models
+	LruCacheStats GetScrubCacheStats() const {
+		LruCacheStats stats{};
+		for (auto& model : models_) {
+			stats += model->GetScrubCacheStats();
+		}
+		return stats;
+	}
+
 	void SetCameraAnimation(const std::shared_ptr<CameraAnimation>& animation) {
 		camera_.SetAnimation(animation);
 	}
@@ -51,6 +82,10 @@ public:
 		return meshes;
 	}
 
+	const PoseCacheStats& GetPoseCacheStats() const {
+		return pose_cache_.GetStats();
+	}
+
 	D3D12_GPU_VIRTUAL_ADDRESS GetConstantBufferLocation() const {
 		return constant_buffer_->GetGPUVirtualAddress();
 	}
@@ -4,6 +4,36 @@
 #include "Model.h"
 
 namespace headless_mmd {
+namespace {
+
+// fnv-1a over the fields that take part in solving a pose
+class RigHasher {
+public:
+	template<typename T>
+	void Add(const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+		for (std::size_t i = 0; i < sizeof(T); ++i) {
+			hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+
+	// w is not part of a position or an angle
+	void AddVector(const Vector& v) {
+		Float3 xyz{};
+		DirectX::XMStoreFloat3(&xyz, v);
+		Add(xyz);
+	}
+
+	uint64_t Get() const {
+		return hash_;
+	}
+
+private:
+	uint64_t hash_ = 14695981039346656037ull;
+};
+
+}
 
 void Skeleton::SetPose(int index, const Matrix& transform) {
 	bones_.at(index).pose = transform;
@@ -16,9 +46,148 @@ void Skeleton::SetDelta(int index, const Matrix& transform) {
 void Skeleton::Update() {
 	const auto num_bones = static_cast<int>(bones_.size());
 
+	palette_.resize(num_bones);
 	for (int i = 0; i < num_bones; ++i) {
 		const auto& bone = bones_[i];
-		store_transposed(constants_->transforms[i], bone.offset * bone.delta * bone.pose);
+		store_transposed(palette_[i], bone.offset * bone.delta * bone.pose);
+	}
+
+	if (constants_) {
+		std::memcpy(constants_->transforms, palette_.data(), sizeof(Float4x4) * num_bones);
+	}
+}
+
+void Skeleton::SetPalette(std::span<const Float4x4> palette) {
+	palette_.assign(palette.begin(), palette.end());
+
+	if (constants_) {
+		std::memcpy(constants_->transforms, palette_.data(), sizeof(Float4x4) * palette_.size());
+	}
+}
+
+void Skeleton::SetLocalPose(int index, const Vector& translation, const Quaternion& rotation) {
+	auto& bone = bones_.at(index);
+	bone.translation = translation;
+	bone.rotation = rotation;
+}
+
+void Skeleton::EnableIk(int index, bool enable) {
+	bones_.at(index).ik_enabled = enable;
+}
+
+void Skeleton::SolvePose() {
+	for (auto& bone : bones_) {
+		bone.ik_rotation = quat_zero();
+	}
+
+	for (int index : deform_order_) {
+		ApplyAppend(index);
+		UpdateWorld(index);
+
+		const auto& bone = bones_[index];
+		if (bone.ik_target >= 0 && bone.ik_enabled) {
+			SolveIk(index);
+		}
+	}
+}
+
+void Skeleton::ApplyAppend(int index) {
+	auto& bone = bones_[index];
+	bone.append_translation = vector_zero();
+	bone.append_rotation = quat_zero();
+
+	if (bone.append_parent < 0) {
+		return;
+	}
+
+	// appends chain, so the source passes on what it inherited itself
+	const auto& source = bones_[bone.append_parent];
+
+	if (bone.append_rotation_enabled) {
+		auto rotation = source.append_rotation_enabled ? quat_mul(source.rotation, source.append_rotation) : source.rotation;
+		rotation = quat_mul(source.ik_rotation, rotation);
+		bone.append_rotation = quat_slerp(quat_zero(), rotation, bone.append_rate);
+	}
+
+	if (bone.append_translation_enabled) {
+		auto translation = source.append_translation_enabled ? vector_add(source.translation, source.append_translation) : source.translation;
+		bone.append_translation = vector_mul(translation, bone.append_rate);
+	}
+}
+
+void Skeleton::UpdateWorld(int index) {
+	auto& bone = bones_[index];
+
+	const auto rotation = quat_mul(quat_mul(bone.ik_rotation, bone.rotation), bone.append_rotation);
+	const auto translation = vector_add(vector_add(bone.local_position, bone.translation), bone.append_translation);
+	const auto local = matrix_rotation_translation(rotation, translation);
+
+	bone.pose = bone.parent >= 0 ? local * bones_[bone.parent].pose : local;
+}
+
+void Skeleton::UpdateWorldRecursive(int index) {
+	UpdateWorld(index);
+
+	for (int child : bones_[index].children) {
+		UpdateWorldRecursive(child);
+	}
+}
+
+// cyclic coordinate descent: each link in turn rotates the target towards the ik bone
+void Skeleton::SolveIk(int index) {
+	const auto& ik = bones_[index];
+	const auto goal = matrix_position(ik.pose);
+	const auto& target = bones_[ik.ik_target];
+
+	for (int iteration = 0; iteration < ik.ik_iterations; ++iteration) {
+		for (const auto& link : ik.ik_links) {
+			auto& chain = bones_[link.index];
+
+			const auto to_local = matrix_inverse(chain.pose);
+			const auto local_goal = vector3_normalize(vector3_transform(goal, to_local));
+			const auto local_target = vector3_normalize(vector3_transform(matrix_position(target.pose), to_local));
+
+			// from the sine as well as the cosine, acos alone cannot resolve the last fraction of a degree
+			auto axis = vector3_cross(local_target, local_goal);
+			float angle = std::atan2(std::sqrt(vector3_dot(axis, axis)), vector3_dot(local_target, local_goal));
+			// a limited link on target is still brought within its limits, which is what bends a
+			// straight knee out of line with its goal
+			if (angle < 1e-5f && !link.limited) {
+				continue;
+			}
+			angle = std::min(angle, ik.ik_angle_limit);
+
+			if (link.planar) {
+				axis = Vector{ DirectX::XMVectorGetX(axis) < 0.f ? -1.f : 1.f, 0.f, 0.f, 0.f };
+			}
+			else if (vector3_dot(axis, axis) >= 1e-12f) {
+				axis = vector3_normalize(axis);
+			}
+			else if (link.limited) {
+				axis = Vector{ 1.f, 0.f, 0.f, 0.f };
+				angle = 0.f;
+			}
+			else {
+				continue;
+			}
+
+			// the ik rotation applies first, before the animated rotation of the link
+			const auto animated = quat_mul(chain.rotation, chain.append_rotation);
+			auto rotation = quat_mul(quat_mul(quat_rotation_axis(axis, angle), chain.ik_rotation), animated);
+
+			if (link.planar) {
+				auto x = 2.f * std::atan2(DirectX::XMVectorGetX(rotation), DirectX::XMVectorGetW(rotation));
+				x = std::remainder(x, DirectX::XM_2PI);
+				x = std::clamp(x, DirectX::XMVectorGetX(link.angle_min), DirectX::XMVectorGetX(link.angle_max));
+				rotation = quat_rotation_axis(Vector{ 1.f, 0.f, 0.f, 0.f }, x);
+			}
+			else if (link.limited) {
+				rotation = quat_from_euler(DirectX::XMVectorClamp(quat_to_euler(rotation), link.angle_min, link.angle_max));
+			}
+
+			chain.ik_rotation = quat_mul(rotation, quat_inverse(animated));
+			UpdateWorldRecursive(link.index);
+		}
 	}
 }
 
@@ -42,16 +211,98 @@ std::shared_ptr<Skeleton> SkeletonImporter::Import(DxContext* context, const Pmx
 		bone.offset = matrix_inverse(bone.ref);
 		bone.delta = matrix_identity();
 		bone.pose = bone.ref;
+
+		const auto parent_index = pmx_bone.parent_bone_index;
+		if (parent_index >= 0 && parent_index < num_bones && parent_index != i) {
+			bone.parent = parent_index;
+			bone.local_position = vector_sub(pmx_bone.position, pmx.bones[parent_index].position);
+		}
+		else {
+			bone.local_position = pmx_bone.position;
+		}
+		bone.translation = vector_zero();
+		bone.rotation = quat_zero();
+		bone.ik_rotation = quat_zero();
+		bone.append_translation = vector_zero();
+		bone.append_rotation = quat_zero();
+
+		if ((pmx_bone.driven_rotation || pmx_bone.driven_translation) && pmx_bone.drive_bone_index >= 0 && pmx_bone.drive_bone_index < num_bones && pmx_bone.drive_bone_index != i) {
+			bone.append_parent = pmx_bone.drive_bone_index;
+			bone.append_rate = pmx_bone.drive_rate;
+			bone.append_rotation_enabled = pmx_bone.driven_rotation;
+			bone.append_translation_enabled = pmx_bone.driven_translation;
+		}
+
+		if (pmx_bone.is_ik && pmx_bone.ik_target_bone_index >= 0 && pmx_bone.ik_target_bone_index < num_bones) {
+			bone.ik_target = pmx_bone.ik_target_bone_index;
+			bone.ik_iterations = pmx_bone.ik_iteration_count;
+			bone.ik_angle_limit = pmx_bone.ik_angle_limit;
+
+			for (const auto& pmx_link : pmx_bone.ik_links) {
+				if (pmx_link.index < 0 || pmx_link.index >= num_bones) {
+					continue;
+				}
+
+				const bool planar = pmx_link.angle_limited
+					&& DirectX::XMVectorGetY(pmx_link.angle_min) == 0.f && DirectX::XMVectorGetY(pmx_link.angle_max) == 0.f
+					&& DirectX::XMVectorGetZ(pmx_link.angle_min) == 0.f && DirectX::XMVectorGetZ(pmx_link.angle_max) == 0.f;
+				bone.ik_links.emplace_back(pmx_link.index, pmx_link.angle_limited, planar, pmx_link.angle_min, pmx_link.angle_max);
+			}
+		}
 	}
 
-	skeleton->constant_buffer_ = context->CreateDynamicBuffer(sizeof(Skeleton::SkeletonConstants));
-	if (!skeleton->constant_buffer_) {
-		return nullptr;
+	for (int i = 0; i < num_bones; ++i) {
+		if (bones[i].parent >= 0) {
+			bones[bones[i].parent].children.push_back(i);
+		}
 	}
 
-	auto hr = skeleton->constant_buffer_->Map(0, nullptr, (void**)&skeleton->constants_);
-	if (FAILED(hr)) {
-		return nullptr;
+	// bones after physics still deform last, there is no physics to run in between
+	auto& order = skeleton->deform_order_;
+	order.resize(num_bones);
+	std::iota(order.begin(), order.end(), 0);
+	std::ranges::stable_sort(order, [&](int a, int b) {
+		const auto& bone_a = pmx.bones[a];
+		const auto& bone_b = pmx.bones[b];
+		return std::tie(bone_a.post_physics_transform, bone_a.level) < std::tie(bone_b.post_physics_transform, bone_b.level);
+	});
+
+	RigHasher rig{};
+	rig.Add(num_bones);
+	for (const auto& bone : bones) {
+		rig.Add(bone.parent);
+		rig.AddVector(bone.local_position);
+		rig.Add(bone.append_parent);
+		rig.Add(bone.append_rate);
+		rig.Add(bone.append_rotation_enabled);
+		rig.Add(bone.append_translation_enabled);
+		rig.Add(bone.ik_target);
+		rig.Add(bone.ik_iterations);
+		rig.Add(bone.ik_angle_limit);
+		rig.Add(bone.ik_links.size());
+		for (const auto& link : bone.ik_links) {
+			rig.Add(link.index);
+			rig.Add(link.limited);
+			rig.AddVector(link.angle_min);
+			rig.AddVector(link.angle_max);
+		}
+	}
+	for (const auto index : order) {
+		rig.Add(index);
+	}
+	skeleton->rig_id_ = rig.Get();
+
+	// without a context the skeleton is posed on the cpu only, as tools and checks do
+	if (context) {
+		skeleton->constant_buffer_ = context->CreateDynamicBuffer(sizeof(Skeleton::SkeletonConstants));
+		if (!skeleton->constant_buffer_) {
+			return nullptr;
+		}
+
+		auto hr = skeleton->constant_buffer_->Map(0, nullptr, (void**)&skeleton->constants_);
+		if (FAILED(hr)) {
+			return nullptr;
+		}
 	}
 
 	skeleton->Update();
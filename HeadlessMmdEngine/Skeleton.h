@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <span>
 #include "Common.h"
 #include "DxContext.h"
 
@@ -13,22 +14,68 @@ public:
 	void SetDelta(int index, const Matrix& transform);
 	void Update();
 
+	// uploads a palette kept from an earlier Update instead of computing it
+	void SetPalette(std::span<const Float4x4> palette);
+
+	// local pose from a motion, relative to the rest pose. SolvePose turns it into the world
+	// poses: append (grant) bones, hierarchical fk and ccd ik in the deform order of the pmx.
+	void SetLocalPose(int index, const Vector& translation, const Quaternion& rotation);
+	void EnableIk(int index, bool enable);
+	void SolvePose();
+
 private:
 	struct SkeletonConstants {
 		Float4x4 transforms[1024];
 	};
 	static_assert(sizeof(SkeletonConstants) % 256 == 0);
 
+	struct IkLink {
+		int		index;
+		bool	limited;
+		bool	planar;		// limited to the x axis, like a knee
+		Vector	angle_min;
+		Vector	angle_max;
+	};
+
 	struct Bone {
 		std::wstring name;
 		Matrix ref;
 		Matrix offset;
 		Matrix delta;
 		Matrix pose;
+
+		int parent = -1;
+		std::vector<int> children{};
+		Vector local_position{};	// rest position relative to the parent
+
+		Vector translation{};
+		Quaternion rotation{};
+		Quaternion ik_rotation{};
+
+		int append_parent = -1;
+		float append_rate = 0.f;
+		bool append_rotation_enabled = false;
+		bool append_translation_enabled = false;
+		Vector append_translation{};
+		Quaternion append_rotation{};
+
+		bool ik_enabled = true;
+		int ik_target = -1;
+		int ik_iterations = 0;
+		float ik_angle_limit = 0.f;
+		std::vector<IkLink> ik_links{};
 	};
 
+	void ApplyAppend(int index);
+	void UpdateWorld(int index);
+	void UpdateWorldRecursive(int index);
+	void SolveIk(int index);
+
 	Model* parent_{};
+	uint64_t rig_id_ = 0;
 	std::vector<Bone> bones_{};
+	std::vector<int> deform_order_{};
+	std::vector<Float4x4> palette_{};	// what was uploaded last, the constant buffer is not for reading back
 
 	IDXResourcePtr		constant_buffer_{};
 	SkeletonConstants*	constants_{};
@@ -51,6 +98,25 @@ public:
 		return names;
 	}
 
+	int GetNumBones() const {
+		return static_cast<int>(bones_.size());
+	}
+
+	// equal for skeletons that solve the same local pose into the same world pose: the hierarchy,
+	// rest positions, append and ik settings and deform order, but not the names
+	uint64_t GetRigId() const {
+		return rig_id_;
+	}
+
+	// model space transform of the current pose
+	const Matrix& GetPose(int index) const {
+		return bones_[index].pose;
+	}
+
+	const std::vector<Float4x4>& GetPalette() const {
+		return palette_;
+	}
+
 	const Matrix& GetRefPose(int index) const {
 		return bones_.at(index).ref;
 	}
@@ -8,7 +8,18 @@ void SkinnedMesh::SetMorph(int index, float value) {
 	morph_values_.at(index) = value;
 }
 
-void SkinnedMesh::Update() {
+void SkinnedMesh::Update(bool keep) {
+	if (morph_values_ == applied_values_) {
+		return;
+	}
+	applied_values_ = morph_values_;
+
+	// weights seen before, e.g. while scrubbing the timeline
+	if (const auto* offsets = offset_cache_.Find(morph_values_)) {
+		std::memcpy(dynamic_vertices_, offsets->data(), sizeof(DynamicVertex) * num_vertices_);
+		return;
+	}
+
 	ZeroMemory(offsets_.data(), sizeof(Vector) * num_vertices_);
 
 	const auto num_morphs = static_cast<int>(morphs_.size());
@@ -18,8 +29,17 @@ void SkinnedMesh::Update() {
 
 		for (auto& data : morphs_.at(i).data) {
 			const auto index = data.index;
-			offsets_[index] = DirectX::XMVectorMultiplyAdd(scale, data.offset, offsets_[index]);
+			offsets_[index] = DirectX::XMVectorMultiplyAdd(scale, DirectX::XMLoadFloat3(&data.offset), offsets_[index]);
+		}
+	}
+
+	if (auto* offsets = keep ? offset_cache_.Insert(morph_values_, GetCacheEntrySize()) : nullptr) {
+		offsets->resize(num_vertices_);
+		for (int i = 0; i < num_vertices_; ++i) {
+			store((*offsets)[i].offset, offsets_[i]);
 		}
+		std::memcpy(dynamic_vertices_, offsets->data(), sizeof(DynamicVertex) * num_vertices_);
+		return;
 	}
 
 	for (int i = 0; i < num_vertices_; ++i) {
@@ -27,29 +47,32 @@ void SkinnedMesh::Update() {
 	}
 }
 
-std::shared_ptr<SkinnedMesh> SkinnedMeshImporter::Import(DxContext* context, const Pmx& pmx, const std::wstring& model_path, Model* parent) {
+void SkinnedMesh::SetCacheBudget(std::size_t bytes) {
+	offset_cache_.SetBudget(bytes);
+}
+
+std::size_t SkinnedMesh::GetCacheEntrySize() const {
+	return sizeof(DynamicVertex) * num_vertices_ + sizeof(float) * morph_values_.size() * 2;
+}
+
+std::shared_ptr<SkinnedMesh> SkinnedMeshImporter::Import(DxContext* context, LazyPmx& lazy_pmx, const std::wstring& model_path, Model* parent) {
+	const auto& pmx = lazy_pmx.Get();
+
 	auto skinned_mesh = std::make_shared<SkinnedMesh>();
 	skinned_mesh->parent = parent;
 
 	{
-		const auto num_vertices = static_cast<int>(pmx.vertices.size());
+		std::vector<SkinnedMesh::StaticVertex> static_vertices{};
+		if (!lazy_pmx.LoadVertices(static_vertices)) {
+			return nullptr;
+		}
+
+		const auto num_vertices = static_cast<int>(static_vertices.size());
 		skinned_mesh->num_vertices_ = num_vertices;
 
 		const auto static_buffer_size = static_cast<UINT32>(sizeof(SkinnedMesh::StaticVertex) * num_vertices);
 		const auto dynamic_buffer_size = static_cast<UINT32>(sizeof(SkinnedMesh::DynamicVertex) * num_vertices);
 
-		std::vector<SkinnedMesh::StaticVertex> static_vertices(num_vertices);
-		for (int i = 0; i < num_vertices; ++i) {
-			auto& pmx_vertex = pmx.vertices[i];
-			auto& static_vertex = static_vertices[i];
-
-			std::memcpy(static_vertex.position,		&pmx_vertex.position,	 sizeof(float) * 3);
-			std::memcpy(static_vertex.uv,			&pmx_vertex.uv,			 sizeof(float) * 2);
-			std::memcpy(static_vertex.normal,		&pmx_vertex.normal,		 sizeof(float) * 3);
-			std::memcpy(static_vertex.bone_indices, pmx_vertex.bone_indices, sizeof(float) * 4);
-			std::memcpy(static_vertex.bone_weights, pmx_vertex.bone_weights, sizeof(float) * 4);
-		}
-
 		auto& static_buffer = skinned_mesh->static_buffer_;
 		static_buffer = context->CreateBuffer(static_buffer_size, static_vertices.data());
 		if (!static_buffer) {
@@ -116,9 +139,19 @@ std::shared_ptr<SkinnedMesh> SkinnedMeshImporter::Import(DxContext* context, con
 
 			morph_names[i] = morph.name;
 			morph_panels[i] = morph.panel;
-			morphs[i].data = morph.data;
 			morph_values[i] = 0.f;
 		}
+
+		if (!lazy_pmx.LoadVertexMorphData([&morphs](std::size_t i) -> auto& { return morphs.at(i).data; })) {
+			return nullptr;
+		}
+
+		// Update writes the offset of each entry without checking its vertex, so the ones a broken file
+		// points outside the mesh are dropped here
+		const auto num_vertices = skinned_mesh->num_vertices_;
+		for (auto& morph : morphs) {
+			std::erase_if(morph.data, [num_vertices](const auto& data) { return data.index < 0 || data.index >= num_vertices; });
+		}
 	}
 
 	{
@@ -1,9 +1,11 @@
 #pragma once
 #include <memory>
 #include <memory>
+#include <span>
 #include "Common.h"
 #include "Mesh.h"
 #include "Material.h"
+#include "LruCache.h"
 
 namespace headless_mmd {
 
@@ -16,7 +18,13 @@ public:
 	};
 
 	void SetMorph(int index, float value);
-	void Update();
+
+	// keep says the weights were reached by a seek, and their offsets are worth keeping for the next visit
+	void Update(bool keep = false);
+
+	// budget for the offsets of recently used morph weights
+	void SetCacheBudget(std::size_t bytes);
+	std::size_t GetCacheEntrySize() const;
 
 private:
 	struct StaticVertex {
@@ -32,7 +40,10 @@ private:
 	};
 
 	struct VertexMorph {
-		using Data = Pmx::VertexMorphData;
+		struct Data {
+			int32_t index;
+			Float3 offset;
+		};
 
 		std::vector<Data> data{};
 	};
@@ -54,6 +65,10 @@ private:
 	std::vector<portable_mmd::PmxMorphPanel> morph_panels_{};
 	std::vector<VertexMorph>  morphs_{};
 	std::vector<float> morph_values_{};
+	std::vector<float> applied_values_{};
+
+	// keyed by the weights themselves, so equal keys never hide different weights
+	LruCache<std::vector<float>, std::vector<DynamicVertex>> offset_cache_{};
 
 	std::shared_ptr<MaterialSet> material_set_{};
 	std::vector<Mesh> meshes_{};
@@ -81,6 +96,11 @@ public:
 		return static_cast<int>(morph_names_.size());
 	}
 
+	// weights applied by the next Update
+	std::span<float> GetMorphValues() {
+		return morph_values_;
+	}
+
 	const std::vector<std::wstring>& GetMorphNames() const {
 		return morph_names_;
 	}
@@ -89,6 +109,10 @@ public:
 		return morph_panels_;
 	}
 
+	const LruCacheStats& GetCacheStats() const {
+		return offset_cache_.GetStats();
+	}
+
 	const std::vector<Mesh>& GetMeshes() const {
 		return meshes_;
 	}
@@ -100,7 +124,9 @@ public:
 
 class SkinnedMeshImporter {
 public:
-	std::shared_ptr<SkinnedMesh> Import(DxContext* context, const Pmx& pmx, const std::wstring& model_path, Model* parent);
+	// decodes the vertices and vertex morph offsets from the file straight into the mesh layout.
+	// the other sections are taken from pmx.Get(), which is expected to have been loaded without them.
+	std::shared_ptr<SkinnedMesh> Import(DxContext* context, LazyPmx& pmx, const std::wstring& model_path, Model* parent);
 };
 
 }
\ No newline at end of file
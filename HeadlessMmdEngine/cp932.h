@@ -0,0 +1,470 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include "cp932_table.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CP932_SSE2
+#endif
+
+// portable table-driven transcoder between code page 932 (shift-jis as written by windows) and utf-16 / utf-8.
+// decoding matches MultiByteToWideChar(932): invalid sequences become U+30FB.
+// encoding matches WideCharToMultiByte(932), best-fit mappings aside: characters without a code become '?'.
+namespace cp932 {
+namespace detail {
+
+inline constexpr char16_t InvalidChar = 0x30FB;
+inline constexpr char UnmappableChar = '?';
+
+constexpr bool IsLead(uint8_t c) noexcept {
+	return (0x81 <= c && c <= 0x9F) || (0xE0 <= c && c <= 0xFC);
+}
+
+constexpr bool IsTrail(uint8_t c) noexcept {
+	return 0x40 <= c && c <= 0xFC && c != 0x7F;
+}
+
+constexpr int LeadRow(uint8_t c) noexcept {
+	return c <= 0x9F ? c - 0x81 : c - 0xE0 + (0xA0 - 0x81);
+}
+
+constexpr char16_t DecodeSingle(uint8_t c) noexcept {
+	if (c < 0x80) {
+		return c;
+	}
+	if (0xA1 <= c && c <= 0xDF) {
+		return static_cast<char16_t>(0xFF61 + (c - 0xA1));
+	}
+	switch (c) {
+	case 0x80: return 0x0080;
+	case 0xA0: return 0xF8F0;
+	case 0xFD: return 0xF8F1;
+	case 0xFE: return 0xF8F2;
+	case 0xFF: return 0xF8F3;
+	default: return InvalidChar;
+	}
+}
+
+constexpr char16_t DecodeDouble(uint8_t lead, uint8_t trail) noexcept {
+	const auto c = DoubleByteTable[LeadRow(lead)][trail - 0x40];
+	return c != 0 ? c : InvalidChar;
+}
+
+// utf-16 code unit to cp932, built once by inverting the decode table. 0 is unmappable (except for U+0000).
+// where several codes decode to the same character, windows encodes to the jis x 0208 one first, then nec row 13,
+// then the ibm extensions, and the nec-selected ibm extensions (lead 0xED, 0xEE) last.
+inline const uint16_t* EncodeTable() {
+	static const auto table = [] {
+		auto encode = std::make_unique<uint16_t[]>(0x10000);
+
+		for (unsigned c = 0; c < 0x100; ++c) {
+			if (!IsLead(static_cast<uint8_t>(c))) {
+				const auto u = DecodeSingle(static_cast<uint8_t>(c));
+				if (u != InvalidChar && encode[u] == 0) {
+					encode[u] = static_cast<uint16_t>(c);
+				}
+			}
+		}
+
+		for (int pass = 0; pass < 2; ++pass) {
+			for (unsigned lead = 0x81; lead <= 0xFC; ++lead) {
+				if (!IsLead(static_cast<uint8_t>(lead)) || (lead == 0xED || lead == 0xEE) != (pass == 1)) {
+					continue;
+				}
+				for (unsigned trail = 0x40; trail <= 0xFC; ++trail) {
+					const auto u = DoubleByteTable[LeadRow(static_cast<uint8_t>(lead))][trail - 0x40];
+					if (u != 0 && encode[u] == 0) {
+						encode[u] = static_cast<uint16_t>(lead << 8 | trail);
+					}
+				}
+			}
+		}
+
+		for (const auto& [u, c] : EncodeOnlyTable) {
+			encode[u] = c;
+		}
+
+		return encode;
+	}();
+
+	return table.get();
+}
+
+// ascii fast path: the length of the leading run of bytes below 0x80, checked 16 at a time
+inline std::size_t AsciiPrefix(const char* src, std::size_t size) noexcept {
+	std::size_t i = 0;
+#if defined(CP932_SSE2)
+	for (; i + 16 <= size; i += 16) {
+		const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		if (_mm_movemask_epi8(bytes) != 0) {
+			break;
+		}
+	}
+#endif
+	while (i < size && static_cast<uint8_t>(src[i]) < 0x80) {
+		++i;
+	}
+	return i;
+}
+
+// widens an ascii run to 16 or 32-bit code units
+template<typename Char>
+inline void WidenAscii(const char* src, std::size_t size, Char* dest) noexcept {
+	std::size_t i = 0;
+#if defined(CP932_SSE2)
+	if constexpr (sizeof(Char) == 2 || sizeof(Char) == 4) {
+		const auto zero = _mm_setzero_si128();
+		for (; i + 16 <= size; i += 16) {
+			const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const auto lo = _mm_unpacklo_epi8(bytes, zero);
+			const auto hi = _mm_unpackhi_epi8(bytes, zero);
+			auto out = reinterpret_cast<__m128i*>(dest + i);
+			if constexpr (sizeof(Char) == 2) {
+				_mm_storeu_si128(out + 0, lo);
+				_mm_storeu_si128(out + 1, hi);
+			}
+			else {
+				_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+			}
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		dest[i] = static_cast<Char>(src[i]);
+	}
+}
+
+// the length of the leading run of code units below 0x80, narrowed into dest on the way
+template<typename Char>
+inline std::size_t NarrowAscii(const Char* src, std::size_t size, char* dest) noexcept {
+	std::size_t i = 0;
+#if defined(CP932_SSE2)
+	if constexpr (sizeof(Char) == 2) {
+		const auto mask = _mm_set1_epi16(-0x80);
+		for (; i + 8 <= size; i += 8) {
+			const auto units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, mask), _mm_setzero_si128())) != 0xFFFF) {
+				break;
+			}
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(units, units));
+		}
+	}
+#endif
+	for (; i < size && static_cast<uint32_t>(src[i]) < 0x80; ++i) {
+		dest[i] = static_cast<char>(src[i]);
+	}
+	return i;
+}
+
+inline std::size_t EncodeUnit(uint32_t u, char* dest) noexcept {
+	const auto c = u < 0x10000 ? EncodeTable()[u] : uint16_t{ 0 };
+	if (c == 0 && u != 0) {
+		*dest = UnmappableChar;
+		return 1;
+	}
+	if (c < 0x100) {
+		*dest = static_cast<char>(c);
+		return 1;
+	}
+	dest[0] = static_cast<char>(c >> 8);
+	dest[1] = static_cast<char>(c & 0xFF);
+	return 2;
+}
+
+inline std::size_t PutUtf8(char16_t u, char* dest) noexcept {
+	if (u < 0x80) {
+		dest[0] = static_cast<char>(u);
+		return 1;
+	}
+	if (u < 0x800) {
+		dest[0] = static_cast<char>(0xC0 | u >> 6);
+		dest[1] = static_cast<char>(0x80 | (u & 0x3F));
+		return 2;
+	}
+	dest[0] = static_cast<char>(0xE0 | u >> 12);
+	dest[1] = static_cast<char>(0x80 | (u >> 6 & 0x3F));
+	dest[2] = static_cast<char>(0x80 | (u & 0x3F));
+	return 3;
+}
+
+// one code point from utf-8. malformed input yields U+FFFD, which does not map to cp932.
+inline uint32_t NextUtf8(const uint8_t*& src, const uint8_t* end) noexcept {
+	const auto c = *src++;
+	int n = 0;
+	uint32_t u = 0;
+	if (c < 0x80) {
+		return c;
+	}
+	else if ((c & 0xE0) == 0xC0) {
+		n = 1;
+		u = c & 0x1F;
+	}
+	else if ((c & 0xF0) == 0xE0) {
+		n = 2;
+		u = c & 0x0F;
+	}
+	else if ((c & 0xF8) == 0xF0) {
+		n = 3;
+		u = c & 0x07;
+	}
+	else {
+		return 0xFFFD;
+	}
+
+	for (int i = 0; i < n; ++i) {
+		if (src == end || (*src & 0xC0) != 0x80) {
+			return 0xFFFD;
+		}
+		u = u << 6 | (*src++ & 0x3F);
+	}
+	return u;
+}
+
+}
+
+//
+// buffer api
+//
+// the worst-case output lengths for a given input length, for callers that bring their own buffers
+constexpr std::size_t MaxUtf16Length(std::size_t sjis_size) noexcept {
+	return sjis_size;
+}
+
+constexpr std::size_t MaxUtf8Length(std::size_t sjis_size) noexcept {
+	return sjis_size * 3;
+}
+
+constexpr std::size_t MaxSjisLength(std::size_t utf_units) noexcept {
+	return utf_units * 2;
+}
+
+// cp932 to utf-16 code units. Char is char16_t, or wchar_t of either width. returns the number of units written.
+template<typename Char>
+inline std::size_t DecodeUtf16(std::string_view sjis, Char* dest) noexcept {
+	static_assert(sizeof(Char) >= 2);
+
+	const auto src = sjis.data();
+	const auto size = sjis.size();
+	auto out = dest;
+
+	for (std::size_t i = 0; i < size;) {
+		const auto ascii = detail::AsciiPrefix(src + i, size - i);
+		detail::WidenAscii(src + i, ascii, out);
+		i += ascii;
+		out += ascii;
+
+		for (; i < size; ++out) {
+			const auto c = static_cast<uint8_t>(src[i]);
+			if (c < 0x80) {
+				break;
+			}
+
+			if (detail::IsLead(c) && i + 1 < size && detail::IsTrail(static_cast<uint8_t>(src[i + 1]))) {
+				*out = static_cast<Char>(detail::DecodeDouble(c, static_cast<uint8_t>(src[i + 1])));
+				i += 2;
+			}
+			else {
+				*out = static_cast<Char>(detail::DecodeSingle(c));
+				i += 1;
+			}
+		}
+	}
+
+	return static_cast<std::size_t>(out - dest);
+}
+
+// cp932 to utf-8. returns the number of bytes written.
+template<typename Char = char>
+inline std::size_t DecodeUtf8(std::string_view sjis, Char* dest) noexcept {
+	static_assert(sizeof(Char) == 1);
+
+	const auto src = sjis.data();
+	const auto size = sjis.size();
+	auto out = reinterpret_cast<char*>(dest);
+
+	for (std::size_t i = 0; i < size;) {
+		const auto ascii = detail::AsciiPrefix(src + i, size - i);
+		std::memcpy(out, src + i, ascii);
+		i += ascii;
+		out += ascii;
+
+		while (i < size) {
+			const auto c = static_cast<uint8_t>(src[i]);
+			if (c < 0x80) {
+				break;
+			}
+
+			if (detail::IsLead(c) && i + 1 < size && detail::IsTrail(static_cast<uint8_t>(src[i + 1]))) {
+				out += detail::PutUtf8(detail::DecodeDouble(c, static_cast<uint8_t>(src[i + 1])), out);
+				i += 2;
+			}
+			else {
+				out += detail::PutUtf8(detail::DecodeSingle(c), out);
+				i += 1;
+			}
+		}
+	}
+
+	return static_cast<std::size_t>(out - reinterpret_cast<char*>(dest));
+}
+
+// utf-16 (or utf-32 in a 4-byte wchar_t) to cp932. returns the number of bytes written.
+template<typename Char>
+inline std::size_t EncodeUtf16(std::basic_string_view<Char> utf16, char* dest) noexcept {
+	static_assert(sizeof(Char) >= 2);
+
+	const auto src = utf16.data();
+	const auto size = utf16.size();
+	auto out = dest;
+
+	for (std::size_t i = 0; i < size;) {
+		const auto ascii = detail::NarrowAscii(src + i, size - i, out);
+		i += ascii;
+		out += ascii;
+
+		for (; i < size; ++i) {
+			auto u = static_cast<uint32_t>(src[i]);
+			if (u < 0x80) {
+				break;
+			}
+
+			// a surrogate pair is outside the bmp, so it has no cp932 code either way
+			if constexpr (sizeof(Char) == 2) {
+				if (0xD800 <= u && u <= 0xDBFF && i + 1 < size && 0xDC00 <= static_cast<uint32_t>(src[i + 1]) && static_cast<uint32_t>(src[i + 1]) <= 0xDFFF) {
+					++i;
+					u = 0x10000;
+				}
+			}
+			out += detail::EncodeUnit(u, out);
+		}
+	}
+
+	return static_cast<std::size_t>(out - dest);
+}
+
+// utf-8 to cp932. returns the number of bytes written.
+template<typename Char = char>
+inline std::size_t EncodeUtf8(std::basic_string_view<Char> utf8, char* dest) noexcept {
+	static_assert(sizeof(Char) == 1);
+
+	const auto src = reinterpret_cast<const char*>(utf8.data());
+	const auto size = utf8.size();
+	auto out = dest;
+
+	for (std::size_t i = 0; i < size;) {
+		const auto ascii = detail::AsciiPrefix(src + i, size - i);
+		std::memcpy(out, src + i, ascii);
+		i += ascii;
+		out += ascii;
+
+		auto p = reinterpret_cast<const uint8_t*>(src + i);
+		const auto end = reinterpret_cast<const uint8_t*>(src + size);
+		while (p != end && *p >= 0x80) {
+			out += detail::EncodeUnit(detail::NextUtf8(p, end), out);
+		}
+		i = static_cast<std::size_t>(reinterpret_cast<const char*>(p) - src);
+	}
+
+	return static_cast<std::size_t>(out - dest);
+}
+
+//
+// string api
+//
+template<typename Char = wchar_t>
+inline std::basic_string<Char> ToUtf16(std::string_view sjis) {
+	std::basic_string<Char> out(MaxUtf16Length(sjis.size()), Char{});
+	out.resize(DecodeUtf16(sjis, out.data()));
+	return out;
+}
+
+template<typename Char = char>
+inline std::basic_string<Char> ToUtf8(std::string_view sjis) {
+	std::basic_string<Char> out(MaxUtf8Length(sjis.size()), Char{});
+	out.resize(DecodeUtf8(sjis, out.data()));
+	return out;
+}
+
+template<typename Char>
+inline std::string FromUtf16(std::basic_string_view<Char> utf16) {
+	std::string out(MaxSjisLength(utf16.size()), '\0');
+	out.resize(EncodeUtf16(utf16, out.data()));
+	return out;
+}
+
+inline std::string FromUtf16(const std::wstring& utf16) {
+	return FromUtf16(std::wstring_view(utf16));
+}
+
+template<typename Char>
+inline std::string FromUtf8(std::basic_string_view<Char> utf8) {
+	std::string out(utf8.size(), '\0');
+	out.resize(EncodeUtf8(utf8, out.data()));
+	return out;
+}
+
+inline std::string FromUtf8(const std::string& utf8) {
+	return FromUtf8(std::string_view(utf8));
+}
+
+//
+// batch api
+//
+// decodes a whole table of cp932 names into one buffer: two allocations for the table instead of one per name.
+template<typename Char = wchar_t>
+class NameTable {
+public:
+	NameTable() = default;
+
+	// names is a range of anything a std::string_view can be made from
+	template<typename Names>
+	explicit NameTable(const Names& names) {
+		Assign(names);
+	}
+
+	template<typename Names>
+	void Assign(const Names& names) {
+		std::size_t total = 0;
+		std::size_t count = 0;
+		for (const auto& name : names) {
+			total += MaxUtf16Length(std::string_view(name).size());
+			++count;
+		}
+
+		chars_.resize(total);
+		offsets_.resize(count + 1);
+
+		std::size_t pos = 0;
+		std::size_t i = 0;
+		for (const auto& name : names) {
+			offsets_[i++] = pos;
+			pos += DecodeUtf16(std::string_view(name), chars_.data() + pos);
+		}
+		offsets_[count] = pos;
+		chars_.resize(pos);
+	}
+
+	std::size_t Size() const noexcept {
+		return offsets_.empty() ? 0 : offsets_.size() - 1;
+	}
+
+	std::basic_string_view<Char> operator[](std::size_t i) const noexcept {
+		return { chars_.data() + offsets_[i], offsets_[i + 1] - offsets_[i] };
+	}
+
+private:
+	std::vector<Char> chars_{};
+	std::vector<std::size_t> offsets_{};
+};
+
+}
@@ -0,0 +1,555 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//
+// mscap, the scene capture written by MmdSceneCaptor and read by MmdSceneImporter.
+//
+// v1 stores each bone as a 4x4 model space matrix per frame. v2 stores the rotation of each frame
+// as a smallest-three quaternion and the translation on a grid, both chosen per track to stay
+// within an error bound of the v1 matrices, then delta coded in blocks of variable bit width.
+// tracks that do not move are stored once, and tracks that are not rigid are stored as in v1.
+//
+// v3 keeps the v2 tracks but lays them out frame major, in chunks of a fixed number of frames
+// found through an index at the end of the file, so a reader can seek without parsing it all.
+//
+namespace mscap {
+
+// the top byte of the header is the version, 0 in v1 files. the rest are the capture flags.
+inline constexpr uint32_t Version1 = 1;
+inline constexpr uint32_t Version2 = 2;
+inline constexpr uint32_t Version3 = 3;
+inline constexpr uint32_t LatestVersion = Version3;
+
+inline constexpr uint32_t VersionShift = 24;
+
+inline uint32_t MakeHeader(uint32_t flags, uint32_t version) noexcept {
+	return flags | (version << VersionShift);
+}
+
+inline uint32_t GetVersion(uint32_t header) noexcept {
+	const auto version = header >> VersionShift;
+	return version == 0 ? Version1 : version;
+}
+
+inline uint32_t GetFlags(uint32_t header) noexcept {
+	return header & ((1u << VersionShift) - 1);
+}
+
+// row major with the translation in the last row, as D3DMATRIX and XMMATRIX
+using Matrix = std::array<float, 16>;
+
+inline constexpr Matrix IdentityMatrix = { 1.f,0.f,0.f,0.f, 0.f,1.f,0.f,0.f, 0.f,0.f,1.f,0.f, 0.f,0.f,0.f,1.f };
+
+// largest difference of an element, the error the encoder bounds
+inline float MaxError(const Matrix& a, const Matrix& b) noexcept {
+	float error = 0.f;
+	for (std::size_t i = 0; i < 16; ++i) {
+		error = std::max(error, std::abs(a[i] - b[i]));
+	}
+	return error;
+}
+
+enum class TrackEncoding : uint8_t {
+	Raw = 0,		// the v1 matrices
+	Identity = 1,
+	Constant = 2,	// one matrix for every frame
+	Quantized = 3,
+};
+
+//
+// Bits
+//
+class BitWriter {
+public:
+	explicit BitWriter(std::vector<uint8_t>& out) :
+		out_(out) {
+	}
+
+	void Write(uint32_t value, int bits) {
+		acc_ |= static_cast<uint64_t>(value) << count_;
+		count_ += bits;
+
+		while (count_ >= 8) {
+			out_.push_back(static_cast<uint8_t>(acc_));
+			acc_ >>= 8;
+			count_ -= 8;
+		}
+	}
+
+	void Flush() {
+		if (count_ > 0) {
+			out_.push_back(static_cast<uint8_t>(acc_));
+		}
+		acc_ = 0;
+		count_ = 0;
+	}
+
+private:
+	std::vector<uint8_t>& out_;
+	uint64_t acc_ = 0;
+	int count_ = 0;
+};
+
+class BitReader {
+public:
+	BitReader(const uint8_t* data, std::size_t size) :
+		data_(data),
+		size_(size) {
+	}
+
+	uint32_t Read(int bits) noexcept {
+		while (count_ < bits) {
+			if (pos_ >= size_) {
+				ok_ = false;
+				return 0;
+			}
+			acc_ |= static_cast<uint64_t>(data_[pos_++]) << count_;
+			count_ += 8;
+		}
+
+		const auto value = static_cast<uint32_t>(acc_ & ((uint64_t(1) << bits) - 1));
+		acc_ >>= bits;
+		count_ -= bits;
+		return value;
+	}
+
+	explicit operator bool() const noexcept {
+		return ok_;
+	}
+
+private:
+	const uint8_t* data_;
+	std::size_t size_;
+	std::size_t pos_ = 0;
+	uint64_t acc_ = 0;
+	int count_ = 0;
+	bool ok_ = true;
+};
+
+//
+// Streams of integers: the differences to the previous value, zigzagged, packed in blocks that
+// share the bit width of their largest difference. a value that does not change costs nothing
+// but its block header.
+//
+inline constexpr std::size_t BlockSize = 16;
+
+inline uint32_t ZigZag(int32_t value) noexcept {
+	return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t UnZigZag(uint32_t value) noexcept {
+	return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+inline int BitWidth(uint32_t value) noexcept {
+	int width = 0;
+	for (; value != 0; value >>= 1) {
+		++width;
+	}
+	return width;
+}
+
+inline void WriteStream(BitWriter& writer, const std::vector<int32_t>& values) {
+	std::array<uint32_t, BlockSize> deltas{};
+	int32_t prev = 0;
+
+	for (std::size_t begin = 0; begin < values.size(); begin += BlockSize) {
+		const auto count = std::min(BlockSize, values.size() - begin);
+
+		uint32_t bits = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			deltas[i] = ZigZag(static_cast<int32_t>(static_cast<uint32_t>(values[begin + i]) - static_cast<uint32_t>(prev)));
+			bits |= deltas[i];
+			prev = values[begin + i];
+		}
+
+		const auto width = BitWidth(bits);
+		writer.Write(static_cast<uint32_t>(width), 6);
+		for (std::size_t i = 0; i < count; ++i) {
+			writer.Write(deltas[i], width);
+		}
+	}
+}
+
+inline bool ReadStream(BitReader& reader, std::vector<int32_t>& values, std::size_t count) {
+	values.resize(count);
+	int32_t prev = 0;
+
+	for (std::size_t begin = 0; begin < count; begin += BlockSize) {
+		const auto width = static_cast<int>(reader.Read(6));
+		if (width > 32) {
+			return false;
+		}
+
+		for (std::size_t i = begin, end = std::min(begin + BlockSize, count); i < end; ++i) {
+			prev = static_cast<int32_t>(static_cast<uint32_t>(prev) + static_cast<uint32_t>(UnZigZag(reader.Read(width))));
+			values[i] = prev;
+		}
+	}
+
+	return static_cast<bool>(reader);
+}
+
+//
+// Rotations
+//
+using Quaternion = std::array<float, 4>;	// x, y, z, w
+
+inline Quaternion QuaternionFromMatrix(const Matrix& m) noexcept {
+	const float m00 = m[0], m01 = m[1], m02 = m[2];
+	const float m10 = m[4], m11 = m[5], m12 = m[6];
+	const float m20 = m[8], m21 = m[9], m22 = m[10];
+
+	Quaternion q{};
+	const float trace = m00 + m11 + m22;
+	if (trace > 0.f) {
+		const float s = std::sqrt(trace + 1.f) * 2.f;
+		q = { (m12 - m21) / s, (m20 - m02) / s, (m01 - m10) / s, 0.25f * s };
+	}
+	else if (m00 > m11 && m00 > m22) {
+		const float s = std::sqrt(1.f + m00 - m11 - m22) * 2.f;
+		q = { 0.25f * s, (m01 + m10) / s, (m20 + m02) / s, (m12 - m21) / s };
+	}
+	else if (m11 > m22) {
+		const float s = std::sqrt(1.f + m11 - m00 - m22) * 2.f;
+		q = { (m01 + m10) / s, 0.25f * s, (m12 + m21) / s, (m20 - m02) / s };
+	}
+	else {
+		const float s = std::sqrt(1.f + m22 - m00 - m11) * 2.f;
+		q = { (m20 + m02) / s, (m12 + m21) / s, 0.25f * s, (m01 - m10) / s };
+	}
+
+	const float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	for (auto& e : q) {
+		e /= length;
+	}
+	return q;
+}
+
+inline Matrix MatrixFromRotationTranslation(const Quaternion& q, const std::array<float, 3>& t) noexcept {
+	const float x = q[0], y = q[1], z = q[2], w = q[3];
+	return {
+		1.f - 2.f * (y * y + z * z),	2.f * (x * y + z * w),			2.f * (x * z - y * w),			0.f,
+		2.f * (x * y - z * w),			1.f - 2.f * (x * x + z * z),	2.f * (y * z + x * w),			0.f,
+		2.f * (x * z + y * w),			2.f * (y * z - x * w),			1.f - 2.f * (x * x + y * y),	0.f,
+		t[0],							t[1],							t[2],							1.f,
+	};
+}
+
+// the index of the largest component, which is made positive and left out,
+// and the other three scaled from [-1/sqrt2, 1/sqrt2] to integers of the given bits
+struct SmallestThree {
+	int32_t largest;
+	int32_t c[3];
+};
+
+inline constexpr float InvSqrt2 = 0.70710678f;
+
+inline SmallestThree Quantize(const Quaternion& q, int bits) noexcept {
+	int largest = 0;
+	for (int i = 1; i < 4; ++i) {
+		if (std::abs(q[i]) > std::abs(q[largest])) {
+			largest = i;
+		}
+	}
+
+	const float sign = q[largest] < 0.f ? -1.f : 1.f;
+	const float scale = static_cast<float>((1 << (bits - 1)) - 1) / InvSqrt2;
+
+	SmallestThree s{ largest, {} };
+	for (int i = 0, j = 0; i < 4; ++i) {
+		if (i != largest) {
+			const float v = std::clamp(sign * q[i], -InvSqrt2, InvSqrt2);
+			s.c[j++] = static_cast<int32_t>(std::lround(v * scale));
+		}
+	}
+	return s;
+}
+
+inline Quaternion Dequantize(const SmallestThree& s, int bits) noexcept {
+	const float scale = InvSqrt2 / static_cast<float>((1 << (bits - 1)) - 1);
+
+	Quaternion q{};
+	float sum = 0.f;
+	for (int i = 0, j = 0; i < 4; ++i) {
+		if (i != s.largest) {
+			q[i] = static_cast<float>(s.c[j++]) * scale;
+			sum += q[i] * q[i];
+		}
+	}
+	q[s.largest] = std::sqrt(std::max(0.f, 1.f - sum));
+	return q;
+}
+
+//
+// Bone tracks
+//
+inline constexpr float DefaultTolerance = 1e-3f;
+
+inline constexpr int MinRotationBits = 8;
+inline constexpr int MaxRotationBits = 24;
+inline constexpr int MaxTranslationExponent = 24;	// a grid of 2^-exponent
+
+namespace detail {
+
+inline void WriteBytes(std::vector<uint8_t>& out, const void* data, std::size_t size) {
+	const auto bytes = static_cast<const uint8_t*>(data);
+	out.insert(out.end(), bytes, bytes + size);
+}
+
+inline bool IsFinite(const std::vector<Matrix>& frames) noexcept {
+	return std::all_of(frames.begin(), frames.end(), [](const Matrix& m) { return std::all_of(m.begin(), m.end(), [](float e) { return std::isfinite(e); }); });
+}
+
+inline bool IsWithin(const std::vector<Matrix>& frames, const Matrix& value, float tolerance) noexcept {
+	return std::all_of(frames.begin(), frames.end(), [&](const Matrix& m) { return MaxError(m, value) <= tolerance; });
+}
+
+inline std::array<float, 3> QuantizeTranslation(const Matrix& m, int exponent, std::array<int32_t, 3>* out) noexcept {
+	const float step = std::ldexp(1.f, -exponent);
+
+	std::array<float, 3> t{};
+	for (int i = 0; i < 3; ++i) {
+		const auto q = static_cast<int32_t>(std::lround(m[12 + i] / step));
+		if (out) {
+			(*out)[i] = q;
+		}
+		t[i] = static_cast<float>(q) * step;
+	}
+	return t;
+}
+
+} // namespace detail
+
+// appends the track of one bone. a track is self contained, the decoder needs only its frame count.
+inline void EncodeBoneTrack(const std::vector<Matrix>& frames, std::vector<uint8_t>& out, float tolerance = DefaultTolerance) {
+	auto WriteRaw = [&] {
+		out.push_back(static_cast<uint8_t>(TrackEncoding::Raw));
+		for (const auto& m : frames) {
+			detail::WriteBytes(out, m.data(), sizeof(Matrix));
+		}
+	};
+
+	if (!detail::IsFinite(frames)) {
+		WriteRaw();
+		return;
+	}
+
+	if (frames.empty() || detail::IsWithin(frames, IdentityMatrix, tolerance)) {
+		out.push_back(static_cast<uint8_t>(TrackEncoding::Identity));
+		return;
+	}
+
+	if (detail::IsWithin(frames, frames.front(), tolerance)) {
+		out.push_back(static_cast<uint8_t>(TrackEncoding::Constant));
+		detail::WriteBytes(out, frames.front().data(), sizeof(Matrix));
+		return;
+	}
+
+	std::vector<Quaternion> rotations(frames.size());
+	std::transform(frames.begin(), frames.end(), rotations.begin(), QuaternionFromMatrix);
+
+	// the rotation and the translation rows of the matrix do not mix, so each takes the coarsest precision within the bound
+	auto RotationError = [&](int bits) {
+		float error = 0.f;
+		for (std::size_t fi = 0; fi < frames.size(); ++fi) {
+			auto m = MatrixFromRotationTranslation(Dequantize(Quantize(rotations[fi], bits), bits), { frames[fi][12], frames[fi][13], frames[fi][14] });
+			error = std::max(error, MaxError(m, frames[fi]));
+		}
+		return error;
+	};
+
+	auto TranslationError = [&](int exponent) {
+		const float limit = std::ldexp(1.f, 30 - exponent);	// the grid indices stay well inside int32
+
+		float error = 0.f;
+		for (const auto& m : frames) {
+			if (std::abs(m[12]) > limit || std::abs(m[13]) > limit || std::abs(m[14]) > limit) {
+				return limit;
+			}
+
+			const auto t = detail::QuantizeTranslation(m, exponent, nullptr);
+			for (int i = 0; i < 3; ++i) {
+				error = std::max(error, std::abs(t[i] - m[12 + i]));
+			}
+		}
+		return error;
+	};
+
+	int rotation_bits = MinRotationBits;
+	while (rotation_bits <= MaxRotationBits && RotationError(rotation_bits) > tolerance) {
+		++rotation_bits;
+	}
+
+	int exponent = 0;
+	while (exponent <= MaxTranslationExponent && TranslationError(exponent) > tolerance) {
+		++exponent;
+	}
+
+	// not a rigid transform, or too far from the origin for the grid
+	if (rotation_bits > MaxRotationBits || exponent > MaxTranslationExponent) {
+		WriteRaw();
+		return;
+	}
+
+	std::array<std::vector<int32_t>, 7> streams{};	// largest, 3 components, 3 translations
+	for (auto& stream : streams) {
+		stream.resize(frames.size());
+	}
+
+	for (std::size_t fi = 0; fi < frames.size(); ++fi) {
+		const auto s = Quantize(rotations[fi], rotation_bits);
+		streams[0][fi] = s.largest;
+		streams[1][fi] = s.c[0];
+		streams[2][fi] = s.c[1];
+		streams[3][fi] = s.c[2];
+
+		std::array<int32_t, 3> t{};
+		detail::QuantizeTranslation(frames[fi], exponent, &t);
+		streams[4][fi] = t[0];
+		streams[5][fi] = t[1];
+		streams[6][fi] = t[2];
+	}
+
+	out.push_back(static_cast<uint8_t>(TrackEncoding::Quantized));
+	out.push_back(static_cast<uint8_t>(rotation_bits));
+	out.push_back(static_cast<uint8_t>(exponent));
+
+	BitWriter writer(out);
+	for (const auto& stream : streams) {
+		WriteStream(writer, stream);
+	}
+	writer.Flush();
+}
+
+// more frames than a track of a file is taken to have, about 9.7 hours at 30 fps. the bytes of an
+// identity or constant track do not grow with its frames, so only this bounds what they decode to.
+inline constexpr int32_t MaxFrames = 1 << 20;
+
+// whether a track written by EncodeBoneTrack can hold num_frames frames, checked before decoding
+// allocates them. a quantized track has at least a block width in each of its streams per block.
+inline bool CanHoldFrames(const void* data, std::size_t size, std::size_t num_frames) noexcept {
+	const auto bytes = static_cast<const uint8_t*>(data);
+	if (size < 1 || num_frames > static_cast<std::size_t>(MaxFrames)) {
+		return false;
+	}
+
+	switch (static_cast<TrackEncoding>(bytes[0])) {
+	case TrackEncoding::Raw:
+		return num_frames <= (size - 1) / sizeof(Matrix);
+
+	case TrackEncoding::Quantized: {
+		const auto num_blocks = (num_frames + BlockSize - 1) / BlockSize;
+		return size >= 3 && 7 * 6 * num_blocks <= 8 * (size - 3);
+	}
+
+	default:
+		return true;
+	}
+}
+
+// decodes num_frames matrices of a track written by EncodeBoneTrack
+inline bool DecodeBoneTrack(const void* data, std::size_t size, std::size_t num_frames, Matrix* out) {
+	const auto bytes = static_cast<const uint8_t*>(data);
+	if (size < 1) {
+		return false;
+	}
+
+	switch (static_cast<TrackEncoding>(bytes[0])) {
+	case TrackEncoding::Raw:
+		if (size - 1 < sizeof(Matrix) * num_frames) {
+			return false;
+		}
+		std::memcpy(out, bytes + 1, sizeof(Matrix) * num_frames);
+		return true;
+
+	case TrackEncoding::Identity:
+		std::fill(out, out + num_frames, IdentityMatrix);
+		return true;
+
+	case TrackEncoding::Constant: {
+		if (size - 1 < sizeof(Matrix)) {
+			return false;
+		}
+		Matrix m{};
+		std::memcpy(m.data(), bytes + 1, sizeof(Matrix));
+		std::fill(out, out + num_frames, m);
+		return true;
+	}
+
+	case TrackEncoding::Quantized: {
+		if (size < 3) {
+			return false;
+		}
+
+		const int rotation_bits = bytes[1];
+		const int exponent = bytes[2];
+		if (rotation_bits < MinRotationBits || rotation_bits > MaxRotationBits || exponent > MaxTranslationExponent) {
+			return false;
+		}
+
+		BitReader reader(bytes + 3, size - 3);
+		std::array<std::vector<int32_t>, 7> streams{};
+		for (auto& stream : streams) {
+			if (!ReadStream(reader, stream, num_frames)) {
+				return false;
+			}
+		}
+
+		const float step = std::ldexp(1.f, -exponent);
+		for (std::size_t fi = 0; fi < num_frames; ++fi) {
+			const SmallestThree s{ streams[0][fi], { streams[1][fi], streams[2][fi], streams[3][fi] } };
+			if (s.largest < 0 || s.largest > 3) {
+				return false;
+			}
+
+			const std::array<float, 3> t = { static_cast<float>(streams[4][fi]) * step, static_cast<float>(streams[5][fi]) * step, static_cast<float>(streams[6][fi]) * step };
+			out[fi] = MatrixFromRotationTranslation(Dequantize(s, rotation_bits), t);
+		}
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+//
+// v3 layout, after the header:
+//   models   int32 count, then per model its name, int32 bone count, the bone names and the morph tracks
+//   camera   as in v1
+//   chunks   per chunk, for every bone of every model in order, uint32 size and the EncodeBoneTrack
+//            of the frames in the chunk. the last chunk may be shorter.
+//   index    int32 frame count, int32 frames per chunk, int32 chunk count, then per chunk a ChunkEntry
+//   footer   uint64 offset of the index, the last 8 bytes of the file
+//
+inline constexpr int32_t DefaultChunkFrames = 256;	// about 8.5 seconds at 30 fps
+
+// more matrices than a decoded chunk is taken to have, 256 MiB. a few chunks are resident at once.
+inline constexpr std::size_t MaxChunkSamples = std::size_t{ 1 } << 22;
+
+#pragma pack(push, 4)
+struct ChunkEntry {
+	uint64_t offset;	// from the start of the file
+	uint32_t size;
+};
+#pragma pack(pop)
+static_assert(sizeof(ChunkEntry) == 12);
+
+inline constexpr std::size_t FooterSize = sizeof(uint64_t);
+
+// in 64 bits, as a frame count near the int32 limit would overflow the rounding up
+inline int32_t GetNumChunks(int32_t num_frames, int32_t chunk_frames) noexcept {
+	if (num_frames <= 0 || chunk_frames <= 0) {
+		return 0;
+	}
+	return static_cast<int32_t>((static_cast<int64_t>(num_frames) + chunk_frames - 1) / chunk_frames);
+}
+
+} // namespace mscap
@@ -9,6 +9,8 @@
 #include <string>
 #include <functional>
 #include <algorithm>
+#include <numeric>
+#include <limits>
 #include <ranges>
 #include <chrono>
 #include <thread>
@@ -1,10 +1,41 @@
 #pragma once
 #include <vector>
+#include <array>
 #include <map>
+#include <unordered_map>
 #include <string>
+#include <string_view>
 #include <fstream>
-
-// portable header-only mmd
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <filesystem>
+#include <span>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PORTABLE_MMD_SSE2
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PORTABLE_MMD_NEON
+#endif
+
+// portable mmd, header-only but for io::MappedFile. its system calls are in portable_mmd_platform.cpp,
+// which has to be compiled in by whatever maps a file, the loaders that take a path included.
 namespace portable_mmd {
 //
 // Common
@@ -20,6 +51,114 @@ inline constexpr Interpolation DefaultInterpolation{
 	20,107,20,107
 };
 
+//
+// Allocation
+//
+// container policies for Pmx and Vmd
+struct StdAlloc {
+	using allocator_type = std::allocator<std::byte>;
+
+	template<typename T>
+	using Vector = std::vector<T>;
+
+	template<typename Char>
+	using String = std::basic_string<Char>;
+
+	template<typename Key, typename T>
+	using Map = std::map<Key, T>;
+};
+
+// every string and array draws from one std::pmr::memory_resource, typically an Arena per file
+struct PmrAlloc {
+	using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+	template<typename T>
+	using Vector = std::pmr::vector<T>;
+
+	template<typename Char>
+	using String = std::pmr::basic_string<Char>;
+
+	template<typename Key, typename T>
+	using Map = std::pmr::map<Key, T>;
+};
+
+struct ArenaStats {
+	std::size_t	num_allocations;
+	std::size_t	bytes_allocated;	// nothing is returned before release, so this is also the high-water mark
+	std::size_t	num_blocks;
+	std::size_t	bytes_reserved;		// taken from the upstream resource
+};
+
+// monotonic memory resource for the contents of one file. deallocation is a no-op and
+// the blocks go back upstream all at once. allocation takes a lock so that sections decoded
+// in parallel can share the arena.
+class Arena : public std::pmr::memory_resource {
+public:
+	explicit Arena(std::size_t initial_size = 64 * 1024, std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) :
+		upstream_(upstream, &stats_),
+		arena_(initial_size, &upstream_) {
+	}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void Release() {
+		std::lock_guard lock(mutex_);
+		arena_.release();
+		stats_ = {};
+	}
+
+	ArenaStats Stats() const {
+		std::lock_guard lock(mutex_);
+		return stats_;
+	}
+
+private:
+	struct Upstream : std::pmr::memory_resource {
+		std::pmr::memory_resource* resource;
+		ArenaStats* stats;
+
+		Upstream(std::pmr::memory_resource* resource, ArenaStats* stats) :
+			resource(resource),
+			stats(stats) {
+		}
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+			auto ptr = resource->allocate(bytes, alignment);
+			++stats->num_blocks;
+			stats->bytes_reserved += bytes;
+			return ptr;
+		}
+
+		void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+			resource->deallocate(ptr, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+	};
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		std::lock_guard lock(mutex_);
+		++stats_.num_allocations;
+		stats_.bytes_allocated += bytes;
+		return arena_.allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void*, std::size_t, std::size_t) override {
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+
+	mutable std::mutex mutex_{};
+	ArenaStats stats_{};
+	Upstream upstream_;
+	std::pmr::monotonic_buffer_resource arena_;
+};
+
 template<int N = 8>
 inline constexpr float BezierInterp(float x, float x1, float x2, float y1, float y2) noexcept {
 	auto Bezier = [](float t, float p1, float p2) noexcept {
@@ -48,6 +187,376 @@ inline constexpr float BezierInterp(float x, const Interpolation& interp) noexce
 	return BezierInterp<N>(x, static_cast<float>(interp.x1) / 127.f, static_cast<float>(interp.x2) / 127.f, static_cast<float>(interp.y1) / 127.f, static_cast<float>(interp.y2) / 127.f);
 }
 
+// one interpolation curve with x -> t tabulated at build time. evaluation takes the bracket
+// from the table and refines it with safeguarded newton steps, bisecting wherever newton leaves
+// the bracket or stops halving the step, as it does near the vertical tangents. it stops once
+// the step is below StepTolerance, which takes two or three steps on most curves and at most
+// MaxIterations. over every curve with control points on a grid of 3, the error against an
+// exact solve is below 3e-5, most of it float rounding of x(t) at the vertical tangents, and
+// 1e-7 on average.
+class BezierCurve {
+public:
+	static constexpr int TableSize = 64;
+	static constexpr int MaxIterations = 32;
+	static constexpr float StepTolerance = 1e-6f;
+
+	BezierCurve() noexcept :
+		BezierCurve(DefaultInterpolation) {
+	}
+
+	explicit BezierCurve(const Interpolation& interp) noexcept :
+		interp_(interp) {
+		// out of range control points would make x(t) non-monotonic
+		auto Point = [](int8_t p) { return static_cast<double>(std::clamp<int>(p, 0, 127)) / 127.; };
+		const double x1 = Point(interp.x1), x2 = Point(interp.x2);
+		const double y1 = Point(interp.y1), y2 = Point(interp.y2);
+
+		x_ = { static_cast<float>(3. * x1 - 3. * x2 + 1.), static_cast<float>(-6. * x1 + 3. * x2), static_cast<float>(3. * x1) };
+		y_ = { static_cast<float>(3. * y1 - 3. * y2 + 1.), static_cast<float>(-6. * y1 + 3. * y2), static_cast<float>(3. * y1) };
+
+		auto X = [=](double t) {
+			return ((3. * x1 - 3. * x2 + 1.) * t + (-6. * x1 + 3. * x2)) * t * t + 3. * x1 * t;
+		};
+
+		// x(t) is monotonic, so each bisection starts from the previous root.
+		// 28 halvings are past float precision.
+		t_.front() = 0.f;
+		t_.back() = 1.f;
+		double lo = 0.;
+		for (int i = 1; i < TableSize; ++i) {
+			const double x = static_cast<double>(i) / TableSize;
+			double hi = 1.;
+			for (int k = 0; k < 28; ++k) {
+				const double mid = 0.5 * (lo + hi);
+				(X(mid) < x ? lo : hi) = mid;
+			}
+			t_[i] = static_cast<float>(0.5 * (lo + hi));
+		}
+	}
+
+	float operator()(float x) const noexcept {
+		x = std::clamp(x, 0.f, 1.f);
+
+		float lo = 0.f;
+		float hi = 1.f;
+		float t = Bracket(x, lo, hi);
+
+		float last_step = hi - lo;
+		for (int k = 0; k < MaxIterations; ++k) {
+			const float ft = Eval(x_, t) - x;
+			if (ft == 0.f) {
+				break;
+			}
+			(ft < 0.f ? lo : hi) = t;
+
+			// the range check also rejects the nan and inf of a zero slope
+			float next = t - ft / Slope(x_, t);
+			if (!(next > lo && next < hi) || std::abs(next - t) > 0.5f * last_step) {
+				next = 0.5f * (lo + hi);
+			}
+
+			last_step = std::abs(next - t);
+			t = next;
+			if (last_step < StepTolerance) {
+				break;
+			}
+		}
+
+		return Eval(y_, t);
+	}
+
+	// out[i] = (*curves[i])(x[i]) for every i of out, the same steps taken a vector of lanes at a time,
+	// each lane stopping where the scalar one does. curves and x must be at least as long as out.
+	static void Evaluate(std::span<const BezierCurve* const> curves, std::span<const float> x, std::span<float> out) noexcept;
+
+	const Interpolation& GetInterpolation() const noexcept {
+		return interp_;
+	}
+
+private:
+	using Coefficients = std::array<float, 3>;
+
+	// the table entries around x, which bracket its t, and the guess interpolated between them
+	float Bracket(float x, float& lo, float& hi) const noexcept {
+		const float f = x * TableSize;
+		const int i = std::min(static_cast<int>(f), TableSize - 1);
+		lo = t_[i];
+		hi = t_[i + 1];
+		return lo + (hi - lo) * (f - static_cast<float>(i));
+	}
+
+	static float Eval(const Coefficients& c, float t) noexcept {
+		return ((c[0] * t + c[1]) * t + c[2]) * t;
+	}
+
+	static float Slope(const Coefficients& c, float t) noexcept {
+		return (3.f * c[0] * t + 2.f * c[1]) * t + c[2];
+	}
+
+	Coefficients x_{};
+	Coefficients y_{};
+	std::array<float, TableSize + 1> t_{};
+	Interpolation interp_{};
+};
+
+// interns curves by their control points so that every track and model shares one table per
+// distinct curve. a vmd typically holds a few hundred of them. references stay valid for the
+// lifetime of the cache, so tracks resolve them once at import and evaluate without locking.
+class BezierCache {
+public:
+	BezierCache() = default;
+	BezierCache(const BezierCache&) = delete;
+	BezierCache& operator=(const BezierCache&) = delete;
+
+	const BezierCurve& Get(const Interpolation& interp) {
+		const uint32_t key = static_cast<uint32_t>(static_cast<uint8_t>(interp.x1))
+			| (static_cast<uint32_t>(static_cast<uint8_t>(interp.x2)) << 8)
+			| (static_cast<uint32_t>(static_cast<uint8_t>(interp.y1)) << 16)
+			| (static_cast<uint32_t>(static_cast<uint8_t>(interp.y2)) << 24);
+
+		std::lock_guard lock(mutex_);
+		auto& curve = curves_[key];
+		if (!curve) {
+			curve = std::make_unique<BezierCurve>(interp);
+		}
+		return *curve;
+	}
+
+	std::size_t Size() const {
+		std::lock_guard lock(mutex_);
+		return curves_.size();
+	}
+
+	static BezierCache& Shared() {
+		static BezierCache cache{};
+		return cache;
+	}
+
+private:
+	mutable std::mutex mutex_{};
+	std::unordered_map<uint32_t, std::unique_ptr<BezierCurve>> curves_{};
+};
+
+// the widest float vector the target was compiled for. comparisons give an M32 of the lanes
+// where they hold, which Select blends by and All reduces.
+namespace simd {
+#if defined(__AVX512F__)
+struct M32 {
+	__mmask16 v;
+
+	friend M32 operator&(M32 a, M32 b) noexcept { return { static_cast<__mmask16>(a.v & b.v) }; }
+	friend M32 operator|(M32 a, M32 b) noexcept { return { static_cast<__mmask16>(a.v | b.v) }; }
+	friend bool All(M32 m) noexcept { return m.v == 0xFFFF; }
+};
+
+struct F32 {
+	static constexpr std::size_t Width = 16;
+	__m512 v;
+
+	static F32 Set(float x) noexcept { return { _mm512_set1_ps(x) }; }
+	static F32 Load(const float* src) noexcept { return { _mm512_loadu_ps(src) }; }
+	void Store(float* dst) const noexcept { _mm512_storeu_ps(dst, v); }
+
+	friend F32 operator+(F32 a, F32 b) noexcept { return { _mm512_add_ps(a.v, b.v) }; }
+	friend F32 operator-(F32 a, F32 b) noexcept { return { _mm512_sub_ps(a.v, b.v) }; }
+	friend F32 operator*(F32 a, F32 b) noexcept { return { _mm512_mul_ps(a.v, b.v) }; }
+	friend F32 operator/(F32 a, F32 b) noexcept { return { _mm512_div_ps(a.v, b.v) }; }
+
+	static F32 Gather(const float* base, const int32_t* indices) noexcept { return { _mm512_i32gather_ps(_mm512_loadu_si512(indices), base, 4) }; }
+	friend F32 Min(F32 a, F32 b) noexcept { return { _mm512_min_ps(a.v, b.v) }; }
+	friend F32 Max(F32 a, F32 b) noexcept { return { _mm512_max_ps(a.v, b.v) }; }
+	friend F32 Abs(F32 a) noexcept { return { _mm512_abs_ps(a.v) }; }
+
+	friend M32 operator<(F32 a, F32 b) noexcept { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+	friend M32 operator<=(F32 a, F32 b) noexcept { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ) }; }
+	friend M32 operator>(F32 a, F32 b) noexcept { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+	friend M32 operator==(F32 a, F32 b) noexcept { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ) }; }
+	static F32 Select(M32 m, F32 a, F32 b) noexcept { return { _mm512_mask_blend_ps(m.v, b.v, a.v) }; }
+};
+#elif defined(__AVX2__)
+struct M32 {
+	__m256 v;
+
+	friend M32 operator&(M32 a, M32 b) noexcept { return { _mm256_and_ps(a.v, b.v) }; }
+	friend M32 operator|(M32 a, M32 b) noexcept { return { _mm256_or_ps(a.v, b.v) }; }
+	friend bool All(M32 m) noexcept { return _mm256_movemask_ps(m.v) == 0xFF; }
+};
+
+struct F32 {
+	static constexpr std::size_t Width = 8;
+	__m256 v;
+
+	static F32 Set(float x) noexcept { return { _mm256_set1_ps(x) }; }
+	static F32 Load(const float* src) noexcept { return { _mm256_loadu_ps(src) }; }
+	void Store(float* dst) const noexcept { _mm256_storeu_ps(dst, v); }
+
+	friend F32 operator+(F32 a, F32 b) noexcept { return { _mm256_add_ps(a.v, b.v) }; }
+	friend F32 operator-(F32 a, F32 b) noexcept { return { _mm256_sub_ps(a.v, b.v) }; }
+	friend F32 operator*(F32 a, F32 b) noexcept { return { _mm256_mul_ps(a.v, b.v) }; }
+	friend F32 operator/(F32 a, F32 b) noexcept { return { _mm256_div_ps(a.v, b.v) }; }
+
+	static F32 Gather(const float* base, const int32_t* indices) noexcept { return { _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), 4) }; }
+	friend F32 Min(F32 a, F32 b) noexcept { return { _mm256_min_ps(a.v, b.v) }; }
+	friend F32 Max(F32 a, F32 b) noexcept { return { _mm256_max_ps(a.v, b.v) }; }
+	friend F32 Abs(F32 a) noexcept { return { _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v) }; }
+
+	friend M32 operator<(F32 a, F32 b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+	friend M32 operator<=(F32 a, F32 b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+	friend M32 operator>(F32 a, F32 b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+	friend M32 operator==(F32 a, F32 b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+	static F32 Select(M32 m, F32 a, F32 b) noexcept { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+};
+#elif defined(PORTABLE_MMD_SSE2)
+struct M32 {
+	__m128 v;
+
+	friend M32 operator&(M32 a, M32 b) noexcept { return { _mm_and_ps(a.v, b.v) }; }
+	friend M32 operator|(M32 a, M32 b) noexcept { return { _mm_or_ps(a.v, b.v) }; }
+	friend bool All(M32 m) noexcept { return _mm_movemask_ps(m.v) == 0xF; }
+};
+
+struct F32 {
+	static constexpr std::size_t Width = 4;
+	__m128 v;
+
+	static F32 Set(float x) noexcept { return { _mm_set1_ps(x) }; }
+	static F32 Load(const float* src) noexcept { return { _mm_loadu_ps(src) }; }
+	void Store(float* dst) const noexcept { _mm_storeu_ps(dst, v); }
+
+	friend F32 operator+(F32 a, F32 b) noexcept { return { _mm_add_ps(a.v, b.v) }; }
+	friend F32 operator-(F32 a, F32 b) noexcept { return { _mm_sub_ps(a.v, b.v) }; }
+	friend F32 operator*(F32 a, F32 b) noexcept { return { _mm_mul_ps(a.v, b.v) }; }
+	friend F32 operator/(F32 a, F32 b) noexcept { return { _mm_div_ps(a.v, b.v) }; }
+
+	// no gather instruction before avx2
+	static F32 Gather(const float* base, const int32_t* indices) noexcept { return { _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]) }; }
+	friend F32 Min(F32 a, F32 b) noexcept { return { _mm_min_ps(a.v, b.v) }; }
+	friend F32 Max(F32 a, F32 b) noexcept { return { _mm_max_ps(a.v, b.v) }; }
+	friend F32 Abs(F32 a) noexcept { return { _mm_andnot_ps(_mm_set1_ps(-0.f), a.v) }; }
+
+	friend M32 operator<(F32 a, F32 b) noexcept { return { _mm_cmplt_ps(a.v, b.v) }; }
+	friend M32 operator<=(F32 a, F32 b) noexcept { return { _mm_cmple_ps(a.v, b.v) }; }
+	friend M32 operator>(F32 a, F32 b) noexcept { return { _mm_cmpgt_ps(a.v, b.v) }; }
+	friend M32 operator==(F32 a, F32 b) noexcept { return { _mm_cmpeq_ps(a.v, b.v) }; }
+	static F32 Select(M32 m, F32 a, F32 b) noexcept { return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) }; }
+};
+#elif defined(PORTABLE_MMD_NEON) && (defined(_M_ARM64) || defined(__aarch64__))
+// 32-bit neon has no vector division
+struct M32 {
+	uint32x4_t v;
+
+	friend M32 operator&(M32 a, M32 b) noexcept { return { vandq_u32(a.v, b.v) }; }
+	friend M32 operator|(M32 a, M32 b) noexcept { return { vorrq_u32(a.v, b.v) }; }
+	friend bool All(M32 m) noexcept { return vminvq_u32(m.v) != 0; }
+};
+
+struct F32 {
+	static constexpr std::size_t Width = 4;
+	float32x4_t v;
+
+	static F32 Set(float x) noexcept { return { vdupq_n_f32(x) }; }
+	static F32 Load(const float* src) noexcept { return { vld1q_f32(src) }; }
+	void Store(float* dst) const noexcept { vst1q_f32(dst, v); }
+
+	friend F32 operator+(F32 a, F32 b) noexcept { return { vaddq_f32(a.v, b.v) }; }
+	friend F32 operator-(F32 a, F32 b) noexcept { return { vsubq_f32(a.v, b.v) }; }
+	friend F32 operator*(F32 a, F32 b) noexcept { return { vmulq_f32(a.v, b.v) }; }
+	friend F32 operator/(F32 a, F32 b) noexcept { return { vdivq_f32(a.v, b.v) }; }
+
+	static F32 Gather(const float* base, const int32_t* indices) noexcept {
+		const float lanes[4] = { base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]] };
+		return { vld1q_f32(lanes) };
+	}
+	friend F32 Min(F32 a, F32 b) noexcept { return { vminq_f32(a.v, b.v) }; }
+	friend F32 Max(F32 a, F32 b) noexcept { return { vmaxq_f32(a.v, b.v) }; }
+	friend F32 Abs(F32 a) noexcept { return { vabsq_f32(a.v) }; }
+
+	friend M32 operator<(F32 a, F32 b) noexcept { return { vcltq_f32(a.v, b.v) }; }
+	friend M32 operator<=(F32 a, F32 b) noexcept { return { vcleq_f32(a.v, b.v) }; }
+	friend M32 operator>(F32 a, F32 b) noexcept { return { vcgtq_f32(a.v, b.v) }; }
+	friend M32 operator==(F32 a, F32 b) noexcept { return { vceqq_f32(a.v, b.v) }; }
+	static F32 Select(M32 m, F32 a, F32 b) noexcept { return { vbslq_f32(m.v, a.v, b.v) }; }
+};
+#else
+#define PORTABLE_MMD_NO_SIMD_F32
+#endif
+} // namespace simd
+
+// the curves of a block of lanes are transposed into structure-of-arrays on the stack, so the
+// newton steps and their bisection fallback run on whole vectors. lanes that have converged are
+// held by Select while the others go on, until every lane has.
+inline void BezierCurve::Evaluate(std::span<const BezierCurve* const> curves, std::span<const float> x, std::span<float> out) noexcept {
+	const std::size_t count = out.size();
+	std::size_t i = 0;
+
+#if !defined(PORTABLE_MMD_NO_SIMD_F32)
+	using simd::F32;
+	constexpr std::size_t Width = F32::Width;
+
+	struct Lanes {
+		float x[Width];
+		float lo[Width];
+		float hi[Width];
+		float t[Width];
+		float cx[3][Width];
+		float cy[3][Width];
+	};
+
+	const auto zero = F32::Set(0.f);
+	const auto half = F32::Set(0.5f);
+	const auto two = F32::Set(2.f);
+	const auto three = F32::Set(3.f);
+	const auto tolerance = F32::Set(StepTolerance);
+
+	for (; i + Width <= count; i += Width) {
+		Lanes lanes;
+		for (std::size_t l = 0; l < Width; ++l) {
+			const auto& curve = *curves[i + l];
+			lanes.x[l] = std::clamp(x[i + l], 0.f, 1.f);
+			lanes.t[l] = curve.Bracket(lanes.x[l], lanes.lo[l], lanes.hi[l]);
+			for (int c = 0; c < 3; ++c) {
+				lanes.cx[c][l] = curve.x_[c];
+				lanes.cy[c][l] = curve.y_[c];
+			}
+		}
+
+		const F32 cx[3] = { F32::Load(lanes.cx[0]), F32::Load(lanes.cx[1]), F32::Load(lanes.cx[2]) };
+		const auto xs = F32::Load(lanes.x);
+		auto lo = F32::Load(lanes.lo);
+		auto hi = F32::Load(lanes.hi);
+		auto t = F32::Load(lanes.t);
+		auto last_step = hi - lo;
+		auto done = zero < zero;
+
+		for (int k = 0; k < MaxIterations && !All(done); ++k) {
+			const auto ft = ((cx[0] * t + cx[1]) * t + cx[2]) * t - xs;
+			done = done | (ft == zero);
+
+			const auto below = ft < zero;
+			lo = F32::Select(below, t, lo);
+			hi = F32::Select(below, hi, t);
+
+			// as in the scalar version, a nan or inf from a zero slope fails the range check
+			auto next = t - ft / ((three * cx[0] * t + two * cx[1]) * t + cx[2]);
+			const auto newton = (next > lo) & (next < hi) & (Abs(next - t) <= half * last_step);
+			next = F32::Select(newton, next, half * (lo + hi));
+
+			const auto step = Abs(next - t);
+			t = F32::Select(done, t, next);
+			last_step = F32::Select(done, last_step, step);
+			done = done | (step < tolerance);
+		}
+
+		const F32 cy[3] = { F32::Load(lanes.cy[0]), F32::Load(lanes.cy[1]), F32::Load(lanes.cy[2]) };
+		(((cy[0] * t + cy[1]) * t + cy[2]) * t).Store(&out[i]);
+	}
+#endif
+
+	for (; i < count; ++i) {
+		out[i] = (*curves[i])(x[i]);
+	}
+}
+
 #pragma warning(push)
 #pragma warning( disable : 4324)
 //
@@ -107,8 +616,52 @@ enum class PmxJointType : uint8_t {
 	Spring6DOF = 0,
 };
 
-template<typename Vec2, typename Vec3, typename Vec4>
+enum class PmxSection : uint8_t {
+	Vertices = 0,
+	Faces,
+	Textures,
+	Materials,
+	Bones,
+	Morphs,
+	Nodes,
+	Bodies,
+	Joints,
+	Num,
+};
+
+inline constexpr PmxSection PmxSections[] = {
+	PmxSection::Vertices,
+	PmxSection::Faces,
+	PmxSection::Textures,
+	PmxSection::Materials,
+	PmxSection::Bones,
+	PmxSection::Morphs,
+	PmxSection::Nodes,
+	PmxSection::Bodies,
+	PmxSection::Joints,
+};
+
+// byte offset of each section from the head of the file
+struct PmxSectionIndex {
+	std::size_t offsets[static_cast<std::size_t>(PmxSection::Num) + 1];
+
+	std::size_t Begin(PmxSection section) const noexcept {
+		return offsets[static_cast<std::size_t>(section)];
+	}
+
+	std::size_t End(PmxSection section) const noexcept {
+		return offsets[static_cast<std::size_t>(section) + 1];
+	}
+};
+
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc = StdAlloc>
 struct Pmx {
+	using allocator_type = typename Alloc::allocator_type;
+	using String = typename Alloc::template String<wchar_t>;
+
+	template<typename T>
+	using Vector = typename Alloc::template Vector<T>;
+
 	struct Header {
 		float			version;
 		uint8_t			num_ex_data;
@@ -120,10 +673,10 @@ struct Pmx {
 		uint8_t			bone_index_size;
 		uint8_t			morph_index_size;
 		uint8_t			body_index_size;
-		std::wstring	name;
-		std::wstring	name_en;
-		std::wstring	comment;
-		std::wstring	comment_en;
+		String			name;
+		String			name_en;
+		String			comment;
+		String			comment_en;
 	};
 
 	struct Vertex {
@@ -140,11 +693,11 @@ struct Pmx {
 		float			edge;
 	};
 
-	using Texture = std::wstring;
+	using Texture = String;
 
 	struct Material {
-		std::wstring	name;
-		std::wstring	name_en;
+		String			name;
+		String			name_en;
 		Vec4			diffuse;
 		Vec4			specular;
 		Vec3			ambient;
@@ -160,7 +713,7 @@ struct Pmx {
 		uint8_t			sphere_mode;
 		bool			use_shared_toon;
 		int32_t			toon_texture_index;
-		std::wstring	note;
+		String			note;
 		int32_t			num_vertices;
 	};
 
@@ -172,8 +725,8 @@ struct Pmx {
 			Vec3		angle_max;
 		};
 
-		std::wstring	name;
-		std::wstring	name_en;
+		String			name;
+		String			name_en;
 		Vec3			position;
 		int32_t			parent_bone_index;
 		int32_t			level;
@@ -201,7 +754,7 @@ struct Pmx {
 		int32_t			ik_target_bone_index;
 		int32_t			ik_iteration_count;
 		float			ik_angle_limit;
-		std::vector<IkLink>	ik_links;
+		Vector<IkLink>	ik_links;
 	};
 
 	struct GroupMorphData {
@@ -240,11 +793,11 @@ struct Pmx {
 
 	template<typename Data>
 	struct Morph {
-		std::wstring	name;
-		std::wstring	name_en;
+		String			name;
+		String			name_en;
 		PmxMorphPanel		panel;
 		PmxMorphType		type;
-		std::vector<Data>	data;
+		Vector<Data>	data;
 	};
 	using GroupMorph = Morph<GroupMorphData>;
 	using VertexMorph = Morph<VertexMorphData>;
@@ -258,16 +811,16 @@ struct Pmx {
 			int32_t	 index;
 		};
 
-		std::wstring		name;
-		std::wstring		name_en;
-		bool				is_special;
-		std::vector<Item>	items;
+		String			name;
+		String			name_en;
+		bool			is_special;
+		Vector<Item>	items;
 	};
 
 	struct Body {
 
-		std::wstring	name;
-		std::wstring	name_en;
+		String			name;
+		String			name_en;
 		int32_t			index;
 		uint8_t			group;
 		uint16_t		non_collision_group;
@@ -284,8 +837,8 @@ struct Pmx {
 	};
 
 	struct Joint {
-		std::wstring	name;
-		std::wstring	name_en;
+		String			name;
+		String			name_en;
 		PmxJointType	type;
 		int32_t			body_index_a;
 		int32_t			body_index_b;
@@ -299,20 +852,44 @@ struct Pmx {
 		Vec3			sprint_const_rotation;
 	};
 
+	Pmx() = default;
+
+	// every container, down to the names and the per-element arrays, allocates from alloc
+	explicit Pmx(const allocator_type& alloc) :
+		header{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, String(alloc), String(alloc), String(alloc), String(alloc) },
+		vertices(alloc),
+		indices(alloc),
+		textures(alloc),
+		materials(alloc),
+		bones(alloc),
+		vertex_morphs(alloc),
+		uv_morphs(alloc),
+		bone_morphs(alloc),
+		material_morphs(alloc),
+		group_morphs(alloc),
+		nodes(alloc),
+		bodies(alloc),
+		joints(alloc) {
+	}
+
+	allocator_type get_allocator() const {
+		return allocator_type(vertices.get_allocator());
+	}
+
 	Header					header;
-	std::vector<Vertex>		vertices;
-	std::vector<int32_t>	indices;
-	std::vector<Texture>	textures;
-	std::vector<Material>	materials;
-	std::vector<Bone>		bones;
-	std::vector<VertexMorph>	vertex_morphs;
-	std::vector<UvMorph>		uv_morphs;
-	std::vector<BoneMorph>		bone_morphs;
-	std::vector<MaterialMorph>	material_morphs;
-	std::vector<GroupMorph>		group_morphs;
-	std::vector<Node>	nodes;
-	std::vector<Body>	bodies;
-	std::vector<Joint>	joints;
+	Vector<Vertex>			vertices;
+	Vector<int32_t>			indices;
+	Vector<Texture>			textures;
+	Vector<Material>		materials;
+	Vector<Bone>			bones;
+	Vector<VertexMorph>		vertex_morphs;
+	Vector<UvMorph>			uv_morphs;
+	Vector<BoneMorph>		bone_morphs;
+	Vector<MaterialMorph>	material_morphs;
+	Vector<GroupMorph>		group_morphs;
+	Vector<Node>			nodes;
+	Vector<Body>			bodies;
+	Vector<Joint>			joints;
 };
 
 //
@@ -320,12 +897,9 @@ struct Pmx {
 //
 inline constexpr char VmdMagic[30] = "Vocaloid Motion Data 0002\0\0\0\0";
 
+// key records, the same for every storage of a vmd
 template<typename Vec3, typename Vec4>
-struct Vmd {
-	struct Header {
-		std::string		name;
-	};
-
+struct VmdKeys {
 	struct MotionKey {
 		uint32_t		frame;
 		Vec3			position;
@@ -380,15 +954,6 @@ struct Vmd {
 		bool		visible;
 	};
 
-	Header	header;
-	std::map<std::string, std::vector<MotionKey>>	motions;
-	std::map<std::string, std::vector<MorphKey>>	morphs;
-	std::vector<CameraKey>		cameras;
-	std::vector<LightKey>		lights;
-	std::vector<ShadowKey>		shadows;
-	std::vector<VisibilityKey>	visibilities;
-	std::map<std::string, std::vector<IkKey>>	iks;
-
 	static constexpr MotionKey DefaultMotionKey{
 		0,
 		{},
@@ -421,8 +986,185 @@ struct Vmd {
 		false
 	};
 };
+
+template<typename Vec3, typename Vec4, typename Alloc = StdAlloc>
+struct Vmd : VmdKeys<Vec3, Vec4> {
+	using allocator_type = typename Alloc::allocator_type;
+	using String = typename Alloc::template String<char>;
+
+	template<typename T>
+	using Vector = typename Alloc::template Vector<T>;
+
+	template<typename Key>
+	using NamedTracks = typename Alloc::template Map<String, Vector<Key>>;
+
+	using MotionKey = typename VmdKeys<Vec3, Vec4>::MotionKey;
+	using MorphKey = typename VmdKeys<Vec3, Vec4>::MorphKey;
+	using CameraKey = typename VmdKeys<Vec3, Vec4>::CameraKey;
+	using LightKey = typename VmdKeys<Vec3, Vec4>::LightKey;
+	using ShadowKey = typename VmdKeys<Vec3, Vec4>::ShadowKey;
+	using IkKey = typename VmdKeys<Vec3, Vec4>::IkKey;
+	using VisibilityKey = typename VmdKeys<Vec3, Vec4>::VisibilityKey;
+
+	struct Header {
+		String		name;
+	};
+
+	Vmd() = default;
+
+	explicit Vmd(const allocator_type& alloc) :
+		header{ String(alloc) },
+		motions(alloc),
+		morphs(alloc),
+		cameras(alloc),
+		lights(alloc),
+		shadows(alloc),
+		visibilities(alloc),
+		iks(alloc) {
+	}
+
+	allocator_type get_allocator() const {
+		return allocator_type(cameras.get_allocator());
+	}
+
+	Header	header;
+	NamedTracks<MotionKey>	motions;
+	NamedTracks<MorphKey>	morphs;
+	Vector<CameraKey>		cameras;
+	Vector<LightKey>		lights;
+	Vector<ShadowKey>		shadows;
+	Vector<VisibilityKey>	visibilities;
+	NamedTracks<IkKey>		iks;
+};
 #pragma warning(pop)
 
+//
+// Flat Vmd
+//
+// vmd storage with every name interned once and the keys of each kind in one array sorted by (name id, frame).
+// names are cut at their terminator. a name id indexes the key range of every kind directly.
+using VmdNameId = uint32_t;
+
+inline constexpr VmdNameId NullVmdName = ~0u;
+
+struct VmdSymbolTable {
+	struct Hash {
+		using is_transparent = void;
+
+		std::size_t operator()(std::string_view str) const noexcept {
+			return std::hash<std::string_view>{}(str);
+		}
+	};
+
+	std::vector<std::string> names;
+	std::unordered_map<std::string, VmdNameId, Hash, std::equal_to<>> ids;
+
+	VmdNameId Intern(std::string_view name) {
+		if (auto it = ids.find(name); it != ids.end()) {
+			return it->second;
+		}
+
+		const auto id = static_cast<VmdNameId>(names.size());
+		names.emplace_back(name);
+		ids.emplace(names.back(), id);
+		return id;
+	}
+
+	VmdNameId Find(std::string_view name) const {
+		auto it = ids.find(name);
+		return it != ids.end() ? it->second : NullVmdName;
+	}
+
+	std::size_t Size() const noexcept {
+		return names.size();
+	}
+};
+
+struct VmdKeyRange {
+	uint32_t	begin;
+	uint32_t	end;
+};
+
+template<typename Key>
+struct FlatTracks {
+	std::vector<Key>			keys;	// sorted by (name id, frame)
+	std::vector<VmdKeyRange>	ranges;	// indexed by name id, empty for the names without a key of this kind
+
+	std::span<const Key> operator[](VmdNameId id) const noexcept {
+		if (id >= ranges.size()) {
+			return {};
+		}
+
+		const auto& range = ranges[id];
+		return std::span<const Key>(keys.data() + range.begin, range.end - range.begin);
+	}
+};
+
+template<typename Vec3, typename Vec4>
+struct FlatVmd : VmdKeys<Vec3, Vec4> {
+	using Header = typename Vmd<Vec3, Vec4>::Header;
+	using MotionKey = typename VmdKeys<Vec3, Vec4>::MotionKey;
+	using MorphKey = typename VmdKeys<Vec3, Vec4>::MorphKey;
+	using CameraKey = typename VmdKeys<Vec3, Vec4>::CameraKey;
+	using LightKey = typename VmdKeys<Vec3, Vec4>::LightKey;
+	using ShadowKey = typename VmdKeys<Vec3, Vec4>::ShadowKey;
+	using IkKey = typename VmdKeys<Vec3, Vec4>::IkKey;
+	using VisibilityKey = typename VmdKeys<Vec3, Vec4>::VisibilityKey;
+
+	Header	header;
+	VmdSymbolTable	names;
+	FlatTracks<MotionKey>	motions;
+	FlatTracks<MorphKey>	morphs;
+	std::vector<CameraKey>		cameras;
+	std::vector<LightKey>		lights;
+	std::vector<ShadowKey>		shadows;
+	std::vector<VisibilityKey>	visibilities;
+	FlatTracks<IkKey>	iks;
+
+	template<typename Key>
+	std::span<const Key> Find(const FlatTracks<Key>& tracks, std::string_view name) const {
+		return tracks[names.Find(name)];
+	}
+};
+
+//
+// Vmd Visitor
+//
+// callbacks for VmdParser. derive from it and hide the ones of interest, the rest are no-ops.
+// names are views of the raw zero padded fields in the file and are only valid during the call.
+// a Begin callback returning false skips its section without decoding the keys.
+template<typename Vec3, typename Vec4>
+struct VmdVisitor {
+	using VmdTy = VmdKeys<Vec3, Vec4>;
+
+	void OnHeader(std::string_view) {}
+
+	bool BeginMotions(uint32_t) { return true; }
+	void OnMotion(std::string_view, const typename VmdTy::MotionKey&) {}
+
+	bool BeginMorphs(uint32_t) { return true; }
+	void OnMorph(std::string_view, const typename VmdTy::MorphKey&) {}
+
+	bool BeginCameras(uint32_t) { return true; }
+	void OnCamera(const typename VmdTy::CameraKey&) {}
+
+	bool BeginLights(uint32_t) { return true; }
+	void OnLight(const typename VmdTy::LightKey&) {}
+
+	bool BeginShadows(uint32_t) { return true; }
+	void OnShadow(const typename VmdTy::ShadowKey&) {}
+
+	// one ex key carries a visibility key and the ik keys of the same frame
+	bool BeginExKeys(uint32_t) { return true; }
+	void OnVisibility(const typename VmdTy::VisibilityKey&) {}
+	void OnIk(std::string_view, const typename VmdTy::IkKey&) {}
+};
+
+// cut a raw name field at its terminator
+inline std::string_view TrimVmdName(std::string_view name) noexcept {
+	return name.substr(0, name.find('\0'));
+}
+
 namespace io {
 //
 // Reader
@@ -515,13 +1257,13 @@ struct CastReader : ReaderBase {
 
 template<typename From, typename To>
 inline CastReader<From>& operator>>(CastReader<From>& reader, To& out) noexcept {
-	reader.Cast<From, To, 1>(reinterpret_cast<To(&)[1]>(out));
+	reader.template Cast<From, To, 1>(reinterpret_cast<To(&)[1]>(out));
 	return reader;
 }
 
 template<typename From, typename To, std::size_t N>
 inline CastReader<From>& operator>>(CastReader<From>& reader, To(&out)[N]) noexcept {
-	reader.Cast<From, To, N>(out);
+	reader.template Cast<From, To, N>(out);
 	return reader;
 }
 
@@ -533,7 +1275,7 @@ template<typename T, std::size_t N>
 inline VectorReader<N>& operator>>(VectorReader<N>& reader, T& out) noexcept {
 	static_assert(sizeof(T) >= sizeof(float) * N);
 
-	reader.Copy<float, N>(reinterpret_cast<float(&)[N]>(out));
+	reader.template Copy<float, N>(reinterpret_cast<float(&)[N]>(out));
 	return reader;
 }
 
@@ -541,8 +1283,8 @@ template<std::size_t N>
 struct FixedLengthStringReader : ReaderBase {
 };
 
-template<typename Char, std::size_t N>
-inline FixedLengthStringReader<N>& operator>>(FixedLengthStringReader<N>& reader, std::basic_string<Char>& out) {
+template<typename Char, typename Traits, typename Alloc, std::size_t N>
+inline FixedLengthStringReader<N>& operator>>(FixedLengthStringReader<N>& reader, std::basic_string<Char, Traits, Alloc>& out) {
 	constexpr auto size = sizeof(Char) * N;
 	if (reader.IsOverflow(size)) {
 		return reader;
@@ -690,6 +1432,20 @@ public:
 		return Text<Char>(len);
 	}
 
+	// read into out, keeping its allocator
+	template<typename Char, typename Traits, typename Alloc>
+	void Text(std::basic_string<Char, Traits, Alloc>& out) {
+		const auto len = As<uint32_t>() / static_cast<uint32_t>(sizeof(Char));
+		const auto size = sizeof(Char) * len;
+		if (IsOverflow(size)) {
+			out.clear();
+			return;
+		}
+
+		out.assign(reinterpret_cast<const Char*>(cur), len);
+		Increment(size);
+	}
+
 	std::string TextA(uint32_t len) {
 		return Text<char>(len);
 	}
@@ -728,6 +1484,23 @@ public:
 		return *reinterpret_cast<FixedLengthStringReader<N>*>(this);
 	}
 
+	const char* Current() const noexcept {
+		return cur;
+	}
+
+	std::size_t Remain() const noexcept {
+		return remain;
+	}
+
+	bool Skip(std::size_t size) noexcept {
+		if (IsOverflow(size)) {
+			return false;
+		}
+
+		Increment(size);
+		return true;
+	}
+
 	operator bool() const noexcept {
 		return !overflow;
 	}
@@ -746,45 +1519,237 @@ inline Reader& operator>>(Reader& reader, T(&out)[N]) noexcept {
 	return reader;
 }
 
-template<typename Char>
-inline Reader& operator>>(Reader& reader, std::basic_string<Char>& out) {
-	out = reader.Text<Char>();
+template<typename Char, typename Traits, typename Alloc>
+inline Reader& operator>>(Reader& reader, std::basic_string<Char, Traits, Alloc>& out) {
+	reader.Text(out);
 	return reader;
 }
 
 //
-// Writer
+// Sink
 //
-struct WriterBase {
-	std::vector<char>* buf;
-	std::size_t cur;
+// where a Writer's bytes go. the writer fills a window handed out by the sink and only calls back
+// when it is full, so writing a field stays a bounds check and a memcpy.
+class Sink {
+public:
+	virtual ~Sink() = default;
 
-	WriterBase(std::vector<char>& dest) :
-		buf(&dest),
-		cur(dest.size()) {
-	}
+	// takes the first used bytes of the current window and returns the next one. empty on failure.
+	virtual std::span<char> Next(std::size_t used) = 0;
 
-	template<typename Src>
-	void Copy(const Src* src, std::size_t num) {
-		const auto size = sizeof(Src) * num;
-		buf->resize(cur + size);
-		std::memcpy(buf->data() + cur, src, size);
-		cur += size;
+	// takes the first used bytes of the last window. false if anything failed to reach the destination.
+	virtual bool Finish(std::size_t used) = 0;
+};
+
+// appends to a vector, growing it geometrically. reserve the exact size first to grow it once.
+class VectorSink : public Sink {
+public:
+	static constexpr std::size_t MinWindowSize = 4096;
+
+	explicit VectorSink(std::vector<char>& buf) :
+		buf_(buf),
+		size_(buf.size()) {
 	}
 
-	template<typename Src>
-	void Test(std::size_t num) {
-		const auto size = sizeof(Src) * num;
-		buf->resize(cur + size);
-		cur += size;
+	std::span<char> Next(std::size_t used) override {
+		size_ += used;
+		buf_.resize(std::max(size_ + MinWindowSize, buf_.capacity()));
+		return { buf_.data() + size_, buf_.size() - size_ };
 	}
 
-	void Test2(std::size_t size) {
-		buf->resize(cur + size);
-		cur += size;
+	bool Finish(std::size_t used) override {
+		size_ += used;
+		buf_.resize(size_);
+		return true;
 	}
+
+private:
+	std::vector<char>& buf_;
+	std::size_t size_;
 };
-static_assert(std::is_standard_layout_v<WriterBase>);
+
+// discards the bytes and counts them, for an exact-size pass before the real one
+class CountingSink : public Sink {
+public:
+	std::span<char> Next(std::size_t used) override {
+		size_ += used;
+		return scratch_;
+	}
+
+	bool Finish(std::size_t used) override {
+		size_ += used;
+		return true;
+	}
+
+	std::size_t Size() const noexcept {
+		return size_;
+	}
+
+private:
+	char scratch_[4096]{};
+	std::size_t size_ = 0;
+};
+
+// writes a file through a fixed-size buffer, one chunk at a time, so memory stays bounded by the chunk size.
+// with background set, each full chunk is written on another thread while the next one is filled.
+class FileSink : public Sink {
+public:
+	static constexpr std::size_t DefaultChunkSize = 1024 * 1024;
+
+	template<typename Path>
+	explicit FileSink(const Path& path, std::size_t chunk_size = DefaultChunkSize, bool background = false) :
+		ofs_(path, std::ios::binary),
+		background_(background) {
+		for (auto& buf : bufs_) {
+			buf.resize(std::max<std::size_t>(chunk_size, 1));
+			if (!background_) {
+				break;
+			}
+		}
+	}
+
+	~FileSink() override {
+		Wait();
+	}
+
+	FileSink(const FileSink&) = delete;
+	FileSink& operator=(const FileSink&) = delete;
+
+	explicit operator bool() const noexcept {
+		return static_cast<bool>(ofs_);
+	}
+
+	std::span<char> Next(std::size_t used) override {
+		// the previous chunk has to be out before its buffer is handed back
+		Wait();
+		if (!ofs_) {
+			return {};
+		}
+
+		if (!background_) {
+			ofs_.write(bufs_[0].data(), used);
+			return bufs_[0];
+		}
+
+		flusher_ = std::thread([this, data = bufs_[current_].data(), used] { ofs_.write(data, used); });
+		current_ ^= 1;
+		return bufs_[current_];
+	}
+
+	bool Finish(std::size_t used) override {
+		Wait();
+		if (!ofs_) {
+			return false;
+		}
+
+		ofs_.write(bufs_[current_].data(), used);
+		ofs_.close();
+		return !ofs_.fail();
+	}
+
+private:
+	std::ofstream ofs_;
+	std::vector<char> bufs_[2]{};
+	std::size_t current_ = 0;
+	bool background_;
+	std::thread flusher_{};
+
+	void Wait() {
+		if (flusher_.joinable()) {
+			flusher_.join();
+		}
+	}
+};
+
+//
+// Writer
+//
+struct WriterBase {
+	Sink* sink;
+	char* begin;
+	char* cur;
+	char* end;
+	bool failed;
+
+	explicit WriterBase(Sink& dest) :
+		sink(&dest),
+		begin(nullptr),
+		cur(nullptr),
+		end(nullptr),
+		failed(false) {
+	}
+
+	template<typename Src>
+	void Copy(const Src* src, std::size_t num) {
+		Put(src, sizeof(Src) * num);
+	}
+
+	void Put(const void* src, std::size_t size) {
+		const auto room = static_cast<std::size_t>(end - cur);
+		if (room != 0 && size <= room) [[likely]] {
+			std::memcpy(cur, src, size);
+			cur += size;
+		}
+		else {
+			PutSlow(src, size);
+		}
+	}
+
+	void Zero(std::size_t size) {
+		const auto room = static_cast<std::size_t>(end - cur);
+		if (room != 0 && size <= room) [[likely]] {
+			std::memset(cur, 0, size);
+			cur += size;
+		}
+		else {
+			PutSlow(nullptr, size);
+		}
+	}
+
+	// spans windows. src == nullptr writes zeros.
+	void PutSlow(const void* src, std::size_t size) {
+		auto bytes = static_cast<const char*>(src);
+		while (size > 0) {
+			if (cur == end && !Refill()) {
+				return;
+			}
+
+			const auto n = std::min(size, static_cast<std::size_t>(end - cur));
+			if (bytes) {
+				std::memcpy(cur, bytes, n);
+				bytes += n;
+			}
+			else {
+				std::memset(cur, 0, n);
+			}
+			cur += n;
+			size -= n;
+		}
+	}
+
+	bool Refill() {
+		if (failed) {
+			return false;
+		}
+
+		auto window = sink->Next(static_cast<std::size_t>(cur - begin));
+		if (window.empty()) {
+			failed = true;
+			begin = cur = end = nullptr;
+			return false;
+		}
+
+		begin = cur = window.data();
+		end = begin + window.size();
+		return true;
+	}
+
+	// hands the last window to the sink. false if any write failed.
+	bool Finish() {
+		return !failed && sink->Finish(static_cast<std::size_t>(cur - begin));
+	}
+};
+static_assert(std::is_standard_layout_v<WriterBase>);
 
 template<int N>
 struct VectorWriter : WriterBase {
@@ -792,7 +1757,7 @@ struct VectorWriter : WriterBase {
 
 template<typename T, int N>
 inline VectorWriter<N>& operator<<(VectorWriter<N>& writer, const T& in) {
-	writer.Copy<float>(reinterpret_cast<const float*>(&in), N);
+	writer.template Copy<float>(reinterpret_cast<const float*>(&in), N);
 	return writer;
 }
 
@@ -800,14 +1765,12 @@ template<int N>
 struct FixedLengthStringWriter : WriterBase {
 };
 
-template<typename Char, int N>
-inline FixedLengthStringWriter<N>& operator<<(FixedLengthStringWriter<N>& writer, const std::basic_string<Char>& str) {
+template<typename Char, typename Traits, typename Alloc, int N>
+inline FixedLengthStringWriter<N>& operator<<(FixedLengthStringWriter<N>& writer, const std::basic_string<Char, Traits, Alloc>& str) {
 	constexpr auto size = sizeof(Char) * N;
-	auto& buf = writer.buf;
-	auto& cur = writer.cur;
-	buf->resize(cur + size);
-	std::memcpy(buf->data() + cur, str.c_str(), std::min<std::size_t>(sizeof(Char) * str.length(), size));
-	cur += size;
+	const auto len = std::min<std::size_t>(sizeof(Char) * str.length(), size);
+	writer.Put(str.c_str(), len);
+	writer.Zero(size - len);
 	return writer;
 }
 
@@ -829,16 +1792,16 @@ struct Writer : WriterBase {
 		Copy(in, num);
 	}
 
-	template<typename Char>
-	void WriteText(const std::basic_string<Char>& in, uint32_t len) {
-		const auto size = static_cast<uint32_t>(sizeof(Char)) * len;
-		buf->resize(cur + size);
-		std::memcpy(buf->data() + cur, in.c_str(), std::min<std::size_t>(sizeof(Char) * in.length(), size));
-		cur += size;
+	template<typename Char, typename Traits, typename Alloc>
+	void WriteText(const std::basic_string<Char, Traits, Alloc>& in, uint32_t len) {
+		const auto size = sizeof(Char) * len;
+		const auto copied = std::min<std::size_t>(sizeof(Char) * in.length(), size);
+		Put(in.c_str(), copied);
+		Zero(size - copied);
 	}
 
-	template<typename Char>
-	void WriteText(const std::basic_string<Char>& in) {
+	template<typename Char, typename Traits, typename Alloc>
+	void WriteText(const std::basic_string<Char, Traits, Alloc>& in) {
 		Write(static_cast<uint32_t>(sizeof(Char) * in.length()));
 		WriteText(in, static_cast<uint32_t>(in.length()));
 	}
@@ -874,25 +1837,219 @@ inline Writer& operator<<(Writer& writer, const T(&in)[N]) {
 	return writer;
 }
 
-template<typename Char>
-inline Writer& operator<<(Writer& writer, const std::basic_string<Char>& str) {
+template<typename Char, typename Traits, typename Alloc>
+inline Writer& operator<<(Writer& writer, const std::basic_string<Char, Traits, Alloc>& str) {
 	writer.WriteText(str);
 	return writer;
 }
 
+//
+// Tasks
+//
+inline unsigned DefaultThreadCount() noexcept {
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// fork-join: runs the tasks on up to num_threads threads, the calling thread included, and waits for all of them.
+// 0 threads means one per hardware thread. the first exception thrown by a task is rethrown here.
+inline bool RunTasks(const std::vector<std::function<bool()>>& tasks, unsigned num_threads) {
+	if (num_threads == 0) {
+		num_threads = DefaultThreadCount();
+	}
+
+	std::atomic<std::size_t> next = 0;
+	std::atomic<bool> succeeded = true;
+	std::exception_ptr error{};
+	std::atomic_flag has_error{};
+
+	auto worker = [&] {
+		for (auto i = next++; i < tasks.size(); i = next++) {
+			try {
+				if (!tasks[i]()) {
+					succeeded = false;
+				}
+			}
+			catch (...) {
+				if (!has_error.test_and_set()) {
+					error = std::current_exception();
+				}
+				succeeded = false;
+			}
+		}
+	};
+
+	const auto num_workers = std::min<std::size_t>(num_threads, tasks.size());
+	std::vector<std::thread> threads{};
+	for (std::size_t i = 1; i < num_workers; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	return succeeded;
+}
+
+// RunTasks over threads that persist between runs, for work issued every frame.
+// one Run at a time, and never from inside one of its tasks.
+class TaskPool {
+public:
+	// num_threads counts the thread calling Run. 0 means one per hardware thread.
+	explicit TaskPool(unsigned num_threads = 0) {
+		if (num_threads == 0) {
+			num_threads = DefaultThreadCount();
+		}
+
+		for (unsigned i = 1; i < num_threads; ++i) {
+			threads_.emplace_back([this] { Loop(); });
+		}
+	}
+
+	~TaskPool() {
+		{
+			std::lock_guard lock(mtx_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+
+		for (auto& thread : threads_) {
+			thread.join();
+		}
+	}
+
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+
+	unsigned NumThreads() const noexcept {
+		return static_cast<unsigned>(threads_.size()) + 1;
+	}
+
+	bool Run(const std::vector<std::function<bool()>>& tasks) {
+		if (tasks.size() <= 1 || threads_.empty()) {
+			return RunTasks(tasks, 1);
+		}
+
+		{
+			std::lock_guard lock(mtx_);
+			tasks_ = &tasks;
+			next_ = 0;
+			succeeded_ = true;
+			error_ = nullptr;
+			has_error_.clear();
+			++generation_;
+		}
+		wake_.notify_all();
+
+		Work();
+
+		// every task has been claimed, so once no worker is busy they are all done
+		std::exception_ptr error{};
+		{
+			std::unique_lock lock(mtx_);
+			done_.wait(lock, [this] { return busy_ == 0; });
+			tasks_ = nullptr;
+			error = std::exchange(error_, nullptr);
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return succeeded_;
+	}
+
+private:
+	std::vector<std::thread> threads_{};
+
+	std::mutex mtx_{};
+	std::condition_variable wake_{};
+	std::condition_variable done_{};
+	const std::vector<std::function<bool()>>* tasks_ = nullptr;
+	std::size_t generation_ = 0;
+	unsigned busy_ = 0;
+	bool stop_ = false;
+
+	std::atomic<std::size_t> next_ = 0;
+	std::atomic<bool> succeeded_ = true;
+	std::exception_ptr error_{};
+	std::atomic_flag has_error_{};
+
+	void Work() {
+		const auto& tasks = *tasks_;
+		for (auto i = next_++; i < tasks.size(); i = next_++) {
+			try {
+				if (!tasks[i]()) {
+					succeeded_ = false;
+				}
+			}
+			catch (...) {
+				if (!has_error_.test_and_set()) {
+					error_ = std::current_exception();
+				}
+				succeeded_ = false;
+			}
+		}
+	}
+
+	void Loop() {
+		std::size_t seen = 0;
+		std::unique_lock lock(mtx_);
+
+		for (;;) {
+			// a worker that wakes after its run has returned finds no tasks and sleeps again
+			wake_.wait(lock, [&] { return stop_ || (tasks_ && generation_ != seen); });
+			if (stop_) {
+				return;
+			}
+
+			seen = generation_;
+			++busy_;
+			lock.unlock();
+
+			Work();
+
+			lock.lock();
+			if (--busy_ == 0) {
+				done_.notify_all();
+			}
+		}
+	}
+};
+
 //
 // Load Pmx
 //
-template<typename Vec2, typename Vec3, typename Vec4>
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc = StdAlloc>
 struct PmxLoader {
-	using PmxTy = Pmx<Vec2, Vec3, Vec4>;
+	using PmxTy = Pmx<Vec2, Vec3, Vec4, Alloc>;
 
 	PmxTy& pmx;
 	Reader reader;
+	const char* file_data;
+	std::size_t file_size;
+	bool vertex_morph_data = true;	// false leaves VertexMorph::data empty, for callers that take it through LoadVertexMorphDataInto
 
 	PmxLoader(PmxTy& pmx, const void* data, std::size_t size) :
 		pmx(pmx),
-		reader(data, size) {
+		reader(data, size),
+		file_data(reinterpret_cast<const char*>(data)),
+		file_size(size) {
+	}
+
+	std::size_t Tell() const noexcept {
+		return static_cast<std::size_t>(reader.Current() - file_data);
+	}
+
+	bool Seek(std::size_t offset) noexcept {
+		if (offset > file_size) {
+			return false;
+		}
+
+		reader = Reader(file_data + offset, file_size - offset);
+		return true;
 	}
 
 	bool LoadHeader(typename PmxTy::Header& header) {
@@ -958,82 +2115,252 @@ struct PmxLoader {
 		return static_cast<bool>(reader);
 	}
 
+	struct VertexRun {
+		PmxWeightType	weight_type;
+		std::size_t		count;
+		std::size_t		stride;
+		const char*		data;
+	};
+
 	template<typename BoneIndex>
-	bool LoadVertices() {
-		const auto num_vertices = reader.Int32();
-		if (num_vertices < 0) {
-			return false;
+	static constexpr std::size_t WeightSize(PmxWeightType weight_type) noexcept {
+		switch (weight_type) {
+		case PmxWeightType::BDEF1: return sizeof(BoneIndex);
+		case PmxWeightType::BDEF2: return sizeof(BoneIndex) * 2 + sizeof(float);
+		case PmxWeightType::BDEF4: return sizeof(BoneIndex) * 4 + sizeof(float) * 4;
+		case PmxWeightType::SDEF: return sizeof(BoneIndex) * 2 + sizeof(float) + sizeof(float) * 3 * 3;
+		default: return 0;
 		}
+	}
 
-		pmx.vertices.resize(num_vertices);
-		for (auto& vertex : pmx.vertices) {
-			reader.ForVec3() >> vertex.position;
-			reader.ForVec3() >> vertex.normal;
-			reader.ForVec2() >> vertex.uv;
+	// unchecked reads for the vertex decoder. bounds are validated once by ScanVertices.
+	template<typename T>
+	static const char* Fetch(T& out, const char* src, std::size_t size = sizeof(T)) noexcept {
+		static_assert(std::is_trivially_copyable_v<T>);
 
-			for (int i = 0; i < pmx.header.num_ex_uvs; ++i) {
-				reader.ForVec4() >> vertex.ex_uvs[i];
-			}
+		std::memcpy(&out, src, size);
+		return src + size;
+	}
 
-			reader.For<PmxWeightType>() >> vertex.weight_type;
-			switch (vertex.weight_type) {
-			case PmxWeightType::BDEF1:
-				reader.For<BoneIndex>() >> vertex.bone_indices[0];
-				vertex.bone_indices[1] = -1;
-				vertex.bone_indices[2] = -1;
-				vertex.bone_indices[3] = -1;
-
-				vertex.bone_weights[0] = 1.f;
-				vertex.bone_weights[1] = 0.f;
-				vertex.bone_weights[2] = 0.f;
-				vertex.bone_weights[3] = 0.f;
-				break;
+	template<typename BoneIndex, int N>
+	static const char* FetchBoneIndices(int32_t(&out)[4], const char* src) noexcept {
+		static_assert(N <= 4);
 
-			case PmxWeightType::BDEF2:
-				reader.For<BoneIndex>() >> vertex.bone_indices[0];
-				reader.For<BoneIndex>() >> vertex.bone_indices[1];
-				vertex.bone_indices[2] = -1;
-				vertex.bone_indices[3] = -1;
-
-				reader >> vertex.bone_weights[0];
-				vertex.bone_weights[1] = 1.f - vertex.bone_weights[0];
-				vertex.bone_weights[2] = 0.f;
-				vertex.bone_weights[3] = 0.f;
-				break;
+		for (int i = 0; i < N; ++i) {
+			BoneIndex index{};
+			src = Fetch(index, src);
+			out[i] = static_cast<int32_t>(index);
+		}
+		return src;
+	}
 
-			case PmxWeightType::BDEF4:
-				reader.For<BoneIndex>() >> vertex.bone_indices[0];
-				reader.For<BoneIndex>() >> vertex.bone_indices[1];
-				reader.For<BoneIndex>() >> vertex.bone_indices[2];
-				reader.For<BoneIndex>() >> vertex.bone_indices[3];
-
-				reader >> vertex.bone_weights[0];
-				reader >> vertex.bone_weights[1];
-				reader >> vertex.bone_weights[2];
-				reader >> vertex.bone_weights[3];
-				break;
+#if defined(PORTABLE_MMD_SSE2)
+	// widen 4 packed bone indices to int32 at once
+	template<typename BoneIndex, int N> requires (N == 4)
+	static const char* FetchBoneIndices(int32_t(&out)[4], const char* src) noexcept {
+		__m128i indices{};
+		if constexpr (sizeof(BoneIndex) == 1) {
+			int32_t packed{};
+			std::memcpy(&packed, src, sizeof(packed));
+			indices = _mm_cvtsi32_si128(packed);
+			indices = _mm_unpacklo_epi8(indices, indices);
+			indices = _mm_srai_epi32(_mm_unpacklo_epi16(indices, indices), 24);
+		}
+		else if constexpr (sizeof(BoneIndex) == 2) {
+			indices = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+			indices = _mm_srai_epi32(_mm_unpacklo_epi16(indices, indices), 16);
+		}
+		else {
+			indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		}
 
-			case PmxWeightType::SDEF:
-				reader.For<BoneIndex>() >> vertex.bone_indices[0];
-				reader.For<BoneIndex>() >> vertex.bone_indices[1];
-				vertex.bone_indices[2] = -1;
-				vertex.bone_indices[3] = -1;
-
-				reader >> vertex.bone_weights[0];
-				vertex.bone_weights[1] = 0.f;
-				vertex.bone_weights[2] = 0.f;
-				vertex.bone_weights[3] = 0.f;
-
-				reader.ForVec3() >> vertex.sdef_c;
-				reader.ForVec3() >> vertex.sdef_r0;
-				reader.ForVec3() >> vertex.sdef_r1;
-				break;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), indices);
+		return src + sizeof(BoneIndex) * 4;
+	}
+#elif defined(PORTABLE_MMD_NEON)
+	// widen 4 packed bone indices to int32 at once
+	template<typename BoneIndex, int N> requires (N == 4)
+	static const char* FetchBoneIndices(int32_t(&out)[4], const char* src) noexcept {
+		BoneIndex packed[4]{};
+		std::memcpy(packed, src, sizeof(packed));
+
+		int32x4_t indices{};
+		if constexpr (sizeof(BoneIndex) == 1) {
+			int32_t word{};
+			std::memcpy(&word, packed, sizeof(word));
+			indices = vmovl_s16(vget_low_s16(vmovl_s8(vreinterpret_s8_s32(vdup_n_s32(word)))));
+		}
+		else if constexpr (sizeof(BoneIndex) == 2) {
+			indices = vmovl_s16(vld1_s16(packed));
+		}
+		else {
+			indices = vld1q_s32(packed);
+		}
 
-			default:
+		vst1q_s32(out, indices);
+		return src + sizeof(BoneIndex) * 4;
+	}
+#endif
+
+	// pass 1: walk the variable-length records once, validate the total size and
+	// split the section into runs of vertices that share a weight type.
+	template<typename BoneIndex>
+	bool ScanVertices(std::size_t num_vertices, std::vector<VertexRun>* runs) {
+		const auto head_size = sizeof(float) * (3 + 3 + 2 + 4 * static_cast<std::size_t>(pmx.header.num_ex_uvs));
+		const auto data = reader.Current();
+		const auto remain = reader.Remain();
+
+		std::size_t offset = 0;
+		for (std::size_t i = 0; i < num_vertices; ++i) {
+			if (remain - offset < head_size + sizeof(PmxWeightType)) {
 				return false;
 			}
 
-			reader >> vertex.edge;
+			const auto weight_type = static_cast<PmxWeightType>(data[offset + head_size]);
+			const auto weight_size = WeightSize<BoneIndex>(weight_type);
+			if (weight_size == 0) {
+				return false;
+			}
+
+			const auto stride = head_size + sizeof(PmxWeightType) + weight_size + sizeof(float);
+			if (remain - offset < stride) {
+				return false;
+			}
+
+			if (runs) {
+				if (runs->empty() || runs->back().weight_type != weight_type) {
+					runs->push_back({ weight_type, 0, stride, data + offset });
+				}
+				++runs->back().count;
+			}
+
+			offset += stride;
+		}
+
+		return reader.Skip(offset);
+	}
+
+	// pass 2: decode a run of fixed-stride records without per-field checks.
+	// each vertex is built whole and handed to emit, so the array is written once instead of zero-filled first.
+	// Vertex is Pmx::Vertex or any compact type with a subset of its members: the ones it lacks are stepped over.
+	template<typename BoneIndex, PmxWeightType WeightType, typename Vertex = typename PmxTy::Vertex, typename Emit>
+	void DecodeVertexRun(const VertexRun& run, Emit&& emit) const {
+		static_assert(sizeof(Vec2) >= sizeof(float) * 2 && sizeof(Vec3) >= sizeof(float) * 3 && sizeof(Vec4) >= sizeof(float) * 4);
+
+		const int num_ex_uvs = pmx.header.num_ex_uvs;
+
+		for (std::size_t vi = 0; vi < run.count; ++vi) {
+			const char* src = run.data + vi * run.stride;
+			const char* edge = src + run.stride - sizeof(float);
+			Vertex vertex{};
+
+			if constexpr (requires { vertex.position; }) {
+				Fetch(vertex.position, src, sizeof(float) * 3);
+			}
+			src += sizeof(float) * 3;
+
+			if constexpr (requires { vertex.normal; }) {
+				Fetch(vertex.normal, src, sizeof(float) * 3);
+			}
+			src += sizeof(float) * 3;
+
+			if constexpr (requires { vertex.uv; }) {
+				Fetch(vertex.uv, src, sizeof(float) * 2);
+			}
+			src += sizeof(float) * 2;
+
+			if constexpr (requires { vertex.ex_uvs; }) {
+				for (int i = 0; i < num_ex_uvs; ++i) {
+					Fetch(vertex.ex_uvs[i], src + sizeof(float) * 4 * i, sizeof(float) * 4);
+				}
+			}
+			src += sizeof(float) * 4 * num_ex_uvs;
+
+			if constexpr (requires { vertex.weight_type; }) {
+				vertex.weight_type = WeightType;
+			}
+			src += sizeof(PmxWeightType);
+
+			if constexpr (requires { vertex.bone_indices; vertex.bone_weights; }) {
+				if constexpr (WeightType == PmxWeightType::BDEF1) {
+					src = FetchBoneIndices<BoneIndex, 1>(vertex.bone_indices, src);
+					vertex.bone_indices[1] = -1;
+					vertex.bone_indices[2] = -1;
+					vertex.bone_indices[3] = -1;
+
+					vertex.bone_weights[0] = 1.f;
+					vertex.bone_weights[1] = 0.f;
+					vertex.bone_weights[2] = 0.f;
+					vertex.bone_weights[3] = 0.f;
+				}
+				else if constexpr (WeightType == PmxWeightType::BDEF2) {
+					src = FetchBoneIndices<BoneIndex, 2>(vertex.bone_indices, src);
+					vertex.bone_indices[2] = -1;
+					vertex.bone_indices[3] = -1;
+
+					src = Fetch(vertex.bone_weights[0], src);
+					vertex.bone_weights[1] = 1.f - vertex.bone_weights[0];
+					vertex.bone_weights[2] = 0.f;
+					vertex.bone_weights[3] = 0.f;
+				}
+				else if constexpr (WeightType == PmxWeightType::BDEF4) {
+					src = FetchBoneIndices<BoneIndex, 4>(vertex.bone_indices, src);
+					src = Fetch(vertex.bone_weights, src);
+				}
+				else if constexpr (WeightType == PmxWeightType::SDEF) {
+					src = FetchBoneIndices<BoneIndex, 2>(vertex.bone_indices, src);
+					vertex.bone_indices[2] = -1;
+					vertex.bone_indices[3] = -1;
+
+					src = Fetch(vertex.bone_weights[0], src);
+					vertex.bone_weights[1] = 0.f;
+					vertex.bone_weights[2] = 0.f;
+					vertex.bone_weights[3] = 0.f;
+				}
+			}
+
+			// the sdef vectors and the edge end the record, so they are found from its stride
+			if constexpr (WeightType == PmxWeightType::SDEF && requires { vertex.sdef_c; vertex.sdef_r0; vertex.sdef_r1; }) {
+				const char* sdef = edge - sizeof(float) * 3 * 3;
+				sdef = Fetch(vertex.sdef_c, sdef, sizeof(float) * 3);
+				sdef = Fetch(vertex.sdef_r0, sdef, sizeof(float) * 3);
+				Fetch(vertex.sdef_r1, sdef, sizeof(float) * 3);
+			}
+
+			if constexpr (requires { vertex.edge; }) {
+				Fetch(vertex.edge, edge);
+			}
+
+			emit(vertex);
+		}
+	}
+
+	template<typename BoneIndex, typename Vertex = typename PmxTy::Vertex, typename Emit>
+	void DecodeVertexRun(const VertexRun& run, Emit&& emit) const {
+		switch (run.weight_type) {
+		case PmxWeightType::BDEF1: DecodeVertexRun<BoneIndex, PmxWeightType::BDEF1, Vertex>(run, emit); break;
+		case PmxWeightType::BDEF2: DecodeVertexRun<BoneIndex, PmxWeightType::BDEF2, Vertex>(run, emit); break;
+		case PmxWeightType::BDEF4: DecodeVertexRun<BoneIndex, PmxWeightType::BDEF4, Vertex>(run, emit); break;
+		case PmxWeightType::SDEF: DecodeVertexRun<BoneIndex, PmxWeightType::SDEF, Vertex>(run, emit); break;
+		}
+	}
+
+	template<typename BoneIndex>
+	bool LoadVertices() {
+		const auto num_vertices = reader.Int32();
+		if (num_vertices < 0) {
+			return false;
+		}
+
+		std::vector<VertexRun> runs{};
+		if (!ScanVertices<BoneIndex>(static_cast<std::size_t>(num_vertices), &runs)) {
+			return false;
+		}
+
+		pmx.vertices.clear();
+		pmx.vertices.reserve(num_vertices);
+		for (const auto& run : runs) {
+			DecodeVertexRun<BoneIndex>(run, [this](const auto& vertex) { pmx.vertices.push_back(vertex); });
 		}
 
 		return static_cast<bool>(reader);
@@ -1054,6 +2381,17 @@ struct PmxLoader {
 		return static_cast<bool>(reader);
 	}
 
+	// containers create their elements without the allocator, so the strings and arrays inside
+	// an element are rebound to it before they are filled
+	template<typename Container>
+	void Bind(Container& container) const {
+		using Allocator = typename Container::allocator_type;
+		if constexpr (!std::allocator_traits<Allocator>::is_always_equal::value) {
+			std::destroy_at(&container);
+			std::construct_at(&container, Allocator(pmx.get_allocator()));
+		}
+	}
+
 	bool LoadTextures() {
 		auto num_textures = reader.Int32();
 		if (num_textures < 0) {
@@ -1088,6 +2426,7 @@ struct PmxLoader {
 		reader >> material.sphere_mode;
 		reader >> material.use_shared_toon;
 		material.toon_texture_index = (material.use_shared_toon) ? reader.Uint8() : reader.As<TextureIndex>();
+		Bind(material.note);
 		reader >> material.note;
 		reader >> material.num_vertices;
 
@@ -1170,6 +2509,7 @@ struct PmxLoader {
 				return false;
 			}
 
+			Bind(bone.ik_links);
 			bone.ik_links.resize(num_ik_links);
 			for (auto& ik_link : bone.ik_links) {
 				reader.For<BoneIndex>() >> ik_link.index;
@@ -1239,15 +2579,26 @@ struct PmxLoader {
 		return true;
 	}
 
-	template<typename Index, typename Morph>
-	bool LoadMorphData(const std::wstring& name, const std::wstring& name_en, typename PmxMorphPanel panel, typename PmxMorphType type, std::vector<Morph>& morphs) {
-		auto& morph = morphs.emplace_back(name, name_en, panel, type);
+	template<typename Index, typename Morphs>
+	bool LoadMorphData(const std::wstring& name, const std::wstring& name_en, PmxMorphPanel panel, PmxMorphType type, Morphs& morphs, bool keep_data = true) {
+		auto& morph = morphs.emplace_back();
+		Bind(morph.name);
+		Bind(morph.name_en);
+		Bind(morph.data);
+		morph.name.assign(name.begin(), name.end());
+		morph.name_en.assign(name_en.begin(), name_en.end());
+		morph.panel = panel;
+		morph.type = type;
 
 		int32_t num_data = reader.Int32();
 		if (num_data < 0) {
 			return false;
 		}
 
+		if (!keep_data) {
+			return reader.Skip(MorphDataSize(type) * static_cast<std::size_t>(num_data));
+		}
+
 		morph.data.resize(num_data);
 		for (auto& data : morph.data) {
 			if (!LoadMorphData<Index>(data)) {
@@ -1264,9 +2615,12 @@ struct PmxLoader {
 			return false;
 		}
 
+		// the names are read before the type says which array the morph goes to, so they go through scratch strings first
+		std::wstring name{};
+		std::wstring name_en{};
 		for (int i = 0; i < num_morphs; ++i) {
-			auto name = reader.TextW();
-			auto name_en = reader.TextW();
+			reader >> name;
+			reader >> name_en;
 			auto panel = reader.As<PmxMorphPanel>();
 			auto type = reader.As<PmxMorphType>();
 
@@ -1282,9 +2636,9 @@ struct PmxLoader {
 
 			case PmxMorphType::Vertex:
 				switch (pmx.header.vertex_index_size) {
-				case 1: ret = LoadMorphData<int8_t>(name, name_en, panel, type, pmx.vertex_morphs); break;
-				case 2: ret = LoadMorphData<int16_t>(name, name_en, panel, type, pmx.vertex_morphs); break;
-				case 4: ret = LoadMorphData<int32_t>(name, name_en, panel, type, pmx.vertex_morphs); break;
+				case 1: ret = LoadMorphData<uint8_t>(name, name_en, panel, type, pmx.vertex_morphs, vertex_morph_data); break;
+				case 2: ret = LoadMorphData<uint16_t>(name, name_en, panel, type, pmx.vertex_morphs, vertex_morph_data); break;
+				case 4: ret = LoadMorphData<int32_t>(name, name_en, panel, type, pmx.vertex_morphs, vertex_morph_data); break;
 				}
 				break;
 
@@ -1302,8 +2656,8 @@ struct PmxLoader {
 			case PmxMorphType::ExUV3:
 			case PmxMorphType::ExUV4:
 				switch (pmx.header.vertex_index_size) {
-				case 1: ret = LoadMorphData<int8_t>(name, name_en, panel, type, pmx.uv_morphs); break;
-				case 2: ret = LoadMorphData<int16_t>(name, name_en, panel, type, pmx.uv_morphs); break;
+				case 1: ret = LoadMorphData<uint8_t>(name, name_en, panel, type, pmx.uv_morphs); break;
+				case 2: ret = LoadMorphData<uint16_t>(name, name_en, panel, type, pmx.uv_morphs); break;
 				case 4: ret = LoadMorphData<int32_t>(name, name_en, panel, type, pmx.uv_morphs); break;
 				}
 				break;
@@ -1352,6 +2706,7 @@ struct PmxLoader {
 			return false;
 		}
 
+		Bind(node.items);
 		node.items.resize(num_items);
 		for (auto& item : node.items) {
 			if (!LoadNodeItem<BoneIndex, MorphIndex>(item)) {
@@ -1363,7 +2718,7 @@ struct PmxLoader {
 	}
 
 	template<typename BoneIndex, typename MorphIndex>
-	bool LoadNodes(std::vector<typename PmxTy::Node>& nodes) {
+	bool LoadNodes(typename PmxTy::template Vector<typename PmxTy::Node>& nodes) {
 		auto num_nodes = reader.Int32();
 		if (num_nodes < 0) {
 			return false;
@@ -1371,6 +2726,8 @@ struct PmxLoader {
 
 		nodes.resize(num_nodes);
 		for (auto& node : nodes) {
+			Bind(node.name);
+			Bind(node.name_en);
 			reader >> node.name;
 			reader >> node.name_en;
 			if (!LoadNode<BoneIndex, MorphIndex>(node)) {
@@ -1435,8 +2792,8 @@ struct PmxLoader {
 		return true;
 	}
 
-	template<typename Index, typename Elem>
-	bool LoadElements(std::vector<Elem>& elems) {
+	template<typename Index, typename Elems>
+	bool LoadElements(Elems& elems) {
 		const auto num_elems = reader.Int32();
 		if (num_elems < 0) {
 			return false;
@@ -1444,6 +2801,8 @@ struct PmxLoader {
 
 		elems.resize(num_elems);
 		for (auto& elem : elems) {
+			Bind(elem.name);
+			Bind(elem.name_en);
 			reader >> elem.name;
 			reader >> elem.name_en;
 			if (!LoadElement<Index>(elem)) {
@@ -1454,119 +2813,472 @@ struct PmxLoader {
 		return static_cast<bool>(reader);
 	}
 
-	bool Load() {
-		if (!reader) {
-			return false;
-		}
+	bool LoadSection(PmxSection section) {
+		bool ret = false;
 
-		// Load Header
-		bool ret = LoadHeader(pmx.header);
-		if (!ret) {
-			return false;
-		}
+		switch (section) {
+		case PmxSection::Vertices:
+			switch (pmx.header.bone_index_size) {
+			case 1: ret = LoadVertices<int8_t>(); break;
+			case 2: ret = LoadVertices<int16_t>(); break;
+			case 4: ret = LoadVertices<int32_t>(); break;
+			}
+			break;
 
-		// Load Vertices
-		switch (pmx.header.bone_index_size) {
-		case 1: ret = LoadVertices<int8_t>(); break;
-		case 2: ret = LoadVertices<int16_t>(); break;
-		case 4: ret = LoadVertices<int32_t>(); break;
+		case PmxSection::Faces:
+			switch (pmx.header.vertex_index_size) {
+			case 1: ret = LoadFaces<uint8_t>(); break;
+			case 2: ret = LoadFaces<uint16_t>(); break;
+			case 4: ret = LoadFaces<int32_t>(); break;
+			}
+			break;
+
+		case PmxSection::Textures:
+			ret = LoadTextures();
+			break;
+
+		case PmxSection::Materials:
+			switch (pmx.header.texture_index_size) {
+			case 1: ret = LoadElements<int8_t>(pmx.materials); break;
+			case 2: ret = LoadElements<int16_t>(pmx.materials); break;
+			case 4: ret = LoadElements<int32_t>(pmx.materials); break;
+			}
+			break;
+
+		case PmxSection::Bones:
+			switch (pmx.header.bone_index_size) {
+			case 1: ret = LoadElements<int8_t>(pmx.bones); break;
+			case 2: ret = LoadElements<int16_t>(pmx.bones); break;
+			case 4: ret = LoadElements<int32_t>(pmx.bones); break;
+			}
+			break;
+
+		case PmxSection::Morphs:
+			ret = LoadMorphs();
+			break;
+
+		case PmxSection::Nodes:
+			switch (pmx.header.bone_index_size) {
+			case 1:
+				switch (pmx.header.morph_index_size) {
+				case 1: ret = LoadNodes<int8_t, int8_t>(pmx.nodes); break;
+				case 2: ret = LoadNodes<int8_t, int16_t>(pmx.nodes); break;
+				case 4: ret = LoadNodes<int8_t, int32_t>(pmx.nodes); break;
+				}
+				break;
+
+			case 2:
+				switch (pmx.header.morph_index_size) {
+				case 1: ret = LoadNodes<int16_t, int8_t>(pmx.nodes); break;
+				case 2: ret = LoadNodes<int16_t, int16_t>(pmx.nodes); break;
+				case 4: ret = LoadNodes<int16_t, int32_t>(pmx.nodes); break;
+				}
+				break;
+
+			case 4:
+				switch (pmx.header.morph_index_size) {
+				case 1: ret = LoadNodes<int32_t, int8_t>(pmx.nodes); break;
+				case 2: ret = LoadNodes<int32_t, int16_t>(pmx.nodes); break;
+				case 4: ret = LoadNodes<int32_t, int32_t>(pmx.nodes); break;
+				}
+				break;
+			}
+			break;
+
+		case PmxSection::Bodies:
+			switch (pmx.header.bone_index_size) {
+			case 1: ret = LoadElements<int8_t>(pmx.bodies); break;
+			case 2: ret = LoadElements<int16_t>(pmx.bodies); break;
+			case 4: ret = LoadElements<int32_t>(pmx.bodies); break;
+			}
+			break;
+
+		case PmxSection::Joints:
+			switch (pmx.header.body_index_size) {
+			case 1: ret = LoadElements<int8_t>(pmx.joints); break;
+			case 2: ret = LoadElements<int16_t>(pmx.joints); break;
+			case 4: ret = LoadElements<int32_t>(pmx.joints); break;
+			}
+			break;
+
+		default:
+			break;
 		}
-		if (!ret) {
+
+		return ret;
+	}
+
+	bool Load() {
+		if (!reader) {
 			return false;
 		}
 
-		// Load Faces
-		switch (pmx.header.vertex_index_size) {
-		case 1: ret = LoadFaces<uint8_t>(); break;
-		case 2: ret = LoadFaces<uint16_t>(); break;
-		case 4: ret = LoadFaces<int32_t>(); break;
+		// Load Header
+		if (!LoadHeader(pmx.header)) {
+			return false;
 		}
-		if (!ret) {
+
+		for (auto section : PmxSections) {
+			if (!LoadSection(section)) {
+				return false;
+			}
+		}
+
+		return static_cast<bool>(reader);
+	}
+
+	// skip-scan: step over a section without materializing it
+	bool SkipText() {
+		return reader.Skip(reader.Uint32()) && static_cast<bool>(reader);
+	}
+
+	template<typename BoneIndex>
+	bool SkipVertices() {
+		const auto num_vertices = reader.Int32();
+		if (num_vertices < 0) {
 			return false;
 		}
 
-		// Load Textures
-		ret = LoadTextures();
-		if (!ret) {
+		return ScanVertices<BoneIndex>(static_cast<std::size_t>(num_vertices), nullptr);
+	}
+
+	bool SkipFaces() {
+		const auto num_indices = reader.Int32();
+		if (num_indices < 0 || num_indices % 3) {
+			return false;
+		}
+
+		return reader.Skip(static_cast<std::size_t>(num_indices) * pmx.header.vertex_index_size);
+	}
+
+	bool SkipTextures() {
+		const auto num_textures = reader.Int32();
+		if (num_textures < 0) {
 			return false;
 		}
 
-		// Load Materials
-		switch (pmx.header.texture_index_size) {
-		case 1: ret = LoadElements<int8_t>(pmx.materials); break;
-		case 2: ret = LoadElements<int16_t>(pmx.materials); break;
-		case 4: ret = LoadElements<int32_t>(pmx.materials); break;
+		for (int i = 0; i < num_textures; ++i) {
+			if (!SkipText()) {
+				return false;
+			}
+		}
+
+		return static_cast<bool>(reader);
+	}
+
+	// size of one data record of a morph, 0 for an unknown type
+	std::size_t MorphDataSize(PmxMorphType type) const noexcept {
+		const auto& header = pmx.header;
+		switch (type) {
+		case PmxMorphType::Group: return header.morph_index_size + sizeof(float);
+		case PmxMorphType::Vertex: return header.vertex_index_size + sizeof(float) * 3;
+		case PmxMorphType::Bone: return header.bone_index_size + sizeof(float) * (3 + 4);
+		case PmxMorphType::UV:
+		case PmxMorphType::ExUV1:
+		case PmxMorphType::ExUV2:
+		case PmxMorphType::ExUV3:
+		case PmxMorphType::ExUV4: return header.vertex_index_size + sizeof(float) * 4;
+		case PmxMorphType::Material: return header.material_index_size + sizeof(PmxMaterialMorphOp) + sizeof(float) * (4 + 4 + 3 + 4 + 1 + 4 + 4 + 4);
+		default: return 0;
 		}
-		if (!ret) {
+	}
+
+	bool SkipMorphs() {
+		const auto num_morphs = reader.Int32();
+		if (num_morphs < 0) {
 			return false;
 		}
 
-		// Load Bones
-		switch (pmx.header.bone_index_size) {
-		case 1: ret = LoadElements<int8_t>(pmx.bones); break;
-		case 2: ret = LoadElements<int16_t>(pmx.bones); break;
-		case 4: ret = LoadElements<int32_t>(pmx.bones); break;
+		for (int i = 0; i < num_morphs; ++i) {
+			if (!SkipText() || !SkipText()) {
+				return false;
+			}
+
+			reader.As<PmxMorphPanel>();
+			const auto type = reader.As<PmxMorphType>();
+			const auto num_data = reader.Int32();
+			if (num_data < 0) {
+				return false;
+			}
+
+			const auto data_size = MorphDataSize(type);
+			if (data_size == 0 || !reader.Skip(data_size * static_cast<std::size_t>(num_data))) {
+				return false;
+			}
+		}
+
+		return static_cast<bool>(reader);
+	}
+
+	bool SkipSection(PmxSection section) {
+		switch (section) {
+		case PmxSection::Vertices:
+			switch (pmx.header.bone_index_size) {
+			case 1: return SkipVertices<int8_t>();
+			case 2: return SkipVertices<int16_t>();
+			case 4: return SkipVertices<int32_t>();
+			default: return false;
+			}
+
+		case PmxSection::Faces:
+			return SkipFaces();
+
+		case PmxSection::Textures:
+			return SkipTextures();
+
+		case PmxSection::Morphs:
+			return SkipMorphs();
+
+		default: {
+			// few and small variable-length records: decode them into a scratch pmx
+			// so that their layout is only described once.
+			PmxTy scratch{};
+			scratch.header = pmx.header;
+
+			PmxLoader loader(scratch, reader.Current(), reader.Remain());
+			if (!loader.LoadSection(section)) {
+				return false;
+			}
+
+			return reader.Skip(loader.Tell());
+		}
 		}
-		if (!ret) {
+	}
+
+	// requires the header to be loaded
+	bool BuildIndex(PmxSectionIndex& index) {
+		for (auto section : PmxSections) {
+			index.offsets[static_cast<std::size_t>(section)] = Tell();
+			if (!SkipSection(section)) {
+				return false;
+			}
+		}
+		index.offsets[static_cast<std::size_t>(PmxSection::Num)] = Tell();
+
+		return static_cast<bool>(reader);
+	}
+
+	//
+	// parallel decode
+	//
+	using Task = std::function<bool()>;
+
+	static constexpr std::size_t VertexChunkSize = 16 * 1024;
+	static constexpr std::size_t FaceChunkSize = 64 * 1024;
+
+	// presize the vertex array and split the runs into chunks that decode into their own slice of it
+	template<typename BoneIndex, typename Vertices>
+	bool PrepareVertexTasks(Vertices& vertices, std::vector<Task>& tasks) {
+		const auto num_vertices = reader.Int32();
+		if (num_vertices < 0) {
 			return false;
 		}
 
-		// Load Morphs
-		ret = LoadMorphs();
-		if (!ret) {
+		std::vector<VertexRun> runs{};
+		if (!ScanVertices<BoneIndex>(static_cast<std::size_t>(num_vertices), &runs)) {
 			return false;
 		}
 
-		// Load Nodes
-		switch (pmx.header.bone_index_size) {
-		case 1:
-			switch (pmx.header.morph_index_size) {
-			case 1: ret = LoadNodes<int8_t, int8_t>(pmx.nodes); break;
-			case 2: ret = LoadNodes<int8_t, int16_t>(pmx.nodes); break;
-			case 4: ret = LoadNodes<int8_t, int32_t>(pmx.nodes); break;
+		using Vertex = typename Vertices::value_type;
+
+		vertices.clear();
+		vertices.resize(num_vertices);
+
+		auto dest = vertices.data();
+		for (const auto& run : runs) {
+			for (std::size_t first = 0; first < run.count; first += VertexChunkSize) {
+				const VertexRun chunk = { run.weight_type, std::min(VertexChunkSize, run.count - first), run.stride, run.data + first * run.stride };
+				tasks.push_back([this, chunk, dest] {
+					auto out = dest;
+					DecodeVertexRun<BoneIndex, Vertex>(chunk, [&out](const auto& vertex) { *out++ = vertex; });
+					return true;
+				});
+				dest += chunk.count;
 			}
-			break;
+		}
+
+		return static_cast<bool>(reader);
+	}
+
+	template<typename VertexIndex>
+	bool PrepareFaceTasks(std::vector<Task>& tasks) {
+		const auto num_indices = reader.Int32();
+		if (num_indices < 0 || num_indices % 3) {
+			return false;
+		}
+
+		const auto src = reader.Current();
+		if (!reader.Skip(static_cast<std::size_t>(num_indices) * sizeof(VertexIndex))) {
+			return false;
+		}
+
+		pmx.indices.clear();
+		pmx.indices.resize(num_indices);
+
+		for (std::size_t first = 0; first < pmx.indices.size(); first += FaceChunkSize) {
+			const auto count = std::min(FaceChunkSize, pmx.indices.size() - first);
+			tasks.push_back([src = src + first * sizeof(VertexIndex), dest = pmx.indices.data() + first, count] {
+				for (std::size_t i = 0; i < count; ++i) {
+					VertexIndex index{};
+					Fetch(index, src + i * sizeof(VertexIndex));
+					dest[i] = static_cast<int32_t>(index);
+				}
+				return true;
+			});
+		}
+
+		return static_cast<bool>(reader);
+	}
 
-		case 2:
-			switch (pmx.header.morph_index_size) {
-			case 1: ret = LoadNodes<int16_t, int8_t>(pmx.nodes); break;
-			case 2: ret = LoadNodes<int16_t, int16_t>(pmx.nodes); break;
-			case 4: ret = LoadNodes<int16_t, int32_t>(pmx.nodes); break;
+	// decode the sections concurrently. each section fills its own members of pmx,
+	// and the vertex and face arrays are presized and further split into chunks.
+	// requires the header to be loaded and the index to be built.
+	bool LoadSections(const PmxSectionIndex& index, std::span<const PmxSection> sections, unsigned num_threads) {
+		std::vector<Task> tasks{};
+		std::vector<Task> chunks{};
+
+		for (auto section : sections) {
+			if (!Seek(index.Begin(section))) {
+				return false;
 			}
-			break;
 
-		case 4:
-			switch (pmx.header.morph_index_size) {
-			case 1: ret = LoadNodes<int32_t, int8_t>(pmx.nodes); break;
-			case 2: ret = LoadNodes<int32_t, int16_t>(pmx.nodes); break;
-			case 4: ret = LoadNodes<int32_t, int32_t>(pmx.nodes); break;
+			bool ret = false;
+			switch (section) {
+			case PmxSection::Vertices:
+				switch (pmx.header.bone_index_size) {
+				case 1: ret = PrepareVertexTasks<int8_t>(pmx.vertices, chunks); break;
+				case 2: ret = PrepareVertexTasks<int16_t>(pmx.vertices, chunks); break;
+				case 4: ret = PrepareVertexTasks<int32_t>(pmx.vertices, chunks); break;
+				}
+				break;
+
+			case PmxSection::Faces:
+				switch (pmx.header.vertex_index_size) {
+				case 1: ret = PrepareFaceTasks<uint8_t>(chunks); break;
+				case 2: ret = PrepareFaceTasks<uint16_t>(chunks); break;
+				case 4: ret = PrepareFaceTasks<int32_t>(chunks); break;
+				}
+				break;
+
+			default:
+				tasks.push_back([this, &index, section] {
+					PmxLoader loader(pmx, file_data, file_size);
+					loader.vertex_morph_data = vertex_morph_data;
+					return loader.Seek(index.Begin(section)) && loader.LoadSection(section);
+				});
+				ret = true;
+				break;
 			}
-			break;
+
+			if (!ret) {
+				return false;
+			}
+		}
+
+		// whole sections first so that the long ones start early, then the chunks fill the gaps
+		tasks.insert(tasks.end(), std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+		return RunTasks(tasks, num_threads);
+	}
+
+	bool LoadParallel(unsigned num_threads) {
+		// presizing costs more than it saves without a second thread
+		if (num_threads == 0) {
+			num_threads = DefaultThreadCount();
+		}
+		if (num_threads == 1) {
+			return Load();
 		}
-		if (!ret) {
+
+		if (!reader) {
 			return false;
 		}
 
-		// Load Bodies
-		switch (pmx.header.bone_index_size) {
-		case 1: ret = LoadElements<int8_t>(pmx.bodies); break;
-		case 2: ret = LoadElements<int16_t>(pmx.bodies); break;
-		case 4: ret = LoadElements<int32_t>(pmx.bodies); break;
+		if (!LoadHeader(pmx.header)) {
+			return false;
 		}
-		if (!ret) {
+
+		PmxSectionIndex index{};
+		if (!BuildIndex(index)) {
 			return false;
 		}
 
-		// Load Joints
-		switch (pmx.header.body_index_size) {
-		case 1: ret = LoadElements<int8_t>(pmx.joints); break;
-		case 2: ret = LoadElements<int16_t>(pmx.joints); break;
-		case 4: ret = LoadElements<int32_t>(pmx.joints); break;
+		return LoadSections(index, PmxSections, num_threads);
+	}
+
+	//
+	// direct decode
+	//
+	// the vertex and vertex morph sections decoded straight into caller arrays of compact types,
+	// for importers that would otherwise convert pmx.vertices and VertexMorph::data element by element.
+	// both require the header to be loaded and the reader at the section.
+
+	// dest is a std::vector-like array of any type with a subset of the Pmx::Vertex members
+	template<typename Vertices>
+	bool LoadVerticesInto(Vertices& dest, unsigned num_threads = 1) {
+		std::vector<Task> tasks{};
+
+		bool ret = false;
+		switch (pmx.header.bone_index_size) {
+		case 1: ret = PrepareVertexTasks<int8_t>(dest, tasks); break;
+		case 2: ret = PrepareVertexTasks<int16_t>(dest, tasks); break;
+		case 4: ret = PrepareVertexTasks<int32_t>(dest, tasks); break;
 		}
-		if (!ret) {
+
+		return ret && RunTasks(tasks, num_threads);
+	}
+
+	template<typename VertexIndex, typename Data>
+	static void DecodeVertexMorphData(const char* src, std::size_t count, Data* dest) noexcept {
+		for (std::size_t i = 0; i < count; ++i) {
+			VertexIndex index{};
+			src = Fetch(index, src);
+			src = Fetch(dest[i].offset, src, sizeof(float) * 3);
+			dest[i].index = static_cast<decltype(dest[i].index)>(index);
+		}
+	}
+
+	// dest(i) returns the std::vector-like array for the i-th vertex morph, of any type with index and offset members.
+	// the other morphs are stepped over.
+	template<typename Dest>
+	bool LoadVertexMorphDataInto(Dest&& dest) {
+		const auto num_morphs = reader.Int32();
+		if (num_morphs < 0) {
 			return false;
 		}
 
+		std::size_t num_vertex_morphs = 0;
+		for (int i = 0; i < num_morphs; ++i) {
+			if (!SkipText() || !SkipText()) {
+				return false;
+			}
+
+			reader.As<PmxMorphPanel>();
+			const auto type = reader.As<PmxMorphType>();
+			const auto num_data = reader.Int32();
+			if (num_data < 0) {
+				return false;
+			}
+
+			const auto data_size = MorphDataSize(type);
+			const auto src = reader.Current();
+			if (data_size == 0 || !reader.Skip(data_size * static_cast<std::size_t>(num_data))) {
+				return false;
+			}
+
+			if (type != PmxMorphType::Vertex) {
+				continue;
+			}
+
+			auto& data = dest(num_vertex_morphs++);
+			data.clear();
+			data.resize(num_data);
+			switch (pmx.header.vertex_index_size) {
+			case 1: DecodeVertexMorphData<uint8_t>(src, data.size(), data.data()); break;
+			case 2: DecodeVertexMorphData<uint16_t>(src, data.size(), data.data()); break;
+			case 4: DecodeVertexMorphData<int32_t>(src, data.size(), data.data()); break;
+			}
+		}
+
 		return static_cast<bool>(reader);
 	}
 };
@@ -1574,16 +3286,16 @@ struct PmxLoader {
 // 
 // Serialize Pmx
 //
-template<typename Vec2, typename Vec3, typename Vec4>
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc = StdAlloc>
 struct PmxSerializer {
-	using PmxTy = Pmx<Vec2, Vec3, Vec4>;
+	using PmxTy = Pmx<Vec2, Vec3, Vec4, Alloc>;
 
 	const PmxTy& pmx;
 	Writer writer;
 
-	PmxSerializer(const PmxTy& pmx, std::vector<char>& buf) :
+	PmxSerializer(const PmxTy& pmx, Sink& sink) :
 		pmx(pmx),
-		writer(buf) {
+		writer(sink) {
 	}
 
 	void SerializeHeader(const typename PmxTy::Header& header) {
@@ -1606,7 +3318,7 @@ struct PmxSerializer {
 		writer << header.comment_en;
 	}
 
-	void SerializeVertices(const std::vector<typename PmxTy::Vertex>& vertices, const typename PmxTy::Header& header) {
+	void SerializeVertices(const typename PmxTy::template Vector<typename PmxTy::Vertex>& vertices, const typename PmxTy::Header& header) {
 		writer << static_cast<uint32_t>(vertices.size());
 
 		for (const auto& vertex : vertices) {
@@ -1649,13 +3361,13 @@ struct PmxSerializer {
 		}
 	}
 
-	void SerializeFaces(const std::vector<int32_t>& indices) {
+	void SerializeFaces(const typename PmxTy::template Vector<int32_t>& indices) {
 		auto num_indices = static_cast<uint32_t>(indices.size());
 		writer << num_indices;
 		writer.WriteArray(indices.data(), num_indices);
 	}
 
-	void SerializeTextures(const std::vector<std::wstring>& textures) {
+	void SerializeTextures(const typename PmxTy::template Vector<typename PmxTy::Texture>& textures) {
 		auto num_textures = static_cast<uint32_t>(textures.size());
 		writer << num_textures;
 		for (const auto& texture : textures) {
@@ -1792,8 +3504,8 @@ struct PmxSerializer {
 		writer.ForVec4() << data.toon_texture_coef;
 	}
 
-	template<typename Morph>
-	void SerializeMorphsData(const std::vector<Morph>& morphs) {
+	template<typename Morphs>
+	void SerializeMorphsData(const Morphs& morphs) {
 		for (auto& morph : morphs) {
 			writer << morph.name;
 			writer << morph.name_en;
@@ -1866,8 +3578,8 @@ struct PmxSerializer {
 		}
 	}
 
-	template<typename Elem>
-	void SerializeElements(const std::vector<Elem>& elems) {
+	template<typename Elems>
+	void SerializeElements(const Elems& elems) {
 		writer << static_cast<uint32_t>(elems.size());
 		for (auto& elem : elems) {
 			writer << elem.name;
@@ -1888,38 +3600,59 @@ struct PmxSerializer {
 		SerializeElements(pmx.bodies);
 		SerializeElements(pmx.joints);
 
-		return true;
+		return writer.Finish();
 	}
 };
 
 //
-// Load Vmd
+// Stream Vmd
 //
-template<typename Vec3, typename Vec4>
-struct VmdLoader {
-	using VmdTy = Vmd<Vec3, Vec4>;
-
-	VmdTy& vmd;
+template<typename Vec3, typename Vec4, typename Visitor>
+struct VmdParser {
+	using VmdTy = VmdKeys<Vec3, Vec4>;
+
+	static constexpr std::size_t MotionNameSize = 15;
+	static constexpr std::size_t IkNameSize = 20;
+	static constexpr std::size_t MotionRecordSize = MotionNameSize + 4 + 4 * 3 + 4 * 4 + 64;
+	static constexpr std::size_t MorphRecordSize = MotionNameSize + 4 + 4;
+	static constexpr std::size_t CameraRecordSize = 4 + 4 + 4 * 3 + 4 * 3 + 4 * 6 + 4 + 1;
+	static constexpr std::size_t LightRecordSize = 4 + 4 * 3 + 4 * 3;
+	static constexpr std::size_t ShadowRecordSize = 4 + 1 + 4;
+
+	Visitor& visitor;
 	Reader reader;
 
-	VmdLoader(VmdTy& vmd, const void* data, std::size_t size) :
-		vmd(vmd),
+	VmdParser(Visitor& visitor, const void* data, std::size_t size) :
+		visitor(visitor),
 		reader(data, size) {
 	}
 
-	bool LoadHeader(typename VmdTy::Header& header) {
+	std::string_view Name(std::size_t size) {
+		const auto name = reader.Current();
+		if (!reader.Skip(size)) {
+			return {};
+		}
+
+		return std::string_view(name, size);
+	}
+
+	bool ParseHeader() {
 		char magic[30] = {};
 		reader >> magic;
-		if (memcmp(magic, VmdMagic, strlen(VmdMagic)) != 0) {
+		if (std::memcmp(magic, VmdMagic, std::strlen(VmdMagic)) != 0) {
 			return false;
 		}
 
-		reader.ForFixed<20>() >> header.name;
+		const auto name = Name(20);
+		if (!reader) {
+			return false;
+		}
 
-		return static_cast<bool>(reader);
+		visitor.OnHeader(name);
+		return true;
 	}
 
-	void LoadNamedKey(typename VmdTy::MotionKey& key) {
+	void ParseKey(typename VmdTy::MotionKey& key) {
 		reader >> key.frame;
 		reader.ForVec3() >> key.position;
 		reader.ForVec4() >> key.orientation;
@@ -1931,24 +3664,12 @@ struct VmdLoader {
 		key.physics = !(key.interpolation[2] == 0x63 && key.interpolation[3] == 0x0f);
 	}
 
-	void LoadNamedKey(typename VmdTy::MorphKey& key) {
+	void ParseKey(typename VmdTy::MorphKey& key) {
 		reader >> key.frame;
 		reader >> key.value;
 	}
 
-	template<typename Key>
-	bool LoadNamedTracks(std::map<std::string, std::vector<Key>>& trasks) {
-		const auto num_keys = reader.Uint32();
-		for (uint32_t i = 0; i < num_keys; ++i) {
-			auto name = reader.TextA(15);
-			auto& key = trasks[name].emplace_back(Key{});
-			LoadNamedKey(key);
-		}
-
-		return static_cast<bool>(reader);
-	}
-
-	void LoadKey(typename VmdTy::CameraKey& key) {
+	void ParseKey(typename VmdTy::CameraKey& key) {
 		reader >> key.frame;
 		reader >> key.distance;
 		reader.ForVec3() >> key.position;
@@ -1958,111 +3679,401 @@ struct VmdLoader {
 		reader.For<uint8_t>() >> key.parallel;
 	}
 
-	void LoadKey(typename VmdTy::LightKey& key) {
+	void ParseKey(typename VmdTy::LightKey& key) {
 		reader >> key.frame;
 		reader.ForVec3() >> key.color;
 		reader.ForVec3() >> key.position;
 	}
 
-	void LoadKey(typename VmdTy::ShadowKey& key) {
+	void ParseKey(typename VmdTy::ShadowKey& key) {
 		reader >> key.frame;
 		reader >> key.type;
 		reader >> key.distance;
 	}
 
-	template<typename Key>
-	bool LoadTrack(std::vector<Key>& keys) {
+	// records that are all the same size: check the whole section once, then decode or step over it
+	template<typename Key, typename Begin, typename Emit>
+	bool ParseSection(std::size_t record_size, Begin&& begin, Emit&& emit) {
 		const auto num_keys = reader.Uint32();
-		keys.resize(num_keys);
-		for (auto& key : keys) {
-			LoadKey(key);
+		if (!reader || reader.Remain() / record_size < num_keys) {
+			return false;
+		}
+
+		if (!begin(num_keys)) {
+			return reader.Skip(record_size * num_keys);
+		}
+
+		for (uint32_t i = 0; i < num_keys; ++i) {
+			Key key{};
+			emit(key);
 		}
 
 		return static_cast<bool>(reader);
 	}
 
-	void LoadIkKey(uint32_t frame) {
-		const auto name = reader.TextA(20);
-		const bool enable = reader.Uint8();
+	bool ParseMotions() {
+		return ParseSection<typename VmdTy::MotionKey>(MotionRecordSize,
+			[this](uint32_t num_keys) { return visitor.BeginMotions(num_keys); },
+			[this](auto& key) {
+				const auto name = Name(MotionNameSize);
+				ParseKey(key);
+				visitor.OnMotion(name, key);
+			});
+	}
+
+	bool ParseMorphs() {
+		return ParseSection<typename VmdTy::MorphKey>(MorphRecordSize,
+			[this](uint32_t num_keys) { return visitor.BeginMorphs(num_keys); },
+			[this](auto& key) {
+				const auto name = Name(MotionNameSize);
+				ParseKey(key);
+				visitor.OnMorph(name, key);
+			});
+	}
+
+	bool ParseCameras() {
+		return ParseSection<typename VmdTy::CameraKey>(CameraRecordSize,
+			[this](uint32_t num_keys) { return visitor.BeginCameras(num_keys); },
+			[this](auto& key) { ParseKey(key); visitor.OnCamera(key); });
+	}
 
-		auto& key = vmd.iks[name].emplace_back(typename VmdTy::IkKey{});
-		key.frame = frame;
-		key.enable = enable;
+	bool ParseLights() {
+		return ParseSection<typename VmdTy::LightKey>(LightRecordSize,
+			[this](uint32_t num_keys) { return visitor.BeginLights(num_keys); },
+			[this](auto& key) { ParseKey(key); visitor.OnLight(key); });
 	}
 
-	void LoadExKey() {
-		const auto frame = reader.Uint32();
-		const bool visibility = reader.Uint8();
+	bool ParseShadows() {
+		return ParseSection<typename VmdTy::ShadowKey>(ShadowRecordSize,
+			[this](uint32_t num_keys) { return visitor.BeginShadows(num_keys); },
+			[this](auto& key) { ParseKey(key); visitor.OnShadow(key); });
+	}
 
-		auto& visibility_key = vmd.visibilities.emplace_back(typename VmdTy::VisibilityKey{});
-		visibility_key.frame = frame;
-		visibility_key.visible = visibility;
+	bool ParseExKey(bool emit) {
+		typename VmdTy::VisibilityKey visibility_key{};
+		visibility_key.frame = reader.Uint32();
+		visibility_key.visible = reader.Uint8();
+		if (emit) {
+			visitor.OnVisibility(visibility_key);
+		}
 
 		const auto num_ik_keys = reader.Uint32();
+		if (!reader || reader.Remain() / (IkNameSize + 1) < num_ik_keys) {
+			return false;
+		}
+
+		if (!emit) {
+			return reader.Skip((IkNameSize + 1) * num_ik_keys);
+		}
+
 		for (uint32_t i = 0; i < num_ik_keys; ++i) {
-			LoadIkKey(frame);
+			const auto name = Name(IkNameSize);
+
+			typename VmdTy::IkKey ik_key{};
+			ik_key.frame = visibility_key.frame;
+			ik_key.enable = reader.Uint8();
+			visitor.OnIk(name, ik_key);
 		}
+
+		return static_cast<bool>(reader);
 	}
 
-	bool LoadExTrack() {
+	bool ParseExKeys() {
 		const auto num_keys = reader.Uint32();
+		if (!reader) {
+			return false;
+		}
+
+		const bool emit = visitor.BeginExKeys(num_keys);
 		for (uint32_t i = 0; i < num_keys; ++i) {
-			LoadExKey();
+			if (!ParseExKey(emit)) {
+				return false;
+			}
 		}
 
 		return static_cast<bool>(reader);
 	}
 
-	bool Load() {
+	bool Parse() {
 		if (!reader) {
 			return false;
 		}
 
-		if (!LoadHeader(vmd.header)) {
-			return false;
+		return ParseHeader() &&
+			ParseMotions() &&
+			ParseMorphs() &&
+			ParseCameras() &&
+			ParseLights() &&
+			ParseShadows() &&
+			ParseExKeys();
+	}
+};
+
+//
+// Load Vmd
+//
+// builds a Vmd from the stream
+template<typename Vec3, typename Vec4, typename Alloc = StdAlloc>
+struct VmdLoader : VmdVisitor<Vec3, Vec4> {
+	using VmdTy = Vmd<Vec3, Vec4, Alloc>;
+
+	// keys of a track are mostly stored back to back, so the last track found is kept to skip the map lookup
+	template<typename Key>
+	struct TrackCache {
+		using Tracks = typename VmdTy::template NamedTracks<Key>;
+
+		Tracks& tracks;
+		typename Tracks::iterator last;
+
+		explicit TrackCache(Tracks& tracks) :
+			tracks(tracks),
+			last(tracks.end()) {
 		}
 
-		if (!LoadNamedTracks(vmd.motions)) {
-			return false;
+		auto& operator[](std::string_view name) {
+			if (last == tracks.end() || last->first != name) {
+				last = tracks.try_emplace(typename Tracks::key_type(name, tracks.get_allocator())).first;
+			}
+			return last->second;
 		}
+	};
 
-		if (!LoadNamedTracks(vmd.morphs)) {
-			return false;
+	VmdTy& vmd;
+	const void* data;
+	std::size_t size;
+	TrackCache<typename VmdTy::MotionKey> motions;
+	TrackCache<typename VmdTy::MorphKey> morphs;
+	TrackCache<typename VmdTy::IkKey> iks;
+
+	VmdLoader(VmdTy& vmd, const void* data, std::size_t size) :
+		vmd(vmd),
+		data(data),
+		size(size),
+		motions(vmd.motions),
+		morphs(vmd.morphs),
+		iks(vmd.iks) {
+	}
+
+	void OnHeader(std::string_view name) {
+		vmd.header.name = name;
+	}
+
+	void OnMotion(std::string_view name, const typename VmdTy::MotionKey& key) {
+		motions[name].push_back(key);
+	}
+
+	void OnMorph(std::string_view name, const typename VmdTy::MorphKey& key) {
+		morphs[name].push_back(key);
+	}
+
+	bool BeginCameras(uint32_t num_keys) {
+		vmd.cameras.reserve(num_keys);
+		return true;
+	}
+
+	void OnCamera(const typename VmdTy::CameraKey& key) {
+		vmd.cameras.push_back(key);
+	}
+
+	bool BeginLights(uint32_t num_keys) {
+		vmd.lights.reserve(num_keys);
+		return true;
+	}
+
+	void OnLight(const typename VmdTy::LightKey& key) {
+		vmd.lights.push_back(key);
+	}
+
+	bool BeginShadows(uint32_t num_keys) {
+		vmd.shadows.reserve(num_keys);
+		return true;
+	}
+
+	void OnShadow(const typename VmdTy::ShadowKey& key) {
+		vmd.shadows.push_back(key);
+	}
+
+	bool BeginExKeys(uint32_t num_keys) {
+		vmd.visibilities.reserve(num_keys);
+		return true;
+	}
+
+	void OnVisibility(const typename VmdTy::VisibilityKey& key) {
+		vmd.visibilities.push_back(key);
+	}
+
+	void OnIk(std::string_view name, const typename VmdTy::IkKey& key) {
+		iks[name].push_back(key);
+	}
+
+	bool Load() {
+		return VmdParser<Vec3, Vec4, VmdLoader>(*this, data, size).Parse();
+	}
+};
+
+// builds a FlatVmd from the stream. keys are gathered in file order with their name ids,
+// then scattered into place by a counting sort over the ids.
+template<typename Vec3, typename Vec4>
+struct FlatVmdLoader : VmdVisitor<Vec3, Vec4> {
+	using VmdTy = FlatVmd<Vec3, Vec4>;
+
+	template<typename Key>
+	struct PendingKeys {
+		std::vector<Key>		keys;
+		std::vector<VmdNameId>	ids;
+
+		void Reserve(uint32_t num_keys) {
+			keys.reserve(num_keys);
+			ids.reserve(num_keys);
 		}
 
-		if (!LoadTrack(vmd.cameras)) {
-			return false;
+		void Add(VmdNameId id, const Key& key) {
+			ids.push_back(id);
+			keys.push_back(key);
 		}
+	};
 
-		if (!LoadTrack(vmd.lights)) {
-			return false;
+	VmdTy& vmd;
+	const void* data;
+	std::size_t size;
+	PendingKeys<typename VmdTy::MotionKey> motions;
+	PendingKeys<typename VmdTy::MorphKey> morphs;
+	PendingKeys<typename VmdTy::IkKey> iks;
+	VmdNameId last_id = NullVmdName;
+
+	FlatVmdLoader(VmdTy& vmd, const void* data, std::size_t size) :
+		vmd(vmd),
+		data(data),
+		size(size) {
+	}
+
+	// keys of a track are mostly stored back to back, so the last name is checked before hashing
+	VmdNameId Intern(std::string_view name) {
+		name = TrimVmdName(name);
+		if (last_id == NullVmdName || vmd.names.names[last_id] != name) {
+			last_id = vmd.names.Intern(name);
 		}
+		return last_id;
+	}
 
-		if (!LoadTrack(vmd.shadows)) {
-			return false;
+	void OnHeader(std::string_view name) {
+		vmd.header.name = name;
+	}
+
+	bool BeginMotions(uint32_t num_keys) {
+		motions.Reserve(num_keys);
+		return true;
+	}
+
+	void OnMotion(std::string_view name, const typename VmdTy::MotionKey& key) {
+		motions.Add(Intern(name), key);
+	}
+
+	bool BeginMorphs(uint32_t num_keys) {
+		morphs.Reserve(num_keys);
+		return true;
+	}
+
+	void OnMorph(std::string_view name, const typename VmdTy::MorphKey& key) {
+		morphs.Add(Intern(name), key);
+	}
+
+	bool BeginCameras(uint32_t num_keys) {
+		vmd.cameras.reserve(num_keys);
+		return true;
+	}
+
+	void OnCamera(const typename VmdTy::CameraKey& key) {
+		vmd.cameras.push_back(key);
+	}
+
+	bool BeginLights(uint32_t num_keys) {
+		vmd.lights.reserve(num_keys);
+		return true;
+	}
+
+	void OnLight(const typename VmdTy::LightKey& key) {
+		vmd.lights.push_back(key);
+	}
+
+	bool BeginShadows(uint32_t num_keys) {
+		vmd.shadows.reserve(num_keys);
+		return true;
+	}
+
+	void OnShadow(const typename VmdTy::ShadowKey& key) {
+		vmd.shadows.push_back(key);
+	}
+
+	bool BeginExKeys(uint32_t num_keys) {
+		vmd.visibilities.reserve(num_keys);
+		return true;
+	}
+
+	void OnVisibility(const typename VmdTy::VisibilityKey& key) {
+		vmd.visibilities.push_back(key);
+	}
+
+	void OnIk(std::string_view name, const typename VmdTy::IkKey& key) {
+		iks.Add(Intern(name), key);
+	}
+
+	template<typename Key>
+	void Sort(const PendingKeys<Key>& pending, FlatTracks<Key>& tracks) {
+		auto& ranges = tracks.ranges;
+		ranges.assign(vmd.names.Size(), {});
+		for (auto id : pending.ids) {
+			++ranges[id].end;
+		}
+
+		uint32_t offset = 0;
+		for (auto& range : ranges) {
+			range.begin = offset;
+			offset += range.end;
+			range.end = range.begin;
 		}
 
-		if (!LoadExTrack()) {
+		auto& keys = tracks.keys;
+		keys.resize(pending.keys.size());
+		for (std::size_t i = 0; i < pending.keys.size(); ++i) {
+			keys[ranges[pending.ids[i]].end++] = pending.keys[i];
+		}
+
+		// tracks are nearly always stored in frame order already
+		auto ByFrame = [](const Key& a, const Key& b) { return a.frame < b.frame; };
+		for (const auto& range : ranges) {
+			const auto first = keys.begin() + range.begin;
+			const auto last = keys.begin() + range.end;
+			if (!std::is_sorted(first, last, ByFrame)) {
+				std::stable_sort(first, last, ByFrame);
+			}
+		}
+	}
+
+	bool Load() {
+		if (!VmdParser<Vec3, Vec4, FlatVmdLoader>(*this, data, size).Parse()) {
 			return false;
 		}
 
-		return static_cast<bool>(reader);
+		Sort(motions, vmd.motions);
+		Sort(morphs, vmd.morphs);
+		Sort(iks, vmd.iks);
+		return true;
 	}
 };
 
 //
 // Serialize Vmd
 //
-template<typename Vec3, typename Vec4>
+// writes a Vmd or a FlatVmd
+template<typename Vec3, typename Vec4, typename VmdTy = Vmd<Vec3, Vec4>>
 struct VmdSerializer {
-	using VmdTy = Vmd<Vec3, Vec4>;
-
 	const VmdTy& vmd;
 	Writer writer;
 
-	VmdSerializer(const VmdTy& vmd, std::vector<char>& buf) :
+	VmdSerializer(const VmdTy& vmd, Sink& sink) :
 		vmd(vmd),
-		writer(buf) {
+		writer(sink) {
 	}
 
 	void SerializeHeader(const typename VmdTy::Header& header) {
@@ -2076,7 +4087,7 @@ struct VmdSerializer {
 		writer.ForVec4() << key.orientation;
 
 		char interp[64]{};
-		memcpy_s(interp, 64, key.interpolation, 64);
+		std::memcpy(interp, key.interpolation, 64);
 		interp[0 + 0] = key.ix.x1;	interp[0 + 4] = key.ix.y1;	interp[0 + 8] = key.ix.x2;	interp[0 + 12] = key.ix.y2;
 		interp[16 + 0] = key.iy.x1;	interp[16 + 4] = key.iy.y1;	interp[16 + 8] = key.iy.x2;	interp[16 + 12] = key.iy.y2;
 		interp[32 + 0] = key.iz.x1;	interp[32 + 4] = key.iz.y1;	interp[32 + 8] = key.iz.x2;	interp[32 + 12] = key.iz.y2;
@@ -2095,20 +4106,36 @@ struct VmdSerializer {
 		writer << key.value;
 	}
 
-	template<typename Key>
-	void SerializeNamedTracks(const std::map<std::string, std::vector<Key>>& tracks) {
-		uint32_t num_keys = 0;
+	template<typename Name, typename Keys, typename Compare, typename MapAlloc, typename Fn>
+	void ForEachTrack(const std::map<Name, Keys, Compare, MapAlloc>& tracks, Fn&& fn) const {
 		for (auto& [name, keys] : tracks) {
-			num_keys += static_cast<uint32_t>(keys.size());
+			fn(name, keys);
 		}
+	}
+
+	template<typename Key, typename Fn>
+	void ForEachTrack(const FlatTracks<Key>& tracks, Fn&& fn) const {
+		for (VmdNameId id = 0; id < tracks.ranges.size(); ++id) {
+			if (auto keys = tracks[id]; !keys.empty()) {
+				fn(vmd.names.names[id], keys);
+			}
+		}
+	}
+
+	template<typename Tracks>
+	void SerializeNamedTracks(const Tracks& tracks) {
+		uint32_t num_keys = 0;
+		ForEachTrack(tracks, [&num_keys](const auto&, const auto& keys) {
+			num_keys += static_cast<uint32_t>(keys.size());
+		});
 		writer << num_keys;
 
-		for (auto& [name, keys] : tracks) {
+		ForEachTrack(tracks, [this](const auto& name, const auto& keys) {
 			for (auto& key : keys) {
 				writer.ForFixed<15>() << name;
 				SerializeKey(key);
 			}
-		}
+		});
 	}
 
 	void SerializeKey(const typename VmdTy::CameraKey& key) {
@@ -2168,13 +4195,13 @@ struct VmdSerializer {
 			ex.visible = visibility.visible;
 		}
 
-		for (const auto& [name, keys] : vmd.iks) {
+		ForEachTrack(vmd.iks, [&ex_keys](const auto& name, const auto& keys) {
 			for (const auto& key : keys) {
 				auto& ex = ex_keys[key.frame];
 				ex.frame = key.frame;
-				ex.iks[name] = key.enable;
+				ex.iks[std::string(name.data(), name.size())] = key.enable;
 			}
-		}
+		});
 
 		writer << static_cast<uint32_t>(ex_keys.size());
 		for (auto& [frame, key] : ex_keys) {
@@ -2191,7 +4218,7 @@ struct VmdSerializer {
 		SerializeTrack(vmd.shadows);
 		SerializeExTrack();
 
-		return true;
+		return writer.Finish();
 	}
 };
 
@@ -2213,6 +4240,74 @@ inline std::vector<char> LoadBinary(const Path& path) {
 	return bin;
 }
 
+//
+// Mapped File
+//
+// read-only view of a whole file. the bytes are paged in on demand, so a loader can
+// parse them in place without copying the file into a buffer first.
+class MappedFile {
+public:
+	MappedFile() = default;
+
+	template<typename Path>
+	explicit MappedFile(const Path& path) {
+		Open(path);
+	}
+
+	~MappedFile() {
+		Close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept :
+		data_(std::exchange(other.data_, nullptr)),
+		size_(std::exchange(other.size_, 0)) {
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			Close();
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+
+	template<typename Path>
+	bool Open(const Path& path) {
+		Close();
+		return Map(std::filesystem::path(path));
+	}
+
+	void Close() noexcept {
+		if (data_) {
+			Unmap();
+		}
+	}
+
+	const char* Data() const noexcept {
+		return data_;
+	}
+
+	std::size_t Size() const noexcept {
+		return size_;
+	}
+
+	explicit operator bool() const noexcept {
+		return data_ != nullptr;
+	}
+
+private:
+	// the os calls live in portable_mmd_platform.cpp so this header pulls in no system headers
+	bool Map(const std::filesystem::path& path);
+	void Unmap() noexcept;
+
+	const char* data_ = nullptr;
+	std::size_t size_ = 0;
+};
+
 template<typename Path>
 inline bool SaveBinary(const Path& path, const std::vector<char>& bin) {
 	auto ofs = std::ofstream(path, std::ios::binary);
@@ -2226,62 +4321,258 @@ inline bool SaveBinary(const Path& path, const std::vector<char>& bin) {
 
 } // namespace io
 
-template<typename Vec2, typename Vec3, typename Vec4, typename Path>
-inline bool LoadPmx(const Path& path, Pmx<Vec2, Vec3, Vec4>& pmx) {
-	auto bin = io::LoadBinary(path);
-	return io::PmxLoader<Vec2, Vec3, Vec4>(pmx, bin.data(), bin.size()).Load();
+//
+// Lazy Pmx
+//
+// maps a pmx file and indexes its sections up front, then decodes each section on first request.
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc = StdAlloc>
+class LazyPmx {
+public:
+	using PmxTy = Pmx<Vec2, Vec3, Vec4, Alloc>;
+	using allocator_type = typename PmxTy::allocator_type;
+
+	LazyPmx() = default;
+
+	explicit LazyPmx(const allocator_type& alloc) :
+		pmx_(alloc) {
+	}
+
+	template<typename Path>
+	bool Open(const Path& path) {
+		pmx_ = PmxTy(pmx_.get_allocator());
+		index_ = {};
+		std::fill(std::begin(loaded_), std::end(loaded_), false);
+
+		if (!file_.Open(path)) {
+			return false;
+		}
+
+		io::PmxLoader<Vec2, Vec3, Vec4, Alloc> loader(pmx_, file_.Data(), file_.Size());
+		if (!loader.LoadHeader(pmx_.header)) {
+			return false;
+		}
+
+		return loader.BuildIndex(index_);
+	}
+
+	bool Load(PmxSection section) {
+		auto& loaded = loaded_[static_cast<std::size_t>(section)];
+		if (loaded) {
+			return true;
+		}
+
+		auto loader = MakeLoader();
+		if (!loader.Seek(index_.Begin(section)) || !loader.LoadSection(section)) {
+			return false;
+		}
+
+		loaded = true;
+		return true;
+	}
+
+	// decodes the given sections that are not loaded yet concurrently. 0 threads means one per hardware thread.
+	bool Load(std::span<const PmxSection> sections, unsigned num_threads = 0) {
+		if (num_threads == 0) {
+			num_threads = io::DefaultThreadCount();
+		}
+		if (num_threads == 1) {
+			for (auto section : sections) {
+				if (!Load(section)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		std::vector<PmxSection> pending{};
+		for (auto section : sections) {
+			if (!IsLoaded(section)) {
+				pending.push_back(section);
+			}
+		}
+
+		auto loader = MakeLoader();
+		if (!loader.LoadSections(index_, pending, num_threads)) {
+			return false;
+		}
+
+		for (auto section : pending) {
+			loaded_[static_cast<std::size_t>(section)] = true;
+		}
+		return true;
+	}
+
+	bool LoadAll(unsigned num_threads = 0) {
+		return Load(PmxSections, num_threads);
+	}
+
+	// decodes the vertices straight into dest instead of Get().vertices. see PmxLoader::LoadVerticesInto.
+	template<typename Vertices>
+	bool LoadVertices(Vertices& dest, unsigned num_threads = 0) {
+		auto loader = MakeLoader();
+		return loader.Seek(index_.Begin(PmxSection::Vertices)) && loader.LoadVerticesInto(dest, num_threads);
+	}
+
+	// decodes the vertex morph offsets straight into dest(i). see PmxLoader::LoadVertexMorphDataInto.
+	template<typename Dest>
+	bool LoadVertexMorphData(Dest&& dest) {
+		auto loader = MakeLoader();
+		return loader.Seek(index_.Begin(PmxSection::Morphs)) && loader.LoadVertexMorphDataInto(dest);
+	}
+
+	// false leaves VertexMorph::data empty in the morph sections loaded from now on, for callers of LoadVertexMorphData
+	void KeepVertexMorphData(bool keep) {
+		vertex_morph_data_ = keep;
+	}
+
+	bool IsLoaded(PmxSection section) const {
+		return loaded_[static_cast<std::size_t>(section)];
+	}
+
+	const PmxSectionIndex& GetIndex() const {
+		return index_;
+	}
+
+	const PmxTy& Get() const {
+		return pmx_;
+	}
+
+private:
+	io::MappedFile file_{};
+	PmxTy pmx_{};
+	PmxSectionIndex index_{};
+	bool loaded_[static_cast<std::size_t>(PmxSection::Num)]{};
+	bool vertex_morph_data_ = true;
+
+	io::PmxLoader<Vec2, Vec3, Vec4, Alloc> MakeLoader() {
+		io::PmxLoader<Vec2, Vec3, Vec4, Alloc> loader(pmx_, file_.Data(), file_.Size());
+		loader.vertex_morph_data = vertex_morph_data_;
+		return loader;
+	}
+};
+
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc, typename Path>
+inline bool LoadPmx(const Path& path, Pmx<Vec2, Vec3, Vec4, Alloc>& pmx) {
+	auto file = io::MappedFile(path);
+	return io::PmxLoader<Vec2, Vec3, Vec4, Alloc>(pmx, file.Data(), file.Size()).Load();
 }
 
-template<typename Vec2, typename Vec3, typename Vec4>
-inline bool LoadPmx(const void* data, std::size_t size, Pmx<Vec2, Vec3, Vec4>& pmx) {
-	return io::PmxLoader<Vec2, Vec3, Vec4>(pmx, data, size).Load();
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc>
+inline bool LoadPmx(const void* data, std::size_t size, Pmx<Vec2, Vec3, Vec4, Alloc>& pmx) {
+	return io::PmxLoader<Vec2, Vec3, Vec4, Alloc>(pmx, data, size).Load();
 }
 
-template<typename Vec2, typename Vec3, typename Vec4, typename Path>
-inline bool SavePmx(const Path& path, const Pmx<Vec2, Vec3, Vec4>& pmx) {
-	std::vector<char> buf{};
-	buf.reserve(41 * pmx.vertices.size() + 4 * pmx.indices.size() + 90 * pmx.materials.size() + 30 * pmx.bones.size());
+// same result as LoadPmx, with the sections decoded on up to num_threads threads. 0 means one per hardware thread.
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc, typename Path>
+inline bool LoadPmxParallel(const Path& path, Pmx<Vec2, Vec3, Vec4, Alloc>& pmx, unsigned num_threads = 0) {
+	auto file = io::MappedFile(path);
+	return io::PmxLoader<Vec2, Vec3, Vec4, Alloc>(pmx, file.Data(), file.Size()).LoadParallel(num_threads);
+}
 
-	if (!io::PmxSerializer<Vec2, Vec3, Vec4>(pmx, buf).Serialize()) {
-		return false;
-	}
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc>
+inline bool LoadPmxParallel(const void* data, std::size_t size, Pmx<Vec2, Vec3, Vec4, Alloc>& pmx, unsigned num_threads = 0) {
+	return io::PmxLoader<Vec2, Vec3, Vec4, Alloc>(pmx, data, size).LoadParallel(num_threads);
+}
 
-	return io::SaveBinary(path, buf);
+// streams to the file through a chunk-sized buffer
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc, typename Path> requires (!std::is_base_of_v<io::Sink, Path>)
+inline bool SavePmx(const Path& path, const Pmx<Vec2, Vec3, Vec4, Alloc>& pmx, std::size_t chunk_size = io::FileSink::DefaultChunkSize, bool background = false) {
+	io::FileSink sink(path, chunk_size, background);
+	return sink && SavePmx(sink, pmx);
 }
 
-template<typename Vec2, typename Vec3, typename Vec4>
-inline bool SavePmx(std::vector<char>& out, const Pmx<Vec2, Vec3, Vec4>& pmx) {
-	out.reserve(41 * pmx.vertices.size() + 4 * pmx.indices.size() + 90 * pmx.materials.size() + 30 * pmx.bones.size());
-	return io::PmxSerializer<Vec2, Vec3, Vec4>(pmx, out).Serialize();
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc>
+inline bool SavePmx(io::Sink& sink, const Pmx<Vec2, Vec3, Vec4, Alloc>& pmx) {
+	return io::PmxSerializer<Vec2, Vec3, Vec4, Alloc>(pmx, sink).Serialize();
+}
+
+// appends to out, which is grown once to the exact size counted by a first pass
+template<typename Vec2, typename Vec3, typename Vec4, typename Alloc>
+inline bool SavePmx(std::vector<char>& out, const Pmx<Vec2, Vec3, Vec4, Alloc>& pmx) {
+	io::CountingSink counter{};
+	SavePmx(counter, pmx);
+	out.reserve(out.size() + counter.Size());
+
+	io::VectorSink sink(out);
+	return SavePmx(sink, pmx);
+}
+
+template<typename Vec3, typename Vec4, typename Alloc, typename Path>
+inline bool LoadVmd(const Path& path, Vmd<Vec3, Vec4, Alloc>& vmd) {
+	auto file = io::MappedFile(path);
+	return io::VmdLoader<Vec3, Vec4, Alloc>(vmd, file.Data(), file.Size()).Load();
+}
+
+template<typename Vec3, typename Vec4, typename Alloc>
+inline bool LoadVmd(const void* data, std::size_t size, Vmd<Vec3, Vec4, Alloc>& vmd) {
+	return io::VmdLoader<Vec3, Vec4, Alloc>(vmd, data, size).Load();
 }
 
 template<typename Vec3, typename Vec4, typename Path>
-inline bool LoadVmd(const Path& path, Vmd<Vec3, Vec4>& vmd) {
-	auto bin = io::LoadBinary(path);
-	return io::VmdLoader<Vec3, Vec4>(vmd, bin.data(), bin.size()).Load();
+inline bool LoadVmd(const Path& path, FlatVmd<Vec3, Vec4>& vmd) {
+	auto file = io::MappedFile(path);
+	return io::FlatVmdLoader<Vec3, Vec4>(vmd, file.Data(), file.Size()).Load();
 }
 
 template<typename Vec3, typename Vec4>
-inline bool LoadVmd(const void* data, std::size_t size, Vmd<Vec3, Vec4>& vmd) {
-	return io::VmdLoader<Vec3, Vec4>(vmd, data, size).Load();
+inline bool LoadVmd(const void* data, std::size_t size, FlatVmd<Vec3, Vec4>& vmd) {
+	return io::FlatVmdLoader<Vec3, Vec4>(vmd, data, size).Load();
 }
 
-template<typename Vec3, typename Vec4, typename Path>
-inline bool SaveVmd(const Path& path, const Vmd<Vec3, Vec4>& vmd) {
-	std::vector<char> buf{};
-	buf.reserve(111 * vmd.motions.size() + 23 * vmd.morphs.size() + 105 * vmd.cameras.size());
+// streams the keys to the visitor instead of building a Vmd
+template<typename Vec3, typename Vec4, typename Visitor, typename Path>
+inline bool ParseVmd(const Path& path, Visitor& visitor) {
+	auto file = io::MappedFile(path);
+	return io::VmdParser<Vec3, Vec4, Visitor>(visitor, file.Data(), file.Size()).Parse();
+}
 
-	if (!io::VmdSerializer<Vec3, Vec4>(vmd, buf).Serialize()) {
-		return false;
-	}
+template<typename Vec3, typename Vec4, typename Visitor>
+inline bool ParseVmd(const void* data, std::size_t size, Visitor& visitor) {
+	return io::VmdParser<Vec3, Vec4, Visitor>(visitor, data, size).Parse();
+}
 
-	return io::SaveBinary(path, buf);
+// streams to the file through a chunk-sized buffer
+template<typename Vec3, typename Vec4, typename Alloc, typename Path> requires (!std::is_base_of_v<io::Sink, Path>)
+inline bool SaveVmd(const Path& path, const Vmd<Vec3, Vec4, Alloc>& vmd, std::size_t chunk_size = io::FileSink::DefaultChunkSize, bool background = false) {
+	io::FileSink sink(path, chunk_size, background);
+	return sink && SaveVmd(sink, vmd);
+}
+
+template<typename Vec3, typename Vec4, typename Alloc>
+inline bool SaveVmd(io::Sink& sink, const Vmd<Vec3, Vec4, Alloc>& vmd) {
+	return io::VmdSerializer<Vec3, Vec4, Vmd<Vec3, Vec4, Alloc>>(vmd, sink).Serialize();
+}
+
+// appends to out, which is grown once to the exact size counted by a first pass
+template<typename Vec3, typename Vec4, typename Alloc>
+inline bool SaveVmd(std::vector<char>& out, const Vmd<Vec3, Vec4, Alloc>& vmd) {
+	io::CountingSink counter{};
+	SaveVmd(counter, vmd);
+	out.reserve(out.size() + counter.Size());
+
+	io::VectorSink sink(out);
+	return SaveVmd(sink, vmd);
+}
+
+template<typename Vec3, typename Vec4, typename Path> requires (!std::is_base_of_v<io::Sink, Path>)
+inline bool SaveVmd(const Path& path, const FlatVmd<Vec3, Vec4>& vmd, std::size_t chunk_size = io::FileSink::DefaultChunkSize, bool background = false) {
+	io::FileSink sink(path, chunk_size, background);
+	return sink && SaveVmd(sink, vmd);
 }
 
 template<typename Vec3, typename Vec4>
-inline bool SaveVmd(std::vector<char>& out, const Vmd<Vec3, Vec4>& vmd) {
-	out.reserve(111 * vmd.motions.size() + 23 * vmd.morphs.size() + 105 * vmd.cameras.size());
-	return io::VmdSerializer<Vec3, Vec4>(vmd, out).Serialize();
+inline bool SaveVmd(io::Sink& sink, const FlatVmd<Vec3, Vec4>& vmd) {
+	return io::VmdSerializer<Vec3, Vec4, FlatVmd<Vec3, Vec4>>(vmd, sink).Serialize();
+}
+
+template<typename Vec3, typename Vec4>
+inline bool SaveVmd(std::vector<char>& out, const FlatVmd<Vec3, Vec4>& vmd) {
+	io::CountingSink counter{};
+	SaveVmd(counter, vmd);
+	out.reserve(out.size() + counter.Size());
+
+	io::VectorSink sink(out);
+	return SaveVmd(sink, vmd);
 }
 
 } // namspace portable_mmd
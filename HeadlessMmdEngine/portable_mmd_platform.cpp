@@ -0,0 +1,107 @@
+// platform part of portable_mmd.h. built without the precompiled header so the
+// system headers and their macros stay inside this translation unit.
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "portable_mmd.h"
+
+namespace portable_mmd::io {
+
+#if defined(_WIN32)
+namespace {
+
+// PrefetchVirtualMemory is windows 8 and later, so look it up instead of linking it
+using PrefetchVirtualMemoryFn = BOOL(WINAPI*)(HANDLE, ULONG_PTR, PWIN32_MEMORY_RANGE_ENTRY, ULONG);
+
+PrefetchVirtualMemoryFn GetPrefetchVirtualMemory() {
+	static const auto fn = [] {
+		auto kernel32 = GetModuleHandleW(L"kernel32.dll");
+		return kernel32 ? reinterpret_cast<PrefetchVirtualMemoryFn>(GetProcAddress(kernel32, "PrefetchVirtualMemory")) : nullptr;
+	}();
+	return fn;
+}
+
+}
+#endif
+
+bool MappedFile::Map(const std::filesystem::path& path) {
+#if defined(_WIN32)
+	auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) { // empty file can not be mapped
+		CloseHandle(file);
+		return false;
+	}
+
+	auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) {
+		return false;
+	}
+
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping); // view keeps the mapping alive
+	if (!view) {
+		return false;
+	}
+
+	data_ = static_cast<const char*>(view);
+	size_ = static_cast<std::size_t>(file_size.QuadPart);
+
+	// loaders read front to back, so start paging in the whole range now
+	if (auto prefetch = GetPrefetchVirtualMemory()) {
+		WIN32_MEMORY_RANGE_ENTRY range{ view, size_ };
+		prefetch(GetCurrentProcess(), 1, &range, 0);
+	}
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st {};
+	if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		return false;
+	}
+
+	const auto file_size = static_cast<std::size_t>(st.st_size);
+	::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	auto view = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // mapping keeps the file alive
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	::madvise(view, file_size, MADV_SEQUENTIAL);
+	::madvise(view, file_size, MADV_WILLNEED);
+
+	data_ = static_cast<const char*>(view);
+	size_ = file_size;
+#endif
+	return true;
+}
+
+void MappedFile::Unmap() noexcept {
+#if defined(_WIN32)
+	UnmapViewOfFile(data_);
+#else
+	::munmap(const_cast<char*>(data_), size_);
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <format>
+#include "cp932.h"
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <Windows.h>
@@ -33,34 +34,39 @@ inline std::basic_string<To> WcsToMbs(const From* wcs, UINT code = CP_ACP) {
 	return str;
 }
 
+// cp932 conversions go through the table-driven transcoder instead of MultiByteToWideChar / WideCharToMultiByte
 template<typename To = char> // char or char8_t
 inline std::basic_string<To> SjisToUtf8(const char* sjis) {
-	auto utf16 = MbsToWcs(sjis, 932);	// SJI CP932
-	return WcsToMbs<To>(utf16.c_str(), CP_UTF8);
+	return cp932::ToUtf8<To>(sjis);
 }
 
 template<typename To = char>
 inline std::basic_string<To> SjisToUtf8(const std::string& sjis) {
-	return SjisToUtf8<To>(sjis.c_str());
+	return cp932::ToUtf8<To>(sjis);
 }
 
 inline std::wstring SjisToUtf16(const char* sjis) {
-	return MbsToWcs(sjis, 932);
+	return cp932::ToUtf16(sjis);
 }
 
 inline std::wstring SjisToUtf16(const std::string& sjis) {
-	return SjisToUtf16(sjis.c_str());
+	return cp932::ToUtf16(sjis);
 }
 
 template<typename To = char, typename From = char>
 inline std::basic_string<To> Utf8ToSjis(const From* utf8) {
-	auto utf16 = MbsToWcs(utf8, CP_UTF8);
-	return WcsToMbs<To>(utf16.c_str(), 932);
+	static_assert(sizeof(To) == sizeof(char));
+
+	auto sjis = cp932::FromUtf8(std::basic_string_view<From>(utf8));
+	return std::basic_string<To>(sjis.begin(), sjis.end());
 }
 
 template<typename To = char, typename From = char>
 inline std::basic_string<To> Utf8ToSjis(const std::basic_string<From>& utf8) {
-	return Utf8ToSjis<To>(utf8.c_str());
+	static_assert(sizeof(To) == sizeof(char));
+
+	auto sjis = cp932::FromUtf8(std::basic_string_view<From>(utf8));
+	return std::basic_string<To>(sjis.begin(), sjis.end());
 }
 
 template<typename From = char>
@@ -74,11 +80,11 @@ inline std::wstring Utf8ToUtf16(const std::basic_string<From>& utf8) {
 }
 
 inline std::string Utf16ToSjis(const wchar_t* utf16) {
-	return WcsToMbs(utf16, 932);
+	return cp932::FromUtf16(std::wstring_view(utf16));
 }
 
 inline std::string Utf16ToSjis(const std::wstring& utf16) {
-	return Utf16ToSjis(utf16.c_str());
+	return cp932::FromUtf16(utf16);
 }
 
 template<typename To = char>
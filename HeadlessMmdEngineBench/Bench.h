@@ -0,0 +1,117 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "..\HeadlessMmdEngine\Common.h"
+
+// checks and measurements of the engine that need neither a window nor assets on disk.
+// each case registers itself, main runs the ones named on the command line or all of them.
+namespace bench {
+
+struct Failure : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+using CaseFunc = void(*)();
+
+struct Case {
+	const char*	name;
+	CaseFunc	func;
+};
+
+inline std::vector<Case>& GetCases() {
+	static std::vector<Case> cases{};
+	return cases;
+}
+
+struct Register {
+	Register(const char* name, CaseFunc func) {
+		GetCases().push_back({ name, func });
+	}
+};
+
+// a failed check ends its case
+template<typename... Args>
+inline void Expect(bool condition, std::format_string<Args...> fmt, Args&&... args) {
+	if (!condition) {
+		throw Failure(std::format(fmt, std::forward<Args>(args)...));
+	}
+}
+
+template<typename... Args>
+inline void Report(std::format_string<Args...> fmt, Args&&... args) {
+	std::printf("    %s\n", std::format(fmt, std::forward<Args>(args)...).c_str());
+}
+
+// nanoseconds per call of func, the best of a few rounds so that a preempted round does not count
+template<typename Func>
+inline double Measure(int calls, Func&& func, int rounds = 5) {
+	double best = std::numeric_limits<double>::max();
+	for (int r = 0; r < rounds; ++r) {
+		const auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < calls; ++i) {
+			func(i);
+		}
+		const auto t1 = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count() / calls);
+	}
+	return best;
+}
+
+// y of a vmd curve at x, solved in double by bisection. the reference the engine's curves are checked against.
+inline double SolveBezier(int x1, int x2, int y1, int y2, double x) {
+	auto Point = [](int p) { return static_cast<double>(std::clamp(p, 0, 127)) / 127.; };
+	auto Bezier = [](double t, double p1, double p2) { return 3. * p1 * t * (1. - t) * (1. - t) + 3. * p2 * t * t * (1. - t) + t * t * t; };
+
+	double lo = 0.;
+	double hi = 1.;
+	for (int k = 0; k < 60; ++k) {
+		const double mid = 0.5 * (lo + hi);
+		(Bezier(mid, Point(x1), Point(x2)) < x ? lo : hi) = mid;
+	}
+	return Bezier(0.5 * (lo + hi), Point(y1), Point(y2));
+}
+
+// a bone of a skeleton built in code, the rest of its fields left as a plain pmx bone has them
+struct BoneDesc {
+	const wchar_t*			name;
+	int						parent;
+	headless_mmd::Vector	position;
+	int						append = -1;	// the bone whose rotation it takes a share of
+	float					append_rate = 0.f;
+};
+
+inline headless_mmd::Pmx MakePmx(std::span<const BoneDesc> bones) {
+	headless_mmd::Pmx pmx{};
+	pmx.bones.resize(bones.size());
+	for (std::size_t i = 0; i < bones.size(); ++i) {
+		auto& bone = pmx.bones[i];
+		bone = {};
+		bone.name = bones[i].name;
+		bone.position = bones[i].position;
+		bone.parent_bone_index = bones[i].parent;
+		bone.drive_bone_index = bones[i].append;
+		bone.driven_rotation = bones[i].append >= 0;
+		bone.drive_rate = bones[i].append_rate;
+		bone.ik_target_bone_index = -1;
+	}
+	return pmx;
+}
+
+// the largest difference between the elements of two transforms
+inline float MaxDifference(const headless_mmd::Matrix& a, const headless_mmd::Matrix& b) {
+	float diff = 0.f;
+	for (int r = 0; r < 4; ++r) {
+		const auto d = DirectX::XMVectorAbs(DirectX::XMVectorSubtract(a.r[r], b.r[r]));
+		diff = std::max({ diff, DirectX::XMVectorGetX(d), DirectX::XMVectorGetY(d), DirectX::XMVectorGetZ(d), DirectX::XMVectorGetW(d) });
+	}
+	return diff;
+}
+
+}
@@ -0,0 +1,103 @@
+#include "pch.h"
+#include "..\HeadlessMmdEngine\cp932.h"
+
+namespace {
+
+struct Name {
+	const char*		sjis;
+	const wchar_t*	utf16;
+};
+
+// bone and morph names as a pmx or vmd stores them
+const Name Names[] = {
+	{ "\x83\x5A\x83\x93\x83\x5E\x81\x5B", L"\u30BB\u30F3\u30BF\u30FC" },
+	{ "\x8F\xE3\x94\xBC\x90\x67\x32", L"\u4E0A\u534A\u8EAB2" },
+	{ "\x8D\xB6\x98\x72", L"\u5DE6\u8155" },
+	{ "\x89\x45\x91\xAB\x82\x68\x82\x6A", L"\u53F3\u8DB3\uFF29\uFF2B" },
+	{ "\x82\xDC\x82\xCE\x82\xBD\x82\xAB", L"\u307E\u3070\u305F\u304D" },
+	{ "\xB3\xA8\xDD\xB8", L"\uFF73\uFF68\uFF9D\uFF78" },
+	{ "left_arm_twist", L"left_arm_twist" },
+};
+
+#if defined(_WIN32)
+std::wstring SystemToUtf16(std::string_view sjis) {
+	std::wstring out(sjis.size(), L'\0');
+	out.resize(MultiByteToWideChar(932, 0, sjis.data(), static_cast<int>(sjis.size()), out.data(), static_cast<int>(out.size())));
+	return out;
+}
+
+std::string SystemFromUtf16(std::wstring_view utf16) {
+	std::string out(utf16.size() * 2, '\0');
+	out.resize(WideCharToMultiByte(932, WC_NO_BEST_FIT_CHARS, utf16.data(), static_cast<int>(utf16.size()), out.data(), static_cast<int>(out.size()), nullptr, nullptr));
+	return out;
+}
+#endif
+
+// every single and double byte code decodes, and every utf-16 code unit encodes, as code page 932 does
+void Cp932Tables() {
+	for (std::size_t i = 0; i < std::size(Names); ++i) {
+		const auto utf16 = cp932::ToUtf16(Names[i].sjis);
+		bench::Expect(utf16 == Names[i].utf16, "name {} does not decode", i);
+		bench::Expect(cp932::FromUtf16(utf16) == Names[i].sjis, "name {} does not encode back", i);
+	}
+
+#if defined(_WIN32)
+	int num_codes = 0;
+	for (unsigned c = 0; c < 0x100; ++c) {
+		if (cp932::detail::IsLead(static_cast<uint8_t>(c))) {
+			for (unsigned trail = 0x40; trail <= 0xFC; ++trail) {
+				if (!cp932::detail::IsTrail(static_cast<uint8_t>(trail))) {
+					continue;
+				}
+				const char code[] = { static_cast<char>(c), static_cast<char>(trail) };
+				bench::Expect(cp932::ToUtf16(std::string_view(code, 2)) == SystemToUtf16(std::string_view(code, 2)), "{:02X}{:02X} decodes differently", c, trail);
+				++num_codes;
+			}
+		}
+		else {
+			const char code[] = { static_cast<char>(c) };
+			bench::Expect(cp932::ToUtf16(std::string_view(code, 1)) == SystemToUtf16(std::string_view(code, 1)), "{:02X} decodes differently", c);
+			++num_codes;
+		}
+	}
+
+	int num_units = 0;
+	for (unsigned u = 1; u < 0x10000; ++u) {
+		if (0xD800 <= u && u <= 0xDFFF) {
+			continue;
+		}
+		const wchar_t unit[] = { static_cast<wchar_t>(u) };
+		bench::Expect(cp932::FromUtf16(std::wstring_view(unit, 1)) == SystemFromUtf16(std::wstring_view(unit, 1)), "U+{:04X} encodes differently", u);
+		++num_units;
+	}
+	bench::Report("{} codes decode and {} code units encode as MultiByteToWideChar(932) and WideCharToMultiByte(932) do", num_codes, num_units);
+#endif
+}
+
+// a name table the size of a large model's, converted name by name
+void Cp932Speed() {
+	constexpr int NumNames = 4000;
+
+	std::vector<std::string> sjis(NumNames);
+	std::vector<std::wstring> utf16(NumNames);
+	for (int i = 0; i < NumNames; ++i) {
+		const auto& name = Names[i % std::size(Names)];
+		sjis[i] = name.sjis + std::to_string(i);
+		utf16[i] = name.utf16 + std::to_wstring(i);
+	}
+
+	volatile std::size_t sink = 0;
+	bench::Report("{} names", NumNames);
+	bench::Report("cp932 decode:  {:6.1f} ns per name", bench::Measure(NumNames, [&](int i) { sink = cp932::ToUtf16(sjis[i]).size(); }));
+	bench::Report("cp932 encode:  {:6.1f} ns per name", bench::Measure(NumNames, [&](int i) { sink = cp932::FromUtf16(utf16[i]).size(); }));
+	bench::Report("cp932 table:   {:6.1f} ns per name", bench::Measure(1, [&](int) { sink = cp932::NameTable<wchar_t>(sjis).Size(); }) / NumNames);
+#if defined(_WIN32)
+	bench::Report("system decode: {:6.1f} ns per name", bench::Measure(NumNames, [&](int i) { sink = SystemToUtf16(sjis[i]).size(); }));
+	bench::Report("system encode: {:6.1f} ns per name", bench::Measure(NumNames, [&](int i) { sink = SystemFromUtf16(utf16[i]).size(); }));
+#endif
+}
+
+const bench::Register cp932_tables("cp932_tables", Cp932Tables);
+const bench::Register cp932_speed("cp932_speed", Cp932Speed);
+
+}
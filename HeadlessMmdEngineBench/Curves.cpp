@@ -0,0 +1,151 @@
+#include "pch.h"
+
+namespace {
+
+using portable_mmd::BezierCurve;
+using portable_mmd::Interpolation;
+
+// control points on a grid of step, plus the curves with vertical tangents at either end
+std::vector<Interpolation> MakeCurves(int step) {
+	std::vector<Interpolation> curves{};
+	for (int x1 = 0; x1 <= 127; x1 += step) {
+		for (int x2 = 0; x2 <= 127; x2 += step) {
+			for (int y1 = 0; y1 <= 127; y1 += step) {
+				for (int y2 = 0; y2 <= 127; y2 += step) {
+					curves.push_back({ static_cast<int8_t>(x1), static_cast<int8_t>(x2), static_cast<int8_t>(y1), static_cast<int8_t>(y2) });
+				}
+			}
+		}
+	}
+	curves.push_back({ 0, 127, 127, 0 });
+	curves.push_back({ 127, 0, 0, 127 });
+	curves.push_back({ 0, 0, 127, 127 });
+	curves.push_back({ 127, 127, 0, 0 });
+	return curves;
+}
+
+// the tabulated curve against a solve in double, and against the eight newton steps it replaced
+void BezierAccuracy() {
+	constexpr int NumSamples = 64;
+	const auto curves = MakeCurves(9);
+
+	double worst = 0.;
+	double worst_newton = 0.;
+	double total = 0.;
+	Interpolation worst_curve{};
+	for (const auto& interp : curves) {
+		const BezierCurve curve(interp);
+		for (int i = 0; i <= NumSamples; ++i) {
+			// off the table's own grid, so that the refinement is what gets measured
+			const float x = std::min((static_cast<float>(i) + 0.37f) / NumSamples, 1.f);
+			const double expected = bench::SolveBezier(interp.x1, interp.x2, interp.y1, interp.y2, x);
+
+			const double error = std::abs(curve(x) - expected);
+			total += error;
+			if (error > worst) {
+				worst = error;
+				worst_curve = interp;
+			}
+			worst_newton = std::max(worst_newton, std::abs(portable_mmd::BezierInterp(x, interp) - expected));
+		}
+	}
+
+	bench::Report("{} curves, {} samples each", curves.size(), NumSamples + 1);
+	bench::Report("BezierCurve:  worst {:.3g} on ({}, {}, {}, {}), average {:.3g}", worst,
+		worst_curve.x1, worst_curve.x2, worst_curve.y1, worst_curve.y2, total / (curves.size() * (NumSamples + 1.)));
+	bench::Report("BezierInterp: worst {:.3g}", worst_newton);
+	bench::Expect(worst < 1e-4, "BezierCurve is off by {}", worst);
+}
+
+void BezierSpeed() {
+	constexpr int NumCurves = 256;
+	constexpr int NumSamples = 4096;
+
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<int> point(0, 127);
+	std::uniform_real_distribution<float> frame(0.f, 1.f);
+
+	std::vector<Interpolation> interps(NumCurves);
+	for (auto& interp : interps) {
+		interp = { static_cast<int8_t>(point(rng)), static_cast<int8_t>(point(rng)), static_cast<int8_t>(point(rng)), static_cast<int8_t>(point(rng)) };
+	}
+	const std::vector<BezierCurve> curves(interps.begin(), interps.end());
+
+	std::vector<float> xs(NumSamples);
+	for (auto& x : xs) {
+		x = frame(rng);
+	}
+
+	volatile float sink = 0.f;
+	const auto cached = bench::Measure(NumSamples, [&](int i) { sink = curves[i % NumCurves](xs[i]); }, 20);
+	const auto newton = bench::Measure(NumSamples, [&](int i) { sink = portable_mmd::BezierInterp(xs[i], interps[i % NumCurves]); }, 20);
+	bench::Report("BezierCurve:  {:6.1f} ns per call", cached);
+	bench::Report("BezierInterp: {:6.1f} ns per call", newton);
+}
+
+// the batch against a solve in double and against the scalar curve it vectorizes, on lanes that mix
+// every curve of the grid, the vertical tangents among them, and a count that leaves a scalar tail
+void BezierBatch() {
+	constexpr int NumSamples = 17;
+	const auto interps = MakeCurves(9);
+	const std::vector<BezierCurve> curves(interps.begin(), interps.end());
+
+	std::vector<const BezierCurve*> lanes{};
+	std::vector<float> xs{};
+	for (int i = 0; i <= NumSamples; ++i) {
+		for (const auto& curve : curves) {
+			lanes.push_back(&curve);
+			xs.push_back(std::min((static_cast<float>(i) + 0.37f) / NumSamples, 1.f));
+		}
+	}
+	lanes.push_back(&curves.back());
+	xs.push_back(1.5f);
+
+	std::vector<float> ys(lanes.size());
+	BezierCurve::Evaluate(lanes, xs, ys);
+
+	double worst = 0.;
+	float worst_scalar = 0.f;
+	for (std::size_t i = 0; i < lanes.size(); ++i) {
+		const auto& interp = lanes[i]->GetInterpolation();
+		worst = std::max(worst, std::abs(ys[i] - bench::SolveBezier(interp.x1, interp.x2, interp.y1, interp.y2, std::min(xs[i], 1.f))));
+		worst_scalar = std::max(worst_scalar, std::abs(ys[i] - (*lanes[i])(xs[i])));
+	}
+	bench::Report("{} lanes, {} wide", lanes.size(), portable_mmd::simd::F32::Width);
+	bench::Report("worst {:.3g} from the exact solve, {:.3g} from BezierCurve", worst, worst_scalar);
+	bench::Expect(worst < 1e-4, "the batch is off by {}", worst);
+	bench::Expect(worst_scalar < 1e-6f, "the batch is {} from the scalar curve", worst_scalar);
+
+	// the x, y, z and rotation curves of 500 bones, as EvaluateMotion hands them over
+	constexpr int NumLanes = 2000;
+	std::mt19937 rng(12);
+	std::uniform_int_distribution<std::size_t> pick(0, curves.size() - 1);
+	std::uniform_real_distribution<float> frame(0.f, 1.f);
+	std::vector<const BezierCurve*> bones(NumLanes);
+	std::vector<float> ss(NumLanes);
+	for (int i = 0; i < NumLanes; ++i) {
+		bones[i] = &curves[pick(rng)];
+		ss[i] = frame(rng);
+	}
+
+	std::vector<float> out(NumLanes);
+	volatile float sink = 0.f;
+	const auto scalar = bench::Measure(1, [&](int) {
+		for (int i = 0; i < NumLanes; ++i) {
+			out[i] = (*bones[i])(ss[i]);
+		}
+		sink = out[0];
+	}, 20);
+	const auto batch = bench::Measure(1, [&](int) {
+		BezierCurve::Evaluate(bones, ss, out);
+		sink = out[0];
+	}, 20);
+	bench::Report("BezierCurve:           {:6.1f} ns per curve", scalar / NumLanes);
+	bench::Report("BezierCurve::Evaluate: {:6.1f} ns per curve", batch / NumLanes);
+}
+
+const bench::Register bezier_accuracy("bezier_accuracy", BezierAccuracy);
+const bench::Register bezier_speed("bezier_speed", BezierSpeed);
+const bench::Register bezier_batch("bezier_batch", BezierBatch);
+
+}
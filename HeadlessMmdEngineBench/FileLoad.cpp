@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "..\HeadlessMmdEngine\Common.h"
+
+namespace {
+
+using namespace headless_mmd;
+
+// a dance of 200 bones keyed on every frame for two minutes, about 80 MB on disk
+Vmd MakeLargeVmd() {
+	constexpr int NumBones = 200;
+	constexpr uint32_t NumFrames = 3600;
+
+	Vmd vmd{};
+	for (int b = 0; b < NumBones; ++b) {
+		auto& keys = vmd.motions[std::format("bone{}", b)];
+		keys.resize(NumFrames, Vmd::DefaultMotionKey);
+		for (uint32_t f = 0; f < NumFrames; ++f) {
+			keys[f].frame = f;
+			keys[f].position = { 0.01f * static_cast<float>(f), 0.f, static_cast<float>(b), 0.f };
+		}
+	}
+	return vmd;
+}
+
+// the mapped load against the ifstream copy it replaced. the file is in the page cache for both,
+// so what differs is the copy into a buffer the size of the file.
+void MappedLoad() {
+	const auto path = std::filesystem::temp_directory_path() / "headless_mmd_bench.vmd";
+
+	std::vector<char> bin{};
+	bench::Expect(portable_mmd::SaveVmd(bin, MakeLargeVmd()), "the vmd did not save");
+	bench::Expect(portable_mmd::io::SaveBinary(path, bin), "{} could not be written", path.string());
+	const auto file_size = bin.size();
+	bin = {};
+
+	std::size_t copied = 0;
+	std::size_t loaded_keys[2]{};
+	const auto copy = bench::Measure(1, [&](int) {
+		const auto data = portable_mmd::io::LoadBinary(path);
+		FlatVmd vmd{};
+		portable_mmd::LoadVmd(data.data(), data.size(), vmd);
+		copied = data.size();
+		loaded_keys[0] = vmd.motions.keys.size();
+	});
+	const auto mapped = bench::Measure(1, [&](int) {
+		const portable_mmd::io::MappedFile file(path);
+		FlatVmd vmd{};
+		portable_mmd::LoadVmd(file.Data(), file.Size(), vmd);
+		loaded_keys[1] = vmd.motions.keys.size();
+	});
+	std::filesystem::remove(path);
+
+	bench::Expect(loaded_keys[0] == 200 * 3600 && loaded_keys[0] == loaded_keys[1], "{} keys loaded through ifstream and {} mapped", loaded_keys[0], loaded_keys[1]);
+	bench::Report("{:.1f} MB, {} keys", file_size / 1e6, loaded_keys[0]);
+	bench::Report("ifstream: {:7.2f} ms, {:.1f} MB copied", copy / 1e6, copied / 1e6);
+	bench::Report("mapped:   {:7.2f} ms", mapped / 1e6);
+}
+
+const bench::Register mapped_load("mapped_load", MappedLoad);
+
+}
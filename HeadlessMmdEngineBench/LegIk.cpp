@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "..\HeadlessMmdEngine\MathHelper.h"
+#include "..\HeadlessMmdEngine\Skeleton.h"
+
+namespace {
+
+using namespace headless_mmd;
+
+constexpr float GoalTolerance = 1e-3f;
+constexpr float KneeMin = -DirectX::XM_PI;
+constexpr float KneeMax = -0.5f * DirectX::XM_PI / 180.f;
+
+enum {
+	Center,
+	Leg,
+	Knee,
+	Ankle,
+	LegIk,
+	LegD,
+	KneeD,
+};
+
+// a leg with the ik of an mmd model, and deform bones that take the whole rotation of the leg and
+// of the knee, ik included, as the d bones of a model do
+const bench::BoneDesc Bones[] = {
+	{ L"center", -1, { 0.f, 8.f, 0.f, 0.f } },
+	{ L"leg", Center, { 1.f, 10.f, 0.f, 0.f } },
+	{ L"knee", Leg, { 1.f, 5.f, 0.f, 0.f } },
+	{ L"ankle", Knee, { 1.f, 0.f, 0.f, 0.f } },
+	{ L"leg ik", Center, { 1.f, 0.f, 0.f, 0.f } },
+	{ L"leg d", Center, { 1.f, 10.f, 0.f, 0.f }, Leg, 1.f },
+	{ L"knee d", LegD, { 1.f, 5.f, 0.f, 0.f }, Knee, 1.f },
+};
+
+Pmx MakePmx() {
+	auto pmx = bench::MakePmx(Bones);
+
+	auto& ik = pmx.bones[LegIk];
+	ik.is_ik = true;
+	ik.ik_target_bone_index = Ankle;
+	ik.ik_iteration_count = 40;
+	ik.ik_angle_limit = 2.f;
+	ik.ik_links = {
+		{ Knee, true, { KneeMin, 0.f, 0.f, 0.f }, { KneeMax, 0.f, 0.f, 0.f } },
+		{ Leg, false, {}, {} },
+	};
+	return pmx;
+}
+
+// the rotation of the knee relative to the leg, as an angle about x and what is left off that axis
+void GetKneeAngle(const Skeleton& skeleton, float& angle, float& off_axis) {
+	const auto q = quat_from_matrix(skeleton.GetPose(Knee) * matrix_inverse(skeleton.GetPose(Leg)));
+	angle = std::remainder(2.f * std::atan2(DirectX::XMVectorGetX(q), DirectX::XMVectorGetW(q)), DirectX::XM_2PI);
+	off_axis = std::max(std::abs(DirectX::XMVectorGetY(q)), std::abs(DirectX::XMVectorGetZ(q)));
+}
+
+// moves the leg ik around the reach of the leg and beyond it, checking that the ankle reaches
+// the goals it can, that the knee only bends about x within its limits, and that the d bones follow
+void SolveLegIk() {
+	auto skeleton = SkeletonImporter().Import(nullptr, MakePmx(), nullptr);
+	bench::Expect(skeleton != nullptr, "the skeleton did not import");
+
+	struct Goal {
+		Vector	offset;		// of the leg ik from its rest position
+		bool	reachable;
+	};
+	const Goal goals[] = {
+		{ { 0.f, 2.f, 1.f, 0.f }, true },
+		{ { 0.f, 4.f, -1.f, 0.f }, true },
+		{ { 0.5f, 3.f, 2.f, 0.f }, true },
+		{ { -1.f, 6.f, 3.f, 0.f }, true },
+		{ { 0.f, 1.5f, 2.f, 0.f }, true },
+		{ { 0.f, 3.f, 0.f, 0.f }, true },	// straight up, in line with a straight leg
+		{ { 0.f, -3.f, 2.f, 0.f }, false },
+		{ { 4.f, -1.f, 0.f, 0.f }, false },
+	};
+
+	float worst_goal = 0.f;
+	float worst_follow = 0.f;
+	for (const auto& goal : goals) {
+		skeleton->SetLocalPose(LegIk, goal.offset, quat_zero());
+		skeleton->SolvePose();
+
+		const auto to_goal = vector_sub(matrix_position(skeleton->GetPose(LegIk)), matrix_position(skeleton->GetPose(Ankle)));
+		const auto miss = std::sqrt(vector3_dot(to_goal, to_goal));
+		if (goal.reachable) {
+			bench::Expect(miss < GoalTolerance, "the ankle misses a goal at ({}, {}, {}) by {}",
+				DirectX::XMVectorGetX(goal.offset), DirectX::XMVectorGetY(goal.offset), DirectX::XMVectorGetZ(goal.offset), miss);
+			worst_goal = std::max(worst_goal, miss);
+		}
+
+		float angle = 0.f;
+		float off_axis = 0.f;
+		GetKneeAngle(*skeleton, angle, off_axis);
+		bench::Expect(angle >= KneeMin - 1e-4f && angle <= KneeMax + 1e-4f, "the knee bends to {} outside [{}, {}]", angle, KneeMin, KneeMax);
+		bench::Expect(off_axis < 1e-4f, "the knee turns {} off its axis", off_axis);
+
+		worst_follow = std::max({ worst_follow,
+			bench::MaxDifference(skeleton->GetPose(LegD), skeleton->GetPose(Leg)),
+			bench::MaxDifference(skeleton->GetPose(KneeD), skeleton->GetPose(Knee)) });
+	}
+	bench::Expect(worst_follow < 1e-4f, "the d bones are {} off the leg", worst_follow);
+
+	// without its ik the leg keeps the pose it was given
+	skeleton->EnableIk(LegIk, false);
+	skeleton->SolvePose();
+	bench::Expect(bench::MaxDifference(skeleton->GetPose(Ankle), matrix_translation(Bones[Ankle].position)) < 1e-5f, "the leg moved with its ik off");
+	skeleton->EnableIk(LegIk, true);
+
+	skeleton->SetLocalPose(LegIk, goals[0].offset, quat_zero());
+	const auto solve = bench::Measure(1000, [&](int) { skeleton->SolvePose(); });
+
+	bench::Report("worst miss {:.3g}, d bones {:.3g} off", worst_goal, worst_follow);
+	bench::Report("SolvePose: {:7.1f} ns per call", solve);
+}
+
+const bench::Register leg_ik("leg_ik", SolveLegIk);
+
+}
@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "..\HeadlessMmdEngine\Animation.h"
+
+namespace {
+
+using namespace headless_mmd;
+
+constexpr int NumTracks = 1200;
+
+// tracks of 20 to 420 keys, one to eight frames apart, as the morphs of a long facial motion are
+std::vector<Track<float>> MakeTracks(std::mt19937& rng) {
+	std::uniform_int_distribution<int> num_keys(20, 420);
+	std::uniform_int_distribution<int> gap(1, 8);
+	std::uniform_real_distribution<float> weight(0.f, 1.f);
+
+	std::vector<Track<float>> tracks(NumTracks);
+	for (auto& track : tracks) {
+		int frame = gap(rng) - 1;
+		for (int k = num_keys(rng); k > 0; --k) {
+			track.keys.push_back({ frame, weight(rng) });
+			frame += gap(rng);
+		}
+	}
+	return tracks;
+}
+
+int GetLastFrame(const std::vector<Track<float>>& tracks) {
+	int last = 0;
+	for (const auto& track : tracks) {
+		last = std::max(last, track.keys.back().frame);
+	}
+	return last;
+}
+
+// the lookup the cursor replaced, a binary search of the whole track on every call
+float SearchAt(const Track<float>& track, float frame) {
+	const auto& keys = track.keys;
+	auto it = std::ranges::upper_bound(keys, frame, {}, [](const Key<float>& key) { return static_cast<float>(key.frame); });
+	if (it == keys.begin()) {
+		return keys.front().value;
+	}
+	if (it == keys.end()) {
+		return keys.back().value;
+	}
+
+	const auto& key0 = *(it - 1);
+	if (static_cast<float>(key0.frame) == frame) {
+		return key0.value;
+	}
+	const float s = (frame - static_cast<float>(key0.frame)) / static_cast<float>(it->frame - key0.frame);
+	return Interpolate(key0.value, it->value, s);
+}
+
+// 60 Hz playback of a 30 fps timeline, so every frame is visited twice
+std::vector<float> MakePlayback(int last_frame) {
+	std::vector<float> frames{};
+	for (int tick = 0; tick <= 2 * last_frame; ++tick) {
+		frames.push_back(0.5f * static_cast<float>(tick));
+	}
+	return frames;
+}
+
+std::vector<float> MakeSeeks(std::mt19937& rng, int last_frame, int count) {
+	std::uniform_real_distribution<float> frame(-10.f, static_cast<float>(last_frame) + 10.f);
+	std::vector<float> frames(count);
+	for (auto& f : frames) {
+		f = std::round(frame(rng) * 4.f) / 4.f;
+	}
+	return frames;
+}
+
+// the cursor has to give what the binary search gives, on playback and on seeks alike
+void CursorPlayback() {
+	std::mt19937 rng(14);
+	const auto tracks = MakeTracks(rng);
+	const auto last_frame = GetLastFrame(tracks);
+	const auto playback = MakePlayback(last_frame);
+	const auto seeks = MakeSeeks(rng, last_frame, 2000);
+
+	std::vector<TrackCursor> cursors(NumTracks);
+	for (const auto* frames : { &playback, &seeks }) {
+		for (float frame : *frames) {
+			for (int t = 0; t < NumTracks; ++t) {
+				const auto expected = SearchAt(tracks[t], frame);
+				const auto actual = tracks[t].CalcAt(frame, cursors[t]);
+				bench::Expect(actual == expected, "track {} at frame {} is {} instead of {}", t, frame, actual, expected);
+			}
+		}
+	}
+
+	volatile float sink = 0.f;
+	auto Tick = [&](const std::vector<float>& frames, bool use_cursor) {
+		return [&, use_cursor](int i) {
+			const float frame = frames[i % frames.size()];
+			float sum = 0.f;
+			for (int t = 0; t < NumTracks; ++t) {
+				sum += use_cursor ? tracks[t].CalcAt(frame, cursors[t]) : SearchAt(tracks[t], frame);
+			}
+			sink = sum;
+		};
+	};
+
+	const auto num_ticks = static_cast<int>(playback.size());
+	bench::Report("{} tracks, {} ticks at 60 Hz", NumTracks, num_ticks);
+	bench::Report("binary search:         {:8.2f} us per tick", bench::Measure(num_ticks, Tick(playback, false)) / 1000.);
+	bench::Report("cursor:                {:8.2f} us per tick", bench::Measure(num_ticks, Tick(playback, true)) / 1000.);
+	bench::Report("cursor on random seeks:{:8.2f} us per tick", bench::Measure(static_cast<int>(seeks.size()), Tick(seeks, true)) / 1000.);
+}
+
+// the packed timeline evaluates every track in one call, simd where the target has it,
+// and has to agree with the tracks it was built from
+void MorphTimelinePlayback() {
+	std::mt19937 rng(17);
+	auto tracks = MakeTracks(rng);
+	tracks[7].keys.resize(1);	// a single key holds for the whole timeline
+
+	const auto last_frame = GetLastFrame(tracks);
+	const auto playback = MakePlayback(last_frame);
+	const auto seeks = MakeSeeks(rng, last_frame, 2000);
+
+	MorphTimeline timeline{};
+	timeline.Build(tracks);
+	bench::Expect(timeline.GetNumTracks() == NumTracks, "{} tracks built", timeline.GetNumTracks());
+
+	auto cursor = timeline.MakeCursor();
+	std::vector<TrackCursor> cursors(NumTracks);
+	std::vector<float> weights(NumTracks);
+	float worst = 0.f;
+	for (const auto* frames : { &playback, &seeks }) {
+		for (float frame : *frames) {
+			timeline.Evaluate(frame, cursor, weights);
+			for (int t = 0; t < NumTracks; ++t) {
+				const auto expected = tracks[t].CalcAt(frame, cursors[t]);
+				worst = std::max(worst, std::abs(weights[t] - expected));
+				bench::Expect(std::abs(weights[t] - expected) <= 1e-6f, "track {} at frame {} is {} instead of {}", t, frame, weights[t], expected);
+			}
+		}
+	}
+	bench::Report("worst difference from Track::CalcAt {:.3g}", worst);
+
+	volatile float sink = 0.f;
+	const auto num_ticks = static_cast<int>(playback.size());
+	const auto per_track = bench::Measure(num_ticks, [&](int i) {
+		float sum = 0.f;
+		for (int t = 0; t < NumTracks; ++t) {
+			sum += tracks[t].CalcAt(playback[i], cursors[t]);
+		}
+		sink = sum;
+	});
+	const auto packed = bench::Measure(num_ticks, [&](int i) {
+		timeline.Evaluate(playback[i], cursor, weights);
+		sink = weights[0];
+	});
+	bench::Report("Track::CalcAt:         {:8.2f} us per tick", per_track / 1000.);
+	bench::Report("MorphTimeline:         {:8.2f} us per tick", packed / 1000.);
+}
+
+const bench::Register cursor_playback("cursor_playback", CursorPlayback);
+const bench::Register morph_timeline("morph_timeline", MorphTimelinePlayback);
+
+}
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "..\HeadlessMmdEngine\PoseCache.h"
+#include "..\HeadlessMmdEngine\Skeleton.h"
+
+namespace {
+
+using namespace headless_mmd;
+
+Pmx MakePmx(float arm_length) {
+	const bench::BoneDesc bones[] = {
+		{ L"upper", -1, { 0.f, 10.f, 0.f, 0.f } },
+		{ L"arm", 0, { 2.f, 12.f, 0.f, 0.f } },
+		{ L"hand", 1, { 2.f + arm_length, 12.f, 0.f, 0.f } },
+	};
+	return bench::MakePmx(bones);
+}
+
+// models share a pose only when they play the same animation on the same rig at the same frame
+void PoseSharing() {
+	auto pmx = MakePmx(2.f);
+	const auto a = SkeletonImporter().Import(nullptr, pmx, nullptr);
+	const auto b = SkeletonImporter().Import(nullptr, pmx, nullptr);
+
+	// the names do not take part in solving
+	pmx.bones[2].name = L"wrist";
+	const auto renamed = SkeletonImporter().Import(nullptr, pmx, nullptr);
+	const auto longer = SkeletonImporter().Import(nullptr, MakePmx(3.f), nullptr);
+
+	bench::Expect(a->GetRigId() == b->GetRigId() && a->GetRigId() == renamed->GetRigId(), "one rig has several ids");
+	bench::Expect(a->GetRigId() != longer->GetRigId(), "another rig has the same id");
+
+	const auto* dance = reinterpret_cast<const Animation*>(0x10);
+	const auto* walk = reinterpret_cast<const Animation*>(0x20);
+
+	PoseCache cache{};
+	for (int frame = 0; frame < 3; ++frame) {
+		cache.NextFrame();
+
+		bool hit = false;
+		auto& first = cache.Acquire(dance, a->GetRigId(), static_cast<float>(frame), hit);
+		bench::Expect(!hit && first.num_users == 1 && !first.has_bones, "the first model of frame {} did not evaluate", frame);
+		first.has_bones = true;
+
+		auto& second = cache.Acquire(dance, b->GetRigId(), static_cast<float>(frame), hit);
+		bench::Expect(hit && &second == &first && first.num_users == 2, "the second model of frame {} did not share", frame);
+
+		cache.Acquire(dance, longer->GetRigId(), static_cast<float>(frame), hit);
+		bench::Expect(!hit, "another rig shared at frame {}", frame);
+		cache.Acquire(walk, a->GetRigId(), static_cast<float>(frame), hit);
+		bench::Expect(!hit, "another animation shared at frame {}", frame);
+		cache.Acquire(dance, a->GetRigId(), frame + 0.5f, hit);
+		bench::Expect(!hit, "another frame shared at frame {}", frame);
+	}
+
+	const auto& stats = cache.GetStats();
+	bench::Expect(stats.hits == 3 && stats.misses == 12, "{} hits and {} misses", stats.hits, stats.misses);
+}
+
+const bench::Register pose_sharing("pose_sharing", PoseSharing);
+
+}
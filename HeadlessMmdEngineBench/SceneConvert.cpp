@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "..\HeadlessMmdEngine\Animation.h"
+#include "..\HeadlessMmdEngine\MathHelper.h"
+#include "..\HeadlessMmdEngine\MmdScene.h"
+#include "..\HeadlessMmdEngine\MotionConverter.h"
+
+namespace {
+
+using namespace headless_mmd;
+
+constexpr int NumFrames = 300;
+constexpr float TranslationTolerance = 0.01f;
+constexpr float RotationTolerance = 0.005f;
+
+// a spine, a still neck, an arm, and a bone without keys that takes half of the spine
+const bench::BoneDesc Bones[] = {
+	{ L"center", -1, { 0.f, 8.f, 0.f, 0.f } },
+	{ L"upper", 0, { 0.f, 10.f, 0.f, 0.f } },
+	{ L"neck", 1, { 0.f, 14.f, 0.f, 0.f } },
+	{ L"arm", 1, { 2.f, 12.f, 0.f, 0.f } },
+	{ L"twist", 0, { 1.f, 9.f, 0.f, 0.f }, 1, 0.5f },
+};
+constexpr int NumBones = static_cast<int>(std::size(Bones));
+
+// eased keys between random poses every 15 to 40 frames, as a hand keyed dance is
+Vmd MakeMotion() {
+	std::mt19937 rng(25);
+	std::uniform_real_distribution<float> angle(-0.8f, 0.8f);
+	std::uniform_real_distribution<float> offset(-1.f, 1.f);
+	std::uniform_int_distribution<int> gap(15, 40);
+	std::uniform_int_distribution<int> point(10, 117);
+
+	auto MakeKeys = [&](bool move) {
+		std::vector<Vmd::MotionKey> keys{};
+		for (int frame = 0; frame < NumFrames; frame += gap(rng)) {
+			auto key = Vmd::DefaultMotionKey;
+			key.frame = static_cast<uint32_t>(frame);
+			key.position = move ? Vector{ offset(rng), 0.5f * offset(rng), offset(rng), 0.f } : vector_zero();
+			key.orientation = quat_from_euler({ angle(rng), angle(rng), angle(rng), 0.f });
+			const portable_mmd::Interpolation curve{ static_cast<int8_t>(point(rng)), static_cast<int8_t>(point(rng)), static_cast<int8_t>(point(rng)), static_cast<int8_t>(point(rng)) };
+			key.ix = curve;
+			key.iy = curve;
+			key.iz = curve;
+			key.ir = curve;
+			keys.push_back(key);
+		}
+		return keys;
+	};
+
+	Vmd vmd{};
+	vmd.motions["center"] = MakeKeys(true);
+	vmd.motions["upper"] = MakeKeys(false);
+	vmd.motions["arm"] = MakeKeys(false);
+	return vmd;
+}
+
+std::shared_ptr<Animation> LoadAnimation(const Vmd& vmd, const Skeleton& skeleton) {
+	std::vector<char> bin{};
+	bench::Expect(portable_mmd::SaveVmd(bin, vmd), "the vmd did not save");
+
+	FlatVmd flat{};
+	bench::Expect(portable_mmd::LoadVmd(bin.data(), bin.size(), flat), "the vmd did not load");
+
+	auto animation = AnimationImporter().Import(flat, skeleton, {});
+	bench::Expect(animation && animation->HasMotion(), "the motion did not import");
+	return animation;
+}
+
+// captures the world poses of a motion as the captor does, converts them back to keys, writes and
+// loads those and plays them on the same skeleton, comparing every world pose with the capture
+void ConvertRoundTrip() {
+	const auto pmx = bench::MakePmx(Bones);
+	auto skeleton = SkeletonImporter().Import(nullptr, pmx, nullptr);
+	bench::Expect(skeleton != nullptr, "the skeleton did not import");
+
+	MmdAnimationTrack track{};
+	track.name = L"C:\\models\\dancer.pmx";
+	{
+		const auto source = LoadAnimation(MakeMotion(), *skeleton);
+		auto cursor = source->MakeCursor();
+
+		std::vector<std::vector<Matrix>> captured(NumBones, std::vector<Matrix>(NumFrames));
+		for (int frame = 0; frame < NumFrames; ++frame) {
+			source->EvaluateMotion(static_cast<float>(frame), cursor, *skeleton);
+			skeleton->SolvePose();
+			for (int i = 0; i < NumBones; ++i) {
+				captured[i][frame] = skeleton->GetPose(i);
+			}
+		}
+		for (int i = 0; i < NumBones; ++i) {
+			track.bone_animation.emplace(Bones[i].name, DenseTrack<Matrix>(std::move(captured[i])));
+		}
+	}
+
+	Vmd vmd{};
+	KeyReductionInfo info{};
+	const auto converted = bench::Measure(1, [&](int) {
+		vmd = {};
+		bench::Expect(MotionConverter(TranslationTolerance, RotationTolerance).Convert(track, pmx, vmd, &info), "the capture did not convert");
+	}, 1);
+	bench::Expect(info.num_saved_keys < info.num_keys, "{} of {} keys kept", info.num_saved_keys, info.num_keys);
+	bench::Expect(!vmd.motions.contains("neck") && !vmd.motions.contains("twist"), "a bone at rest or following another got keys");
+
+	const auto animation = LoadAnimation(vmd, *skeleton);
+	auto cursor = animation->MakeCursor();
+	float worst = 0.f;
+	int worst_frame = 0;
+	int worst_bone = 0;
+	for (int frame = 0; frame < NumFrames; ++frame) {
+		animation->EvaluateMotion(static_cast<float>(frame), cursor, *skeleton);
+		skeleton->SolvePose();
+		for (int i = 0; i < NumBones; ++i) {
+			const auto diff = bench::MaxDifference(skeleton->GetPose(i), track.bone_animation.at(Bones[i].name).GetByIndex(frame));
+			if (diff > worst) {
+				worst = diff;
+				worst_frame = frame;
+				worst_bone = i;
+			}
+		}
+	}
+
+	bench::Report("{} of {} keys kept, {:.1f}x fewer, in {:.2f} ms", info.num_saved_keys, info.num_keys, info.GetCompressionRatio(), converted / 1e6);
+	bench::Report("worst pose difference {:.3g} on bone {} at frame {}", worst, worst_bone, worst_frame);
+
+	// each bone is within the tolerances of its parent, so the error grows down the chain
+	bench::Expect(worst < 0.02f, "poses differ by {} on bone {} at frame {}", worst, worst_bone, worst_frame);
+}
+
+const bench::Register convert_round_trip("convert_round_trip", ConvertRoundTrip);
+
+}
@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "..\HeadlessMmdEngine\Animation.h"
+#include "..\HeadlessMmdEngine\MathHelper.h"
+
+namespace {
+
+using namespace headless_mmd;
+
+// a spine and an arm, the hand without keys
+const bench::BoneDesc Bones[] = {
+	{ L"center", -1, { 0.f, 8.f, 0.f, 0.f } },
+	{ L"upper", 0, { 0.f, 10.f, 0.f, 0.f } },
+	{ L"arm", 1, { 2.f, 12.f, 0.f, 0.f } },
+	{ L"hand", 2, { 4.f, 12.f, 0.f, 0.f } },
+};
+constexpr int NumBones = static_cast<int>(std::size(Bones));
+
+Vmd::MotionKey MakeKey(uint32_t frame, Vector position, Vector euler, portable_mmd::Interpolation curve) {
+	auto key = Vmd::DefaultMotionKey;
+	key.frame = frame;
+	key.position = position;
+	key.orientation = quat_from_euler(euler);
+	key.ix = curve;
+	key.iy = curve;
+	key.iz = curve;
+	key.ir = curve;
+	return key;
+}
+
+// eased, linear and vertical tangent curves, the last being the hardest to solve
+Vmd MakeMotion() {
+	constexpr portable_mmd::Interpolation ease{ 20, 107, 20, 107 };
+	constexpr portable_mmd::Interpolation steep{ 0, 127, 127, 0 };
+	constexpr portable_mmd::Interpolation late{ 64, 0, 10, 120 };
+
+	Vmd vmd{};
+	vmd.motions["center"] = {
+		MakeKey(0, { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, ease),
+		MakeKey(20, { 1.f, 0.5f, -1.f, 0.f }, { 0.f, 0.8f, 0.f, 0.f }, steep),
+		MakeKey(50, { -0.5f, 0.f, 2.f, 0.f }, { 0.1f, -0.4f, 0.f, 0.f }, portable_mmd::DefaultInterpolation),
+	};
+	vmd.motions["upper"] = {
+		MakeKey(0, { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, ease),
+		MakeKey(30, { 0.f, 0.f, 0.f, 0.f }, { -0.6f, 0.3f, 0.2f, 0.f }, late),
+	};
+	vmd.motions["arm"] = {
+		MakeKey(10, { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.4f, 0.f }, ease),
+		MakeKey(40, { 0.f, 0.f, 0.f, 0.f }, { 0.f, -1.f, -0.7f, 0.f }, steep),
+	};
+	vmd.morphs["smile"] = { { 0, 0.f }, { 30, 1.f }, { 45, 0.25f } };
+	return vmd;
+}
+
+// the world pose at frame, taken straight from the keys with the curves solved in double
+std::vector<Matrix> ReferencePose(const Vmd& vmd, float frame) {
+	std::vector<Matrix> world(NumBones);
+	for (int i = 0; i < NumBones; ++i) {
+		auto translation = vector_zero();
+		auto rotation = quat_zero();
+
+		if (auto it = vmd.motions.find(Utf16ToSjis(Bones[i].name)); it != vmd.motions.end()) {
+			const auto& keys = it->second;
+			auto next = std::ranges::find_if(keys, [&](const auto& key) { return static_cast<float>(key.frame) > frame; });
+			if (next == keys.begin() || next == keys.end()) {
+				const auto& key = next == keys.begin() ? keys.front() : keys.back();
+				translation = key.position;
+				rotation = key.orientation;
+			}
+			else {
+				const auto& key0 = *(next - 1);
+				const auto& key1 = *next;
+				const double s = (frame - static_cast<double>(key0.frame)) / (static_cast<double>(key1.frame) - key0.frame);
+				auto Solve = [&](const portable_mmd::Interpolation& c) { return static_cast<float>(bench::SolveBezier(c.x1, c.x2, c.y1, c.y2, s)); };
+
+				translation = lerp(key0.position, key1.position, Vector{ Solve(key1.ix), Solve(key1.iy), Solve(key1.iz), 0.f });
+				rotation = DirectX::XMQuaternionSlerp(key0.orientation, key1.orientation, Solve(key1.ir));
+			}
+		}
+
+		const auto parent = Bones[i].parent;
+		const auto local_position = parent >= 0 ? vector_sub(Bones[i].position, Bones[parent].position) : Bones[i].position;
+		const auto local = DirectX::XMMatrixRotationQuaternion(rotation) * DirectX::XMMatrixTranslationFromVector(vector_add(local_position, translation));
+		world[i] = parent >= 0 ? local * world[parent] : local;
+	}
+	return world;
+}
+
+// writes a vmd, loads it the way the engine does and plays it on a skeleton, comparing every
+// world pose with one computed from the keys themselves
+void VmdReplay() {
+	const auto pmx = bench::MakePmx(Bones);
+	auto skeleton = SkeletonImporter().Import(nullptr, pmx, nullptr);
+	bench::Expect(skeleton != nullptr, "the skeleton did not import");
+
+	const auto vmd = MakeMotion();
+	std::vector<char> bin{};
+	bench::Expect(portable_mmd::SaveVmd(bin, vmd), "the vmd did not save");
+
+	FlatVmd flat{};
+	bench::Expect(portable_mmd::LoadVmd(bin.data(), bin.size(), flat), "the vmd did not load");
+
+	const std::vector<std::wstring> morph_names{ L"smile" };
+	auto animation = AnimationImporter().Import(flat, *skeleton, morph_names);
+	bench::Expect(animation && animation->HasMotion(), "the motion did not import");
+	bench::Expect(animation->GetNumFrames() == 51, "{} frames instead of 51", animation->GetNumFrames());
+
+	auto cursor = animation->MakeCursor();
+	float worst = 0.f;
+	float worst_frame = 0.f;
+	for (float frame = 0.f; frame <= 60.f; frame += 0.25f) {
+		animation->EvaluateMotion(frame, cursor, *skeleton);
+		skeleton->SolvePose();
+
+		const auto reference = ReferencePose(vmd, frame);
+		for (int i = 0; i < NumBones; ++i) {
+			const auto diff = bench::MaxDifference(skeleton->GetPose(i), reference[i]);
+			if (diff > worst) {
+				worst = diff;
+				worst_frame = frame;
+			}
+		}
+	}
+	bench::Report("worst pose difference {:.3g} at frame {}", worst, worst_frame);
+	bench::Expect(worst < 2e-4f, "poses differ by {} at frame {}", worst, worst_frame);
+
+	std::vector<float> weights(1);
+	animation->EvaluateMorphs(15.f, cursor, weights);
+	bench::Expect(std::abs(weights[0] - 0.5f) < 1e-6f, "smile is {} at frame 15 instead of 0.5", weights[0]);
+}
+
+// a facial motion has morph keys and no bone keys, it must still import
+void MorphOnlyVmd() {
+	const auto pmx = bench::MakePmx(Bones);
+	auto skeleton = SkeletonImporter().Import(nullptr, pmx, nullptr);
+	bench::Expect(skeleton != nullptr, "the skeleton did not import");
+
+	Vmd vmd{};
+	vmd.morphs["smile"] = { { 0, 0.f }, { 30, 1.f } };
+	vmd.morphs["blink"] = { { 10, 1.f } };
+
+	std::vector<char> bin{};
+	bench::Expect(portable_mmd::SaveVmd(bin, vmd), "the vmd did not save");
+
+	FlatVmd flat{};
+	bench::Expect(portable_mmd::LoadVmd(bin.data(), bin.size(), flat), "the vmd did not load");
+	bench::Expect(flat.motions.keys.empty() && flat.morphs.keys.size() == 3, "{} motion and {} morph keys loaded", flat.motions.keys.size(), flat.morphs.keys.size());
+
+	const std::vector<std::wstring> morph_names{ L"blink", L"smile", L"angry" };
+	auto animation = AnimationImporter().Import(flat, *skeleton, morph_names);
+	bench::Expect(animation && animation->GetNumMorphTracks() == 3, "the morphs did not import");
+	bench::Expect(animation->GetNumFrames() == 31, "{} frames instead of 31", animation->GetNumFrames());
+
+	auto cursor = animation->MakeCursor();
+	std::vector<float> weights(3);
+	animation->EvaluateMorphs(20.f, cursor, weights);
+	bench::Expect(weights[0] == 1.f && std::abs(weights[1] - 2.f / 3.f) < 1e-6f && weights[2] == 0.f,
+		"weights at frame 20 are {}, {}, {}", weights[0], weights[1], weights[2]);
+}
+
+const bench::Register vmd_replay("vmd_replay", VmdReplay);
+const bench::Register morph_only_vmd("morph_only_vmd", MorphOnlyVmd);
+
+}
@@ -0,0 +1,28 @@
+#include "pch.h"
+
+#pragma comment(lib, "HeadlessMmdEngine.lib")
+
+// HeadlessMmdEngineBench [case...]
+// runs the named cases or all of them, and returns the number that failed
+int main(int argc, char** argv) {
+	const std::vector<std::string> names(argv + 1, argv + argc);
+
+	int num_failed = 0;
+	for (const auto& c : bench::GetCases()) {
+		if (!names.empty() && std::ranges::find(names, c.name) == names.end()) {
+			continue;
+		}
+
+		std::printf("%s\n", c.name);
+		try {
+			c.func();
+			std::printf("    ok\n");
+		}
+		catch (const std::exception& e) {
+			std::printf("    FAILED: %s\n", e.what());
+			++num_failed;
+		}
+	}
+
+	return num_failed;
+}
@@ -0,0 +1,11 @@
+#pragma once
+// the engine headers rely on what its precompiled header brings in
+#include "..\HeadlessMmdEngine\pch.h"
+
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <span>
+#include <stdexcept>
+
+#include "Bench.h"
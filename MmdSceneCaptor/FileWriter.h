@@ -13,6 +13,8 @@ public:
 
 	void WriteString(const char* str);
 
+	uint64_t Tell();
+
 private:
 	std::ofstream ofs_;
 
@@ -44,3 +46,7 @@ inline void FileWriter::WriteString(const char* str) {
 	ofs_.write((const char*)&len, sizeof(len));
 	ofs_.write(str, len);
 }
+
+inline uint64_t FileWriter::Tell() {
+	return static_cast<uint64_t>(ofs_.tellp());
+}
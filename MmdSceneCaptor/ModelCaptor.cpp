@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "ModelCaptor.h"
+#include "../HeadlessMmdEngine/mscap.h"
 
 ModelCaptor::ModelCaptor(int model) :
 	model_index_(model),
@@ -22,12 +23,11 @@ void ModelCaptor::Save(FileWriter& writer) {
 		writer.Write(dummy); // name len
 		writer.Write(dummy); // num bones
 		writer.Write(dummy); // num morphs
-		writer.Write(dummy); // num frames
 		return;
 	}
 
 	SaveInfo(writer);
-	SaveBones(writer);
+	SaveBoneNames(writer);
 	SaveMorphs(writer);
 }
 
@@ -35,18 +35,33 @@ void ModelCaptor::SaveInfo(FileWriter& writer) {
 	writer.WriteString(ExpGetPmdFilename(model_index_));
 }
 
-void ModelCaptor::SaveBones(FileWriter& writer) {
+void ModelCaptor::SaveBoneNames(FileWriter& writer) {
 	writer.Write(num_bones_);
 
 	for (int bi = 0; bi < num_bones_; ++bi) {
 		writer.WriteString(ExpGetPmdBoneName(model_index_, bi));
+	}
+}
 
-		auto num_frames = static_cast<int32_t>(frames_.size());
-		writer.Write(num_frames);
+// one chunk of the bone tracks in the mscap v3 layout, see mscap.h
+void ModelCaptor::SaveBones(FileWriter& writer, int first_frame, int num_frames) {
+	if (!ExpGetPmdFilename(model_index_)) {
+		return;
+	}
 
-		for (int fi = 0; fi < num_frames; ++fi) {
-			writer.Write(frames_[fi].transforms[bi]);
+	for (int bi = 0; bi < num_bones_; ++bi) {
+		// a model that stopped being captured holds its last frame
+		std::vector<mscap::Matrix> transforms(num_frames, mscap::IdentityMatrix);
+		for (int fi = 0; fi < num_frames && !frames_.empty(); ++fi) {
+			const auto& frame = frames_[std::min<std::size_t>(first_frame + fi, frames_.size() - 1)];
+			memcpy(transforms[fi].data(), &frame.transforms[bi], sizeof(D3DMATRIX));
 		}
+
+		std::vector<uint8_t> data{};
+		mscap::EncodeBoneTrack(transforms, data);
+
+		writer.Write(static_cast<uint32_t>(data.size()));
+		writer.WriteArray(data.data(), static_cast<int>(data.size()));
 	}
 }
 
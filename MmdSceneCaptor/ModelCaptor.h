@@ -8,6 +8,11 @@ public:
 
 	void Capture(int frame_no);
 	void Save(FileWriter& writer);
+	void SaveBones(FileWriter& writer, int first_frame, int num_frames);
+
+	int GetNumFrames() const {
+		return static_cast<int>(frames_.size());
+	}
 
 private:
 	struct Frame {
@@ -15,7 +20,7 @@ private:
 	};
 
 	void SaveInfo(FileWriter& writer);
-	void SaveBones(FileWriter& writer);
+	void SaveBoneNames(FileWriter& writer);
 	void SaveMorphs(FileWriter& writer);
 
 	Frame& AcquireFrame(int frame_no);
@@ -2,6 +2,7 @@
 #include "FileWriter.h"
 #include "SceneCaptor.h"
 #include "WinAppHelper.h"
+#include "../HeadlessMmdEngine/mscap.h"
 
 enum class SceneCaptureFlag : uint32_t {
 	Motion = 0b0001,
@@ -74,7 +75,7 @@ void SceneCaptor::Save(){
 	// header
 	{
 		auto flag = static_cast<uint32_t>(SceneCaptureFlag::Motion) | static_cast<uint32_t>(SceneCaptureFlag::Morph) | static_cast<uint32_t>(SceneCaptureFlag::Camera);
-		writer.Write(flag);
+		writer.Write(mscap::MakeHeader(flag, mscap::LatestVersion));
 	}
 
 	// model data
@@ -92,6 +93,41 @@ void SceneCaptor::Save(){
 		camera_captor_->Save(writer);
 	}
 
+	// bone data, frame major so that a player can seek by chunk
+	{
+		int32_t num_frames = 0;
+		for (auto& model_captor : model_captors_) {
+			num_frames = std::max(num_frames, model_captor->GetNumFrames());
+		}
+
+		const auto chunk_frames = mscap::DefaultChunkFrames;
+		const auto num_chunks = mscap::GetNumChunks(num_frames, chunk_frames);
+
+		std::vector<mscap::ChunkEntry> chunks(num_chunks);
+		for (int ci = 0; ci < num_chunks; ++ci) {
+			const auto first_frame = ci * chunk_frames;
+			const auto offset = writer.Tell();
+
+			for (auto& model_captor : model_captors_) {
+				model_captor->SaveBones(writer, first_frame, std::min(chunk_frames, num_frames - first_frame));
+			}
+
+			chunks[ci] = { offset, static_cast<uint32_t>(writer.Tell() - offset) };
+		}
+
+		const auto index_offset = writer.Tell();
+		writer.Write(num_frames);
+		writer.Write(chunk_frames);
+		writer.Write(num_chunks);
+		writer.WriteArray(chunks.data(), num_chunks);
+		writer.Write(index_offset);
+	}
+
+	if (!writer) {
+		NotifySaveFailed(path);
+		return;
+	}
+
 	NotifySave();
 }
 
@@ -64,6 +64,16 @@ class _HomePageState extends ConsumerState<_HomePage> {
     final names = getList<String>(info["morph_names"]);
     final categories = getList<int>(info["morph_categories"]);
     ref.read(morphStateProvider.notifier).state = MorphState(names, categories);
+
+    // the morphs come back before the model is imported, drop them again when the import fails
+    var state = await MmdViewer().getModelState();
+    while (state == 'importing') {
+      await Future.delayed(const Duration(milliseconds: 100));
+      state = await MmdViewer().getModelState();
+    }
+    if (state == 'failed') {
+      ref.read(morphStateProvider.notifier).state = MorphState([], []);
+    }
   }
 
   void _openScene(String? path) async {
@@ -128,7 +138,7 @@ class _HomePageState extends ConsumerState<_HomePage> {
     }
 
     final result = await MmdViewer().saveAnimation(path, morphNames, frameTracks, valueTracks, "hyojo");
-    if (result == null || !result) {
+    if (result == null || result['saved'] != true) {
       return;
     }
 
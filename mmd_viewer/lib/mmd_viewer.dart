@@ -18,16 +18,59 @@ class MmdViewer {
     return MmdViewerPlatform.instance.openModel(path);
   }
 
+  /// One of 'none', 'importing', 'ready' or 'failed' for the model last given to [openModel],
+  /// which answers with the morphs before the rest of the model is imported.
+  Future<String?> getModelState() {
+    return MmdViewerPlatform.instance.getModelState();
+  }
+
   Future<dynamic> openScene(String path) {
     return MmdViewerPlatform.instance.openScene(path);
   }
 
-  Future<void> update(int frame, Float32List values) {
+  Future<void> update(num frame, Float32List values) {
     return MmdViewerPlatform.instance.update(frame, values);
   }
 
-  Future<bool?> saveAnimation(
-      String path, List<String> morphNames, List<Int32List> frameTracks, List<Float32List> valueTracks, String modelName) {
-    return MmdViewerPlatform.instance.saveAnimation(path, morphNames, frameTracks, valueTracks, modelName);
+  /// 'values' applies the values given to [update], 'animation' plays the morph tracks of the scene
+  /// given to [openScene] instead.
+  Future<void> setMorphSource(String source) {
+    return MmdViewerPlatform.instance.setMorphSource(source);
+  }
+
+  /// 'hits' and 'misses' of the poses shared between models playing the same animation on the same rig.
+  /// A miss is a pose evaluated, a hit one copied from another model.
+  Future<Map<String, int>?> getPoseCacheStats() {
+    return MmdViewerPlatform.instance.getPoseCacheStats();
+  }
+
+  /// Bytes per model kept of the frames reached by a seek, so that scrubbing back to one is a copy.
+  /// Frames reached by playing forward are not kept. 0, the default, turns it off.
+  Future<void> setScrubCacheBudget(int bytes) {
+    return MmdViewerPlatform.instance.setScrubCacheBudget(bytes);
+  }
+
+  /// 'budget', 'bytes', 'entries', 'hits', 'misses' and 'evictions' of the scrub cache, summed over the models.
+  Future<Map<String, int>?> getScrubCacheStats() {
+    return MmdViewerPlatform.instance.getScrubCacheStats();
+  }
+
+  /// Keys that the kept ones interpolate to within [tolerance] are dropped when it is given.
+  /// Returns 'saved', the keys given as 'num_keys', the keys written as 'num_saved_keys' and their 'ratio'.
+  Future<Map<String, Object?>?> saveAnimation(
+      String path, List<String> morphNames, List<Int32List> frameTracks, List<Float32List> valueTracks, String modelName,
+      {double? tolerance}) {
+    return MmdViewerPlatform.instance
+        .saveAnimation(path, morphNames, frameTracks, valueTracks, modelName, tolerance: tolerance);
+  }
+
+  /// Converts the motion of the model at [modelPath] in the capture at [scenePath] to a vmd at [vmdPath],
+  /// each bone within [translationTolerance] and [rotationTolerance] radians of every captured frame.
+  /// The track named after the model file is converted, which fails unless exactly one is, or the one at [trackIndex].
+  /// Returns the same map as [saveAnimation].
+  Future<Map<String, Object?>?> convertScene(String scenePath, String modelPath, String vmdPath,
+      {double? translationTolerance, double? rotationTolerance, int? trackIndex}) {
+    return MmdViewerPlatform.instance.convertScene(scenePath, modelPath, vmdPath,
+        translationTolerance: translationTolerance, rotationTolerance: rotationTolerance, trackIndex: trackIndex);
   }
 }
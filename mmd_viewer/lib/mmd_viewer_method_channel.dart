@@ -33,20 +33,65 @@ class MethodChannelMmdViewer extends MmdViewerPlatform {
     return methodChannel.invokeMethod<void>('openModel', {'path': path});
   }
 
+  @override
+  Future<String?> getModelState() {
+    return methodChannel.invokeMethod<String>('getModelState');
+  }
+
   @override
   Future<dynamic> openScene(String path) {
     return methodChannel.invokeMethod<void>('openScene', {'path': path});
   }
 
   @override
-  Future<void> update(int frame, Float32List values) {
+  Future<void> update(num frame, Float32List values) {
     return methodChannel.invokeMethod('update', {'frame': frame, 'values': values});
   }
 
   @override
-  Future<bool?> saveAnimation(
-      String path, List<String> morphNames, List<Int32List> frameTracks, List<Float32List> valueTracks, String modelName) {
-    return methodChannel.invokeMethod<bool>('saveAnimation',
-        {'path': path, 'morph_names': morphNames, 'frame_tracks': frameTracks, 'value_tracks': valueTracks, 'model_name': modelName});
+  Future<void> setMorphSource(String source) {
+    return methodChannel.invokeMethod<void>('setMorphSource', {'source': source});
+  }
+
+  @override
+  Future<Map<String, int>?> getPoseCacheStats() {
+    return methodChannel.invokeMapMethod<String, int>('getPoseCacheStats');
+  }
+
+  @override
+  Future<void> setScrubCacheBudget(int bytes) {
+    return methodChannel.invokeMethod<void>('setScrubCacheBudget', {'bytes': bytes});
+  }
+
+  @override
+  Future<Map<String, int>?> getScrubCacheStats() {
+    return methodChannel.invokeMapMethod<String, int>('getScrubCacheStats');
+  }
+
+  @override
+  Future<Map<String, Object?>?> saveAnimation(
+      String path, List<String> morphNames, List<Int32List> frameTracks, List<Float32List> valueTracks, String modelName,
+      {double? tolerance}) {
+    return methodChannel.invokeMapMethod<String, Object?>('saveAnimation', {
+      'path': path,
+      'morph_names': morphNames,
+      'frame_tracks': frameTracks,
+      'value_tracks': valueTracks,
+      'model_name': modelName,
+      if (tolerance != null) 'tolerance': tolerance
+    });
+  }
+
+  @override
+  Future<Map<String, Object?>?> convertScene(String scenePath, String modelPath, String vmdPath,
+      {double? translationTolerance, double? rotationTolerance, int? trackIndex}) {
+    return methodChannel.invokeMapMethod<String, Object?>('convertScene', {
+      'scene_path': scenePath,
+      'model_path': modelPath,
+      'vmd_path': vmdPath,
+      if (translationTolerance != null) 'translation_tolerance': translationTolerance,
+      if (rotationTolerance != null) 'rotation_tolerance': rotationTolerance,
+      if (trackIndex != null) 'track_index': trackIndex
+    });
   }
 }
@@ -37,16 +37,42 @@ abstract class MmdViewerPlatform extends PlatformInterface {
     throw UnimplementedError('openModel() has not been implemented.');
   }
 
+  Future<String?> getModelState() {
+    throw UnimplementedError('getModelState() has not been implemented.');
+  }
+
   Future<dynamic> openScene(String path) {
     throw UnimplementedError('openScene() has not been implemented.');
   }
 
-  Future<void> update(int frame, Float32List values) {
+  Future<void> update(num frame, Float32List values) {
     throw UnimplementedError('update() has not been implemented.');
   }
 
-  Future<bool?> saveAnimation(
-      String path, List<String> morphNames, List<Int32List> frameTracks, List<Float32List> valueTracks, String modelName) {
+  Future<void> setMorphSource(String source) {
+    throw UnimplementedError('setMorphSource() has not been implemented.');
+  }
+
+  Future<Map<String, int>?> getPoseCacheStats() {
+    throw UnimplementedError('getPoseCacheStats() has not been implemented.');
+  }
+
+  Future<void> setScrubCacheBudget(int bytes) {
+    throw UnimplementedError('setScrubCacheBudget() has not been implemented.');
+  }
+
+  Future<Map<String, int>?> getScrubCacheStats() {
+    throw UnimplementedError('getScrubCacheStats() has not been implemented.');
+  }
+
+  Future<Map<String, Object?>?> saveAnimation(
+      String path, List<String> morphNames, List<Int32List> frameTracks, List<Float32List> valueTracks, String modelName,
+      {double? tolerance}) {
     throw UnimplementedError('saveAnimation() has not been implemented.');
   }
+
+  Future<Map<String, Object?>?> convertScene(String scenePath, String modelPath, String vmdPath,
+      {double? translationTolerance, double? rotationTolerance, int? trackIndex}) {
+    throw UnimplementedError('convertScene() has not been implemented.');
+  }
 }
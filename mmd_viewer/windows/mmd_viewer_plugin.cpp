@@ -13,8 +13,11 @@
 #include <memory>
 #include <sstream>
 #include <format>
+#include <functional>
+#include <thread>
 
 #include "HeadlessMmdEngine.h"
+#include "cp932.h"
 
 namespace {
 auto engine = headless_mmd::HeadlessMmdEngine::GetInstance();
@@ -26,6 +29,17 @@ HWND hchild = nullptr;
 SIZE content_size{1280, 720};
 RECT margin{0,800,0,400};
 
+// a result may only be answered on the platform thread, so work done on another one posts its answer
+// to the main window, whose messages the platform thread handles
+constexpr UINT WM_RUN_ON_PLATFORM_THREAD = WM_APP + 1;
+
+void PostToPlatformThread(std::function<void()> task){
+  auto posted = std::make_unique<std::function<void()>>(std::move(task));
+  if(PostMessage(hmain, WM_RUN_ON_PLATFORM_THREAD, 0, reinterpret_cast<LPARAM>(posted.get()))){
+    posted.release();
+  }
+}
+
 std::string ToString(const std::wstring& wstr){
   char buf[1024]{};
   WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), static_cast<int>(wstr.length()), buf, static_cast<int>(_countof(buf)), NULL, FALSE);
@@ -39,11 +53,7 @@ std::wstring ToWstring(const std::string& str){
 }
 
 std::string ToSjis(const std::string& utf8) {
-  auto utf16 = ToWstring(utf8);
-
-  char buf[1024]{};
-  WideCharToMultiByte(CP_ACP, 0, utf16.c_str(), static_cast<int>(utf16.length()), buf, static_cast<int>(_countof(buf)), NULL, FALSE);
-  return buf;  
+  return cp932::FromUtf8(utf8);
 }
 
 float CalcAspect(const SIZE& size){
@@ -147,6 +157,12 @@ void MmdViewerPlugin::RegisterWithRegistrar(flutter::PluginRegistrarWindows *reg
       case WM_SIZE:
         AdjustChildWindow(LOWORD(lp), HIWORD(lp));
         break;
+
+      case WM_RUN_ON_PLATFORM_THREAD: {
+        std::unique_ptr<std::function<void()>> task(reinterpret_cast<std::function<void()>*>(lp));
+        (*task)();
+        return 0;
+      }
     }
 
     return std::nullopt;
@@ -223,6 +239,18 @@ void MmdViewerPlugin::HandleMethodCall(const flutter::MethodCall<flutter::Encoda
       });
     }
   }
+  else if(method_name.compare("getModelState") == 0) {
+    // openModel answers before the model is imported, this tells whether the import got through
+    const char* state = "none";
+    switch(engine->GetModelState()){
+      case headless_mmd::ModelState::Importing: state = "importing"; break;
+      case headless_mmd::ModelState::Ready: state = "ready"; break;
+      case headless_mmd::ModelState::Failed: state = "failed"; break;
+      default: break;
+    }
+
+    result->Success(flutter::EncodableValue(state));
+  }
   else if(method_name.compare("openScene") == 0) {
     auto path = ToWstring(GetArgument<std::string>(args, "path"));
     headless_mmd::AnimationInfo info{};
@@ -258,12 +286,55 @@ void MmdViewerPlugin::HandleMethodCall(const flutter::MethodCall<flutter::Encoda
     } 
   }
   else if(method_name.compare("update") == 0) {
-    auto frame = GetArgument<int>(args, "frame");
+    // whole frames arrive as int, frames between them as double
+    const auto& frame_arg = std::get<flutter::EncodableMap>(*args).at(flutter::EncodableValue("frame"));
+    auto frame = std::holds_alternative<double>(frame_arg) ? static_cast<float>(std::get<double>(frame_arg)) : static_cast<float>(std::get<int32_t>(frame_arg));
     auto values = GetArgument<std::vector<float>>(args, "values");
     engine->Update(frame, values);
     
     result->Success();
   }
+  else if(method_name.compare("getPoseCacheStats") == 0) {
+    const auto stats = engine->GetPoseCacheStats();
+    result->Success(flutter::EncodableMap{
+      {flutter::EncodableValue("hits"), flutter::EncodableValue(static_cast<int64_t>(stats.hits))},
+      {flutter::EncodableValue("misses"), flutter::EncodableValue(static_cast<int64_t>(stats.misses))},
+    });
+  }
+  else if(method_name.compare("setScrubCacheBudget") == 0) {
+    // dart sends an int as int32 when it fits and int64 otherwise
+    const auto& bytes_arg = std::get<flutter::EncodableMap>(*args).at(flutter::EncodableValue("bytes"));
+    const auto bytes = std::holds_alternative<int64_t>(bytes_arg) ? std::get<int64_t>(bytes_arg) : static_cast<int64_t>(std::get<int32_t>(bytes_arg));
+    engine->SetScrubCacheBudget(bytes > 0 ? static_cast<std::size_t>(bytes) : 0);
+
+    result->Success();
+  }
+  else if(method_name.compare("getScrubCacheStats") == 0) {
+    const auto stats = engine->GetScrubCacheStats();
+    result->Success(flutter::EncodableMap{
+      {flutter::EncodableValue("budget"), flutter::EncodableValue(static_cast<int64_t>(stats.budget))},
+      {flutter::EncodableValue("bytes"), flutter::EncodableValue(static_cast<int64_t>(stats.bytes))},
+      {flutter::EncodableValue("entries"), flutter::EncodableValue(static_cast<int64_t>(stats.entries))},
+      {flutter::EncodableValue("hits"), flutter::EncodableValue(static_cast<int64_t>(stats.hits))},
+      {flutter::EncodableValue("misses"), flutter::EncodableValue(static_cast<int64_t>(stats.misses))},
+      {flutter::EncodableValue("evictions"), flutter::EncodableValue(static_cast<int64_t>(stats.evictions))},
+    });
+  }
+  else if(method_name.compare("setMorphSource") == 0) {
+    auto source = GetArgument<std::string>(args, "source");
+    if(source == "values"){
+      engine->SetMorphSource(headless_mmd::MorphSource::Values);
+    }
+    else if(source == "animation"){
+      engine->SetMorphSource(headless_mmd::MorphSource::Animation);
+    }
+    else{
+      result->Error("invalid_argument", "source must be values or animation");
+      return;
+    }
+
+    result->Success();
+  }
   else if(method_name.compare("saveAnimation") == 0) {
     auto path = GetArgument<std::string>(args, "path");
     auto flutter_morph_names = GetArgument<flutter::EncodableList>(args, "morph_names");
@@ -279,7 +350,7 @@ void MmdViewerPlugin::HandleMethodCall(const flutter::MethodCall<flutter::Encoda
     const auto num_tracks = flutter_frame_tracks.size();
     if(num_tracks != flutter_value_tracks.size()){
       MessageBox(NULL, L"Invalid track and values count", L"error", MB_OK);
-      result->Success(flutter::EncodableValue(false));
+      result->Success(flutter::EncodableMap{{flutter::EncodableValue("saved"), flutter::EncodableValue(false)}});
       return;
     }
 
@@ -290,12 +361,60 @@ void MmdViewerPlugin::HandleMethodCall(const flutter::MethodCall<flutter::Encoda
       value_tracks[i] = std::get<std::vector<float>>(flutter_value_tracks[i]);
     }
 
-    auto saved = engine->SaveMorphAnimation(ToWstring(path), morph_names, frame_tracks, value_tracks, model_name);
+    // keys are reduced only when the caller gives a tolerance
+    const auto& arg_map = std::get<flutter::EncodableMap>(*args);
+    auto tolerance_arg = arg_map.find(flutter::EncodableValue("tolerance"));
+    auto tolerance = tolerance_arg != arg_map.end() && std::holds_alternative<double>(tolerance_arg->second) ? static_cast<float>(std::get<double>(tolerance_arg->second)) : -1.f;
+
+    headless_mmd::KeyReductionInfo info{};
+    auto saved = engine->SaveMorphAnimation(ToWstring(path), morph_names, frame_tracks, value_tracks, model_name, tolerance, &info);
     if(saved){
       MessageBeep(MB_ICONASTERISK);
     }
 
-    result->Success(flutter::EncodableValue(saved));
+    result->Success(flutter::EncodableMap{
+      {flutter::EncodableValue("saved"), flutter::EncodableValue(saved)},
+      {flutter::EncodableValue("num_keys"), flutter::EncodableValue(static_cast<int64_t>(info.num_keys))},
+      {flutter::EncodableValue("num_saved_keys"), flutter::EncodableValue(static_cast<int64_t>(info.num_saved_keys))},
+      {flutter::EncodableValue("ratio"), flutter::EncodableValue(info.GetCompressionRatio())},
+    });
+  }
+  else if(method_name.compare("convertScene") == 0) {
+    auto scene_path = GetArgument<std::string>(args, "scene_path");
+    auto model_path = GetArgument<std::string>(args, "model_path");
+    auto vmd_path = GetArgument<std::string>(args, "vmd_path");
+
+    // the tolerances the caller leaves out fall back to about a hundredth of a unit and a third of a degree
+    const auto& arg_map = std::get<flutter::EncodableMap>(*args);
+    auto GetTolerance = [&](const char* name, float fallback) {
+      auto arg = arg_map.find(flutter::EncodableValue(name));
+      return arg != arg_map.end() && std::holds_alternative<double>(arg->second) ? static_cast<float>(std::get<double>(arg->second)) : fallback;
+    };
+    auto translation_tolerance = GetTolerance("translation_tolerance", 0.01f);
+    auto rotation_tolerance = GetTolerance("rotation_tolerance", 0.005f);
+
+    // the model finds its track by file name unless the caller picks one
+    auto track_arg = arg_map.find(flutter::EncodableValue("track_index"));
+    auto track_index = track_arg != arg_map.end() && std::holds_alternative<int32_t>(track_arg->second) ? std::get<int32_t>(track_arg->second) : -1;
+
+    // a long capture takes seconds to convert, which the platform thread must not wait for
+    std::thread([=, result = std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>>(std::move(result))] {
+      headless_mmd::KeyReductionInfo info{};
+      auto saved = headless_mmd::HeadlessMmdEngine::ConvertSceneToVmd(ToWstring(scene_path), ToWstring(model_path), ToWstring(vmd_path), translation_tolerance, rotation_tolerance, &info, track_index);
+
+      PostToPlatformThread([=] {
+        if(saved){
+          MessageBeep(MB_ICONASTERISK);
+        }
+
+        result->Success(flutter::EncodableMap{
+          {flutter::EncodableValue("saved"), flutter::EncodableValue(saved)},
+          {flutter::EncodableValue("num_keys"), flutter::EncodableValue(static_cast<int64_t>(info.num_keys))},
+          {flutter::EncodableValue("num_saved_keys"), flutter::EncodableValue(static_cast<int64_t>(info.num_saved_keys))},
+          {flutter::EncodableValue("ratio"), flutter::EncodableValue(info.GetCompressionRatio())},
+        });
+      });
+    }).detach();
   }
   else {
     result->NotImplemented();